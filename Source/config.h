@@ -12,13 +12,143 @@
 #define BUTTON_FEED 16
 #define DEBOUNCE_TIME 20
 
-/* DC Motor */
+/* Hoppers */
+#define HOPPERS_COUNT 1 // Hoppers with their own motor, wheel and schedule, 1 - 2, one per channel of the MDD3A
+
+/* Feeder */
+#define FEEDER_FILE_NAME_LENGTH 96 // Longest name of a feeder file including the directory of the feeder
+
+/* DC Motor of the first hopper, on the M1 channel of the MDD3A */
 #define MOTOR_ENCODER_A 23
 #define MOTOR_ENCODER_B 24
 #define MOTOR_M1A 12
 #define MOTOR_M1B 13
 #define MOTOR_GEAR_RATIO 74.83
 #define MOTOR_CPR 48
-#define MOTOR_ENCODER_TICKS_PER_DEGREE (MOTOR_CPR * MOTOR_GEAR_RATIO / 360)
+#define MOTOR_ENCODER_TICKS_PER_DEGREE (MOTOR_CPR * MOTOR_GEAR_RATIO / 360) // Nominal, motor.cfg holds the calibrated value
+#define MOTOR_INDEX_PIN 22 // Optional index sensor, active low once per wheel revolution, -1 if not mounted
+#define MOTOR_PWM_RANGE 1024 // Full duty, outputs, gains and AUTOTUNE_RELAY_OUTPUT scale with it
+#define MOTOR_PWM_CLOCK 2 // Divisor of the 19.2 MHz PWM clock, 9.4 kHz with the range of 1024
+#define MOTOR_POSITION_FILE "wheel.pos" // Absolute wheel position, saved after every move
+#define MOTOR_CONFIG_FILE "motor.cfg"
+
+/* DC Motor of the second hopper, on the M2 channel of the MDD3A. Both hardware
+   PWM channels drive the first motor, this one runs on software PWM */
+#define MOTOR2_ENCODER_A 17
+#define MOTOR2_ENCODER_B 27
+#define MOTOR_M2A 20
+#define MOTOR_M2B 21
+#define MOTOR2_INDEX_PIN 25 // -1 if not mounted
+#define MOTOR_SOFT_PWM_RANGE 100 // Steps of 100 us, 100 Hz with the range of 100
+
+/* Encoder sampling */
+#define ENCODER_SAMPLING ENCODER_SAMPLING_ADAPTIVE
+#define ENCODER_POLLING_VELOCITY 150 // Velocity from which the polling thread samples the encoder [deg/s]
+#define ENCODER_INTERRUPT_VELOCITY 50 // Velocity below which edge interrupts take over again [deg/s]
+#define ENCODER_POLL_PERIOD 0 // Sampling period of the polling thread, 0 to sample continuously [us]
+#define ENCODER_POLL_CPU 3 // CPU the polling thread is pinned to, -1 for any
+#define ENCODER_POLL_UNPINNED_PERIOD 50 // Shortest sampling period if the thread couldn't be pinned [us]
+#define ENCODER_POLL_PRIORITY 50 // Real-time priority of the polling thread, 0 - 99
+
+/* Encoder calibration */
+#define ENCODER_CALIBRATION_DUTY 0.35 // Output while the wheel turns, fraction of the PWM range
+#define ENCODER_CALIBRATION_REVOLUTIONS 3 // Measured wheel revolutions
+#define ENCODER_CALIBRATION_TIMEOUT 12000 // [ms]
+#define ENCODER_CALIBRATION_TOLERANCE 0.05 // Largest accepted deviation from the nominal ticks per revolution
+#define ENCODER_CALIBRATION_SPREAD 4 // Largest accepted difference between the measured revolutions [ticks]
+
+/* Motor control loop, gains and rate are overridden by motor.cfg */
+#define MOTOR_CONTROL_RATE 2000 // [Hz]
+#define MOTOR_CONTROL_RATE_MIN 100 // [Hz]
+#define MOTOR_CONTROL_RATE_MAX 5000 // [Hz]
+#define MOTOR_PID_KP 20 // Tracks the motion profile on the simulated motor without friction compensation
+#define MOTOR_PID_KI 1500 // Builds up the duty to break away at the start of a profile
+#define MOTOR_PID_KD 0.15
+#define MOTOR_PID_DERIVATIVE_FILTER 0.002 // Derivative low-pass time constant [s]
+#define MOTOR_POSITION_TOLERANCE 2 // [ticks]
+#define MOTOR_SETTLE_WINDOW 20 // Time within tolerance to finish a move [ms]
+#define MOTOR_SEGMENT_TIMEOUT 1000 // Time after the end of a profile to settle or reverse [ms]
+#define MOTOR_VELOCITY_BLEND_EDGES 4 // Edges per control period from which only edge counting is used
+#define MOTOR_VELOCITY_TIMEOUT 100 // Time without an edge after which the motor is at rest [ms]
+
+/* Friction compensation, the calibrated duties are stored in motor.cfg */
+#define MOTOR_FRICTION_BREAK_AWAY 0.19 // Duty to start moving, fraction of the PWM range, measured on the simulated motor
+#define MOTOR_FRICTION_COULOMB 0.11 // Duty to keep moving, fraction of the PWM range, measured on the simulated motor
+#define MOTOR_FRICTION_MIN_VELOCITY 5 // Velocity above which the motor is moving [deg/s]
+#define FRICTION_RAMP_RATE 0.5 // Duty ramp of the calibration, fraction of the PWM range per second
+#define FRICTION_BREAK_AWAY_TICKS 3 // Distance which counts as break-away [ticks]
+#define FRICTION_STOP_TIME 30 // Time without an edge after which the motor stopped [ms]
+#define FRICTION_CALIBRATION_RUNS 4 // Measurements in every direction
+#define FRICTION_BREAK_AWAY_MARGIN 1.2 // Factor of the highest measured break-away duty, the load varies with the wheel position
+
+/* Braking, the mode is overridden by motor.cfg */
+#define MOTOR_BRAKE_DEFAULT_MODE MOTOR_BRAKE_PROPORTIONAL
+#define MOTOR_BRAKE_ZONE 15 // Distance to the target within which the motor brakes instead of reversing [deg]
+#define MOTOR_BRAKE_MIN_VELOCITY 20 // Velocity below which braking is too weak and the motor reverses [deg/s]
+
+/* Jam recovery */
+#define MOTOR_JAM_WINDOW 50 // Time the velocity has to stay low to detect a jam [ms]
+#define MOTOR_JAM_MIN_VELOCITY 10 // Velocity below which a lagging motor is jammed [deg/s]
+#define MOTOR_JAM_ERROR 20 // Min distance behind the reference to detect a jam [ticks]
+#define MOTOR_JAM_REVERSE 20 // Reverse distance of the first retry, grows with every retry [deg]
+#define MOTOR_JAM_PAUSE 200 // Motor stopped between reversing and retrying [ms]
+#define MOTOR_JAM_MAX_ATTEMPTS 3 // Retries before the move is given up with a fault
+#define MOTOR_JAM_BASE_EFFORT 0.85 // Output limit before the first jam, fraction of the PWM range
+#define MOTOR_JAM_EFFORT_STEP 0.05 // Output limit increase with every retry
+
+/* Auto-tuning */
+#define AUTOTUNE_RELAY_OUTPUT 400 // Relay output, must overcome static friction
+#define AUTOTUNE_HYSTERESIS 2 // Relay hysteresis [ticks]
+#define AUTOTUNE_SKIPPED_CYCLES 2 // Cycles before the oscillation is stable
+#define AUTOTUNE_CYCLES 6 // Measured cycles
+#define AUTOTUNE_TIMEOUT 10000 // [ms]
+
+/* Feeding */
+#define FEEDING_SCHEDULE_FILE "feeding.cfg"
+#define FEEDING_DEFAULT_MODE FEED_MODE_BATCH // Feed mode of new and older schedule entries
+#define FEEDING_BATCH_DWELL 150 // Hold at every arm boundary in the dwell feed mode [ms]
+#define FEEDING_CLOCK_STEP 5 // Wall clock deviation from the monotonic clock treated as a clock change [s]
+#define FEEDING_CATCH_UP_POLICY FEEDING_CATCH_UP_LATE // What is done with feedings missed during a stall or a restart
+#define FEEDING_CATCH_UP_WINDOW 60 // Longest delay a missed feeding is still fed with [min]
+#define FEEDING_CATCH_UP_MAX_PORTIONS 10 // Most portions of a merged catch-up feed
+#define FEEDING_JOURNAL_FILE "feeding.journal" // Feedings decided about, read at start
+#define FEEDING_JOURNAL_ENTRIES 64 // Entries kept when the journal is compacted
+#define FEEDING_SLA_START_BUDGET 2000 // Longest delay from the due time of a feeding until the motor starts, a warning is logged above [ms]
+#define FEEDING_SLA_ENTRIES 16 // Feeding times per hopper whose latencies are kept, the one fed least recently is replaced
+
+/* Dispenser */
+#define DISPENSER_QUEUE_SIZE 8 // Dispense jobs waiting for the running one
+#define DISPENSER_MAX_JOB_PORTIONS 20 // Most portions a job grows to by coalescing requests
+#define DISPENSER_PRIORITY 40 // Real-time priority of the workers running the motor control loops, 0 - 99
+#define DISPENSER_TREAT_HOPPER 0 // Hopper the feed button dispenses a treat from
+
+/* Motion profile limits per feeding wheel, overridden by motor.cfg */
+#define MOTION_MAX_VELOCITY_4_ARMS 450 // [deg/s]
+#define MOTION_MAX_ACCELERATION_4_ARMS 2500 // [deg/s^2]
+#define MOTION_MAX_JERK_4_ARMS 50000 // [deg/s^3], 0 for a trapezoidal profile
+#define MOTION_MAX_VELOCITY_6_ARMS 500
+#define MOTION_MAX_ACCELERATION_6_ARMS 3000
+#define MOTION_MAX_JERK_6_ARMS 60000
+#define MOTION_MAX_VELOCITY_8_ARMS 540
+#define MOTION_MAX_ACCELERATION_8_ARMS 3500
+#define MOTION_MAX_JERK_8_ARMS 70000
+
+/* Motor trace */
+#define TRACE_ENABLED 1 // Record a sample of every control loop iteration
+#define TRACE_SAMPLES 16384 // Samples kept in memory, about 8 s of moves at 2 kHz
+#define TRACE_MOVES 16 // Moves kept in memory
+#define TRACE_FILE "motor.trace"
+#define TRACE_DUMP_ON_JAM 1 // Dump the trace after every move with a jam
+
+/* Metrics */
+#define METRICS_FILE "feeder.prom"
+#define METRICS_EXPORT_INTERVAL 15000 // [ms]
+
+/* Watchdog */
+#define WATCHDOG_CHECK_INTERVAL 100 // [ms]
+#define WATCHDOG_LOOP_BUDGET 2000 // Max time between main loop iterations [ms]
+#define WATCHDOG_MOVE_BUDGET 15000 // Max time of a single motor move including back-offs [ms]
+#define WATCHDOG_ESCALATION_TIME 5000 // Time to recover from a breach before restart [ms]
+#define WATCHDOG_HARDWARE_DEVICE "" // e.g. "/dev/watchdog", empty to disable
 
 #endif // config_h
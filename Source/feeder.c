@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <stdlib.h>
 #include <wiringPi.h>
 #include "config.h"
 #include "libs/tools.h"
@@ -11,10 +12,24 @@
 #include "libs/lcd_utils.h"
 #include "libs/logger.h"
 #include "libs/feeding.h"
+#include "libs/metrics.h"
+#include "libs/watchdog.h"
+#include "libs/autotune.h"
+#include "libs/friction.h"
+#include "libs/encoder.h"
+#include "libs/trace.h"
+#include "libs/dispenser.h"
+#include "libs/context.h"
+#include "libs/clock.h"
+
+// State of the feeder, it owns the hardware of the process
+feederS feeder;
+
+int main(int argc, char *argv[]) {
+  initFeederContext(&feeder, "");
 
-int main(void) {
   // Initialize logger
-  if (initLogger() != 0) {
+  if (initLogger(&feeder) != 0) {
     fprintf(stderr, "Error during logger initialization: %s", strerror(errno));
     return 1;
   }
@@ -24,44 +39,95 @@ int main(void) {
   // Initialize wiringPi
   if (wiringPiSetupGpio() != 0) {
     sprintf(logMessageBuffer, "Error during wiringPi initialization: %s", strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(&feeder, ERROR, logMessageBuffer);
   }
 
   // Initialize GPIO pins/devices
-  lcd_init_i2c(LCD_ADDRESS, 16, 2, LCD_5x8DOTS);
-  lcd_blinkOff_i2c();
-  lcd_cursorOff_i2c();
+  lcd_init_i2c(&feeder, LCD_ADDRESS, 16, 2, LCD_5x8DOTS);
+  lcd_blinkOff_i2c(&feeder);
+  lcd_cursorOff_i2c(&feeder);
 
-  // Initialize motor
-  if (initMotor() != 0) {
+  // Initialize the motor of every hopper
+  if (initMotor(&feeder) != 0) {
     sprintf(logMessageBuffer, "Error during motor initialization: %s", strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(&feeder, ERROR, logMessageBuffer);
     return 1;
   }
 
   // Initialize buttons
-  if (initButtons() != 0) {
+  if (initButtons(&feeder) != 0) {
     sprintf(logMessageBuffer, "Error during buttons initialization: %s", strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(&feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    // Load feeding schedule
+    if (loadFeedingSchedule(&feeder, i) != 0) {
+      sprintf(logMessageBuffer, "No feeding schedule %hhu loaded: %s", i + 1, strerror(errno));
+      logMessage(&feeder, WARNING, logMessageBuffer);
+    }
+
+    // Resume the scheduler after the last feeding before the restart
+    if (loadLastFeeding(&feeder, i) != 0) {
+      sprintf(logMessageBuffer, "No feeding journal %hhu loaded, feedings missed before the start aren't caught up", i + 1);
+      logMessage(&feeder, WARNING, logMessageBuffer);
+    }
+  }
+
+  // Start watchdog supervisor
+  if (initWatchdog(&feeder) != 0) {
+    sprintf(logMessageBuffer, "Error during watchdog initialization: %s", strerror(errno));
+    logMessage(&feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  // Motor trace is dumped on SIGUSR1
+  initTrace(&feeder);
+
+  // Maintenance modes, run once and exit. The hopper is the optional second
+  // argument, the first hopper by default
+  uint8_t hopper = argc > 2 ? atoi(argv[2]) - 1 : 0;
+  if (hopper >= HOPPERS_COUNT) {
+    sprintf(logMessageBuffer, "Unknown hopper %s, the feeder has %d", argv[2], HOPPERS_COUNT);
+    logMessage(&feeder, ERROR, logMessageBuffer);
     return 1;
   }
+  if (argc > 1 && strcmp(argv[1], "--autotune") == 0) {
+    return autotuneMotor(getMotor(&feeder, hopper), getFeedingWheelArms(&feeder, hopper));
+  }
+  if (argc > 1 && strcmp(argv[1], "--calibrate-friction") == 0) {
+    return calibrateFriction(getMotor(&feeder, hopper));
+  }
+  if (argc > 1 && strcmp(argv[1], "--calibrate-encoder") == 0) {
+    return calibrateEncoder(getMotor(&feeder, hopper));
+  }
 
-  // Load feeding schedule
-  if (loadFeedingSchedule() != 0) {
-    sprintf(logMessageBuffer, "No feeding schedule loaded: %s", strerror(errno));
-    logMessage(WARNING, logMessageBuffer);
+  // Start the dispensing workers, the main loop only queues portions
+  if (initDispenser(&feeder) != 0) {
+    sprintf(logMessageBuffer, "Error during dispenser initialization: %s", strerror(errno));
+    logMessage(&feeder, ERROR, logMessageBuffer);
+    return 1;
   }
 
   // Feeder initialization complete
   //lcdWelcomeScreen();
   sprintf(logMessageBuffer, "Feeder initialization complete");
-  logMessage(INFO, logMessageBuffer);
+  logMessage(&feeder, INFO, logMessageBuffer);
 
   // Operation loop
   while(1) {
-    debounceButtons();
-    handleFeeding();
-    handleLCD();
+    uint32_t iterationStart = micros();
+    updateFeederClock(&feeder); // Every module of the iteration sees the same time
+    watchdogKick(&feeder);
+
+    debounceButtons(&feeder);
+    handleFeeding(&feeder);
+    handleLCD(&feeder);
+    handleMetrics(&feeder);
+    handleTrace(&feeder);
+
+    metricsObserve(&feeder, METRIC_LOOP_ITERATION_TIME, micros() - iterationStart);
     delayMicroseconds(10000);
   }
 
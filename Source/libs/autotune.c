@@ -0,0 +1,132 @@
+#include "autotune.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <math.h>
+#include <time.h>
+#include <wiringPi.h>
+#include "../config.h"
+#include "logger.h"
+#include "motor.h"
+#include "watchdog.h"
+
+/*******************************************************************************
+* runRelayTest
+*
+* @brief Identifies the position loop with a relay feedback test. The motor is
+*        driven with +/- AUTOTUNE_RELAY_OUTPUT depending on the side of the
+*        start position it is on, which makes it oscillate around it with a
+*        small amplitude. The first cycles are skipped until the oscillation
+*        is stable, the rest are averaged
+*
+* @param[in] motor The motor
+* @param[out] result Measured oscillation and ultimate gain and period
+*
+* @return 0 on success, 1 if no stable oscillation was measured
+*******************************************************************************/
+uint8_t runRelayTest(motorS *motor, autotuneResultS *result) {
+  uint16_t rate = getMotorControlRate(motor);
+  uint32_t periodNs = 1000000000 / rate;
+  uint32_t maxIterations = (uint32_t)AUTOTUNE_TIMEOUT * rate / 1000;
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  int64_t setpoint = -getEncoderPosition(motor);
+  int32_t output = AUTOTUNE_RELAY_OUTPUT;
+  int32_t errorMax = 0;
+  int32_t errorMin = 0;
+  uint32_t lastRiseIteration = 0;
+  uint8_t rises = 0;
+
+  float amplitudeSum = 0;
+  float periodSum = 0;
+  uint8_t cycles = 0;
+
+  for (uint32_t i = 0; i < maxIterations && cycles < AUTOTUNE_CYCLES; i++) {
+    if (watchdogIsMoveAborted(motor->feeder, motor->hopper)) break;
+
+    int32_t error = getEncoderPosition(motor) + setpoint;
+
+    if (error > errorMax) errorMax = error;
+    if (error < errorMin) errorMin = error;
+
+    // Relay with hysteresis, a full cycle ends on every switch to positive output
+    if (error > AUTOTUNE_HYSTERESIS && output < 0) {
+      output = AUTOTUNE_RELAY_OUTPUT;
+      rises++;
+
+      if (rises > AUTOTUNE_SKIPPED_CYCLES + 1) {
+        amplitudeSum += (errorMax - errorMin) / 2.0;
+        periodSum += (float)(i - lastRiseIteration) / rate;
+        cycles++;
+      }
+
+      lastRiseIteration = i;
+      errorMax = error;
+      errorMin = error;
+    }
+    else if (error < -AUTOTUNE_HYSTERESIS && output > 0) {
+      output = -AUTOTUNE_RELAY_OUTPUT;
+    }
+
+    driveMotor(motor, output);
+    waitForNextPeriod(motor, &deadline, periodNs);
+  }
+
+  driveMotor(motor, 0);
+
+  if (cycles == 0) return 1;
+
+  result->cycles = cycles;
+  result->amplitude = amplitudeSum / cycles;
+  result->ultimatePeriod = periodSum / cycles;
+
+  // Describing function of a relay with hysteresis
+  float amplitude = result->amplitude > AUTOTUNE_HYSTERESIS ? result->amplitude : AUTOTUNE_HYSTERESIS + 1;
+  result->ultimateGain = 4.0 * AUTOTUNE_RELAY_OUTPUT /
+    (M_PI * sqrtf(amplitude * amplitude - AUTOTUNE_HYSTERESIS * AUTOTUNE_HYSTERESIS));
+
+  return 0;
+}
+
+/*******************************************************************************
+* autotuneMotor
+*
+* @brief Runs the relay feedback test on the mounted wheel, computes the PID
+*        gains with the Ziegler-Nichols "no overshoot" rule and saves them
+*        for the wheel configuration
+*
+* @param[in] motor The motor
+* @param[in] wheelArms Arms of the mounted feeding wheel
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t autotuneMotor(motorS *motor, uint8_t wheelArms) {
+  char logMessageBuffer[120];
+  autotuneResultS result;
+
+  sprintf(logMessageBuffer, "Auto-tuning motor %hhu for %hhu arms wheel", motor->hopper + 1, wheelArms);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  watchdogBeginMove(motor->feeder, motor->hopper);
+  watchdogSetPhase(motor->feeder, motor->hopper, WATCHDOG_PHASE_MOVING);
+  uint8_t status = runRelayTest(motor, &result);
+  watchdogEndMove(motor->feeder, motor->hopper);
+
+  if (status != 0) {
+    logMessage(motor->feeder, ERROR, "Auto-tuning failed, no stable oscillation measured");
+    return 1;
+  }
+
+  sprintf(logMessageBuffer, "Relay test: %hhu cycles, amplitude %.1f ticks, Ku %.3f, Tu %.4f s",
+    result.cycles, result.amplitude, result.ultimateGain, result.ultimatePeriod);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  float kp = 0.2 * result.ultimateGain;
+  float ki = 0.4 * result.ultimateGain / result.ultimatePeriod;
+  float kd = 0.0667 * result.ultimateGain * result.ultimatePeriod;
+
+  setMotorGains(motor, wheelArms, kp, ki, kd);
+
+  return 0;
+}
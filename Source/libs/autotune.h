@@ -0,0 +1,17 @@
+#ifndef autotune_h
+#define autotune_h
+
+#include <stdint.h>
+#include "motor.h"
+
+typedef struct autotuneResultS {
+  float ultimateGain; // Gain at which the position loop oscillates (Ku)
+  float ultimatePeriod; // Period of the oscillation (Tu) [s]
+  float amplitude; // Average oscillation amplitude [ticks]
+  uint8_t cycles; // Number of measured cycles
+} autotuneResultS;
+
+uint8_t autotuneMotor(motorS *motor, uint8_t wheelArms);
+uint8_t runRelayTest(motorS *motor, autotuneResultS *result);
+
+#endif // autotune_h
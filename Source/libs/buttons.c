@@ -3,26 +3,35 @@
 #include "tools.h"
 #include <wiringPi.h>
 #include <stdio.h>
-#include "motor.h"
+#include "dispenser.h"
 #include "lcd_utils.h"
 #include "logger.h"
-#include "feeding.h"
+#include "clock.h"
+#include "context.h"
 
-buttonS buttonUp = {BUTTON_UP, true, 0, false, DEBOUNCE_TIME};
-buttonS buttonDown = {BUTTON_DOWN, true, 0, false, DEBOUNCE_TIME};
-buttonS buttonLeft = {BUTTON_LEFT, true, 0, false, DEBOUNCE_TIME};
-buttonS buttonRight = {BUTTON_RIGHT, true, 0, false, DEBOUNCE_TIME};
-buttonS buttonFeed = {BUTTON_FEED, true, 0, false, DEBOUNCE_TIME};
+// Feeder owning the buttons on the GPIO pins, WiringPi ISRs take no arguments
+feederS *buttonsFeeder = NULL;
 
 /*******************************************************************************
 * initButtons
 *
-* @brief Initializes button pinModes, pullUps and ISRs
+* @brief Initializes the buttons of a feeder, their pinModes, pullUps and ISRs.
+*        The buttons on the GPIO pins belong to a single feeder of the process
+*
+* @param[in] feeder The feeder
 *
 * @return 0 on success, 1 on failure
 *******************************************************************************/
-uint8_t initButtons() {
+uint8_t initButtons(feederS *feeder) {
   char logMessageBuffer[120];
+  buttonsS *buttons = &feeder->buttons;
+
+  buttons->up = (buttonS){BUTTON_UP, true, 0, false, DEBOUNCE_TIME};
+  buttons->down = (buttonS){BUTTON_DOWN, true, 0, false, DEBOUNCE_TIME};
+  buttons->left = (buttonS){BUTTON_LEFT, true, 0, false, DEBOUNCE_TIME};
+  buttons->right = (buttonS){BUTTON_RIGHT, true, 0, false, DEBOUNCE_TIME};
+  buttons->feed = (buttonS){BUTTON_FEED, true, 0, false, DEBOUNCE_TIME};
+  buttonsFeeder = feeder;
 
   pinMode(BUTTON_UP, INPUT);
   pinMode(BUTTON_DOWN, INPUT);
@@ -38,31 +47,31 @@ uint8_t initButtons() {
 
   if (wiringPiISR(BUTTON_UP, INT_EDGE_BOTH, &buttonUpISR) < 0) {
     sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(BUTTON_UP), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(feeder, ERROR, logMessageBuffer);
     return 1;
   }
 
   if (wiringPiISR(BUTTON_DOWN, INT_EDGE_BOTH, &buttonDownISR) < 0) {
     sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(BUTTON_DOWN), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(feeder, ERROR, logMessageBuffer);
     return 1;
   }
 
   if (wiringPiISR(BUTTON_LEFT, INT_EDGE_BOTH, &buttonLeftISR) < 0) {
     sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(BUTTON_LEFT), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(feeder, ERROR, logMessageBuffer);
     return 1;
   }
 
   if (wiringPiISR(BUTTON_RIGHT, INT_EDGE_BOTH, &buttonRightISR) < 0) {
     sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(BUTTON_RIGHT), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(feeder, ERROR, logMessageBuffer);
     return 1;
   }
 
   if (wiringPiISR(BUTTON_FEED, INT_EDGE_BOTH, &buttonFeedISR) < 0) {
     sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(BUTTON_FEED), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    logMessage(feeder, ERROR, logMessageBuffer);
     return 1;
   }
 
@@ -72,14 +81,18 @@ uint8_t initButtons() {
 /*******************************************************************************
 * debounceButtons
 *
-* @brief Runs debouncing for all buttons
+* @brief Runs debouncing for all buttons of a feeder
+*
+* @param[in] feeder The feeder
 ******************************************************************************/
-void debounceButtons() {
-  if (buttonUp.state) debounceButton(&buttonUp);
-  if (buttonDown.state) debounceButton(&buttonDown);
-  if (buttonLeft.state) debounceButton(&buttonLeft);
-  if (buttonRight.state) debounceButton(&buttonRight);
-  if (buttonFeed.state) debounceButton(&buttonFeed);
+void debounceButtons(feederS *feeder) {
+  buttonsS *buttons = &feeder->buttons;
+
+  if (buttons->up.state) debounceButton(feeder, &buttons->up);
+  if (buttons->down.state) debounceButton(feeder, &buttons->down);
+  if (buttons->left.state) debounceButton(feeder, &buttons->left);
+  if (buttons->right.state) debounceButton(feeder, &buttons->right);
+  if (buttons->feed.state) debounceButton(feeder, &buttons->feed);
 }
 
 /*******************************************************************************
@@ -87,33 +100,16 @@ void debounceButtons() {
 *
 * @brief Debounces a button and calls button handling functions
 *
+* @param[in] feeder The feeder
 * @param[in] button Button to debounce
 ******************************************************************************/
-void debounceButton(buttonS *button) {
-  uint32_t currentTime = millis();
+void debounceButton(feederS *feeder, buttonS *button) {
+  uint32_t currentTime = getFeederMillis(feeder);
 
   if (currentTime - button->lastDebounceTime > button->debounceTime && button->state) {
     button->lastDebounceTime = currentTime;
     if (!digitalRead(button->pin) && button->previousState) {
-      switch (button->pin) {
-      case BUTTON_UP:
-        processButtonPress(UP);
-        break;
-      case BUTTON_DOWN:
-        processButtonPress(DOWN);
-        break;
-      case BUTTON_LEFT:
-        processButtonPress(LEFT);
-        break;
-      case BUTTON_RIGHT:
-        processButtonPress(RIGHT);
-        break;
-      case BUTTON_FEED:
-        rotateMotor(360 / getFeedingWheelArms());
-        break;
-      default:
-        break;
-      }
+      handleButtonPress(feeder, button->pin);
 
       button->previousState = false;
       delayMicroseconds(100);
@@ -125,47 +121,79 @@ void debounceButton(buttonS *button) {
   }
 }
 
+/*******************************************************************************
+* handleButtonPress
+*
+* @brief Handles a debounced press of a button, the arrows navigate the menu
+*        and the feed button dispenses a treat. Simulations press the buttons
+*        of a feeder through this function
+*
+* @param[in] feeder The feeder
+* @param[in] pin Pin of the pressed button
+******************************************************************************/
+void handleButtonPress(feederS *feeder, uint8_t pin) {
+  switch (pin) {
+  case BUTTON_UP:
+    processButtonPress(feeder, UP);
+    break;
+  case BUTTON_DOWN:
+    processButtonPress(feeder, DOWN);
+    break;
+  case BUTTON_LEFT:
+    processButtonPress(feeder, LEFT);
+    break;
+  case BUTTON_RIGHT:
+    processButtonPress(feeder, RIGHT);
+    break;
+  case BUTTON_FEED:
+    queueDispense(feeder, DISPENSER_TREAT_HOPPER, DISPENSE_SOURCE_TREAT, 1, FEED_MODE_BATCH);
+    break;
+  default:
+    break;
+  }
+}
+
 /*******************************************************************************
 * buttonUpISR
 *
-* @brief ISR for buttonUp
+* @brief ISR for the up button
 ******************************************************************************/
 void buttonUpISR() {
-  buttonUp.state = true;
+  buttonsFeeder->buttons.up.state = true;
 }
 
 /*******************************************************************************
 * buttonDownISR
 *
-* @brief ISR for buttonDown
+* @brief ISR for the down button
 ******************************************************************************/
 void buttonDownISR() {
-  buttonDown.state = true;
+  buttonsFeeder->buttons.down.state = true;
 }
 
 /*******************************************************************************
 * buttonLeftISR
 *
-* @brief ISR for buttonLeft
+* @brief ISR for the left button
 ******************************************************************************/
 void buttonLeftISR() {
-  buttonLeft.state = true;
+  buttonsFeeder->buttons.left.state = true;
 }
 
 /*******************************************************************************
 * buttonRightISR
 *
-* @brief ISR for buttonRight
+* @brief ISR for the right button
 ******************************************************************************/
 void buttonRightISR() {
-  buttonRight.state = true;
+  buttonsFeeder->buttons.right.state = true;
 }
 
 /*******************************************************************************
 * buttonFeedISR
 *
-* @brief ISR for buttonFeed
+* @brief ISR for the feed button
 ******************************************************************************/
 void buttonFeedISR() {
-  buttonFeed.state = true;
+  buttonsFeeder->buttons.feed.state = true;
 }
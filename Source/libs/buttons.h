@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <stdbool.h>
 
+typedef struct feederS feederS; // Defined in context.h
+
 typedef struct buttonS {
   uint8_t pin;
   bool previousState;
@@ -12,9 +14,18 @@ typedef struct buttonS {
   uint8_t debounceTime;
 } buttonS;
 
-uint8_t initButtons();
-void debounceButtons();
-void debounceButton(buttonS *button);
+typedef struct buttonsS {
+  buttonS up;
+  buttonS down;
+  buttonS left;
+  buttonS right;
+  buttonS feed;
+} buttonsS;
+
+uint8_t initButtons(feederS *feeder);
+void debounceButtons(feederS *feeder);
+void debounceButton(feederS *feeder, buttonS *button);
+void handleButtonPress(feederS *feeder, uint8_t pin);
 void buttonUpISR();
 void buttonDownISR();
 void buttonLeftISR();
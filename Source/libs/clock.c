@@ -0,0 +1,211 @@
+#include "clock.h"
+#include <wiringPi.h>
+#include "context.h"
+
+/*******************************************************************************
+* setVirtualClock
+*
+* @brief Switches a feeder to a virtual clock starting at the given wall time
+*
+* @param[in] feeder The feeder
+* @param[in] wallTime Wall clock the virtual clock starts at
+*******************************************************************************/
+void setVirtualClock(feederS *feeder, time_t wallTime) {
+  feeder->clock.isVirtual = true;
+  feeder->clock.virtualEpoch = wallTime;
+  feeder->clock.virtualMillis = 0;
+}
+
+/*******************************************************************************
+* advanceVirtualClock
+*
+* @brief Advances the wall and the monotonic virtual clock of a feeder together
+*
+* @param[in] feeder The feeder
+* @param[in] milliseconds Time to advance by [ms]
+*******************************************************************************/
+void advanceVirtualClock(feederS *feeder, uint32_t milliseconds) {
+  feeder->clock.virtualMillis += milliseconds;
+}
+
+/*******************************************************************************
+* readFeederClock
+*
+* @brief Reads the wall and the monotonic clock of a feeder, the system clocks
+*        or the virtual ones
+*
+* @param[in] feeder The feeder
+* @param[out] wallTime The wall clock
+* @param[out] monotonicTime The monotonic clock
+*******************************************************************************/
+void readFeederClock(feederS *feeder, struct timespec *wallTime, struct timespec *monotonicTime) {
+  feederClockS *clock = &feeder->clock;
+
+  if (!clock->isVirtual) {
+    clock_gettime(CLOCK_REALTIME, wallTime);
+    clock_gettime(CLOCK_MONOTONIC, monotonicTime);
+    return;
+  }
+
+  monotonicTime->tv_sec = clock->virtualMillis / 1000;
+  monotonicTime->tv_nsec = clock->virtualMillis % 1000 * 1000000;
+  wallTime->tv_sec = clock->virtualEpoch + monotonicTime->tv_sec;
+  wallTime->tv_nsec = monotonicTime->tv_nsec;
+}
+
+/*******************************************************************************
+* isLoopThread
+*
+* @brief Checks if the calling thread runs the loop of a feeder and reads the
+*        snapshot of its clocks
+*
+* @param[in] feeder The feeder
+*
+* @return True for the loop thread once it took a snapshot, false otherwise
+*******************************************************************************/
+bool isLoopThread(feederS *feeder) {
+  return atomic_load(&feeder->clock.isSnapshotTaken) && pthread_equal(feeder->clock.loopThread, pthread_self());
+}
+
+/*******************************************************************************
+* updateFeederClock
+*
+* @brief Takes the snapshot of the clocks of a feeder at the start of a loop
+*        iteration, a single reading of the wall and the monotonic clock. The
+*        local time is only converted again once the minute changes. The
+*        thread which takes the snapshot is the loop thread
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void updateFeederClock(feederS *feeder) {
+  feederClockS *clock = &feeder->clock;
+  bool isSnapshotTaken = atomic_load(&clock->isSnapshotTaken);
+
+  readFeederClock(feeder, &clock->wallTime, &clock->monotonicTime);
+
+  time_t wallTime = clock->wallTime.tv_sec;
+  if (!isSnapshotTaken || wallTime < clock->localMinuteStart || wallTime >= clock->localMinuteStart + 60) {
+    localtime_r(&wallTime, &clock->localMinute);
+    clock->localMinuteStart = wallTime - clock->localMinute.tm_sec;
+    clock->localMinute.tm_sec = 0;
+  }
+
+  // A simulated feeder may be run by another thread after a while
+  if (!isSnapshotTaken || !pthread_equal(clock->loopThread, pthread_self())) {
+    clock->loopThread = pthread_self();
+    atomic_store(&clock->isSnapshotTaken, true);
+  }
+}
+
+/*******************************************************************************
+* getFeederTime
+*
+* @brief Returns the wall clock of a feeder, of the snapshot in the loop thread
+*
+* @param[in] feeder The feeder
+*
+* @return The current time
+*******************************************************************************/
+time_t getFeederTime(feederS *feeder) {
+  struct timespec wallTime, monotonicTime;
+
+  if (isLoopThread(feeder)) return feeder->clock.wallTime.tv_sec;
+
+  readFeederClock(feeder, &wallTime, &monotonicTime);
+  return wallTime.tv_sec;
+}
+
+/*******************************************************************************
+* getFeederLocalTime
+*
+* @brief Converts a time of a feeder to its local time. In the loop thread a
+*        time within the minute of the snapshot is taken from the converted
+*        minute, other times are converted
+*
+* @param[in] feeder The feeder
+* @param[in] time The time
+* @param[out] timeInfo The local time
+*******************************************************************************/
+void getFeederLocalTime(feederS *feeder, time_t time, struct tm *timeInfo) {
+  feederClockS *clock = &feeder->clock;
+
+  if (isLoopThread(feeder) && time >= clock->localMinuteStart && time < clock->localMinuteStart + 60) {
+    *timeInfo = clock->localMinute;
+    timeInfo->tm_sec = time - clock->localMinuteStart;
+    return;
+  }
+
+  localtime_r(&time, timeInfo);
+}
+
+/*******************************************************************************
+* getFeederMillis
+*
+* @brief Returns the monotonic clock of a feeder in milliseconds, wrapping like
+*        millis(), of the snapshot in the loop thread
+*
+* @param[in] feeder The feeder
+*
+* @return The monotonic time [ms]
+*******************************************************************************/
+uint32_t getFeederMillis(feederS *feeder) {
+  struct timespec monotonicTime;
+
+  getFeederMonotonicTime(feeder, &monotonicTime);
+  return (uint32_t)((uint64_t)monotonicTime.tv_sec * 1000 + monotonicTime.tv_nsec / 1000000);
+}
+
+/*******************************************************************************
+* getFeederWallMillis
+*
+* @brief Returns the wall clock of a feeder in milliseconds, e.g. to measure
+*        how late a feeding is after its due time, of the snapshot in the loop
+*        thread
+*
+* @param[in] feeder The feeder
+*
+* @return Milliseconds since the epoch
+*******************************************************************************/
+uint64_t getFeederWallMillis(feederS *feeder) {
+  struct timespec wallTime, monotonicTime;
+
+  if (isLoopThread(feeder)) wallTime = feeder->clock.wallTime;
+  else readFeederClock(feeder, &wallTime, &monotonicTime);
+
+  return (uint64_t)wallTime.tv_sec * 1000 + wallTime.tv_nsec / 1000000;
+}
+
+/*******************************************************************************
+* getFeederMonotonicTime
+*
+* @brief Returns the monotonic clock of a feeder, of the snapshot in the loop
+*        thread
+*
+* @param[in] feeder The feeder
+* @param[out] monotonicTime The monotonic time
+*******************************************************************************/
+void getFeederMonotonicTime(feederS *feeder, struct timespec *monotonicTime) {
+  struct timespec wallTime;
+
+  if (isLoopThread(feeder)) {
+    *monotonicTime = feeder->clock.monotonicTime;
+    return;
+  }
+
+  readFeederClock(feeder, &wallTime, monotonicTime);
+}
+
+/*******************************************************************************
+* feederDelayMicroseconds
+*
+* @brief Waits for a peripheral of a feeder, e.g. the LCD controller. A
+*        simulated peripheral is ready at once, so a virtual clock doesn't wait
+*
+* @param[in] feeder The feeder
+* @param[in] microseconds Time to wait [us]
+*******************************************************************************/
+void feederDelayMicroseconds(feederS *feeder, uint32_t microseconds) {
+  if (feeder->clock.isVirtual) return;
+
+  delayMicroseconds(microseconds);
+}
@@ -0,0 +1,41 @@
+#ifndef clock_h
+#define clock_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <pthread.h>
+
+typedef struct feederS feederS; // Defined in context.h
+
+// Clocks of a feeder. A real feeder reads the system clocks, a simulated one
+// runs on a virtual clock advanced by the simulation, so a day of feedings
+// passes in a fraction of a second
+typedef struct feederClockS {
+  bool isVirtual; // Whether or not the clocks are advanced by a simulation
+  time_t virtualEpoch; // Wall clock at the start of the virtual monotonic clock
+  uint64_t virtualMillis; // Virtual monotonic clock [ms]
+
+  // Snapshot of the clocks taken once per loop iteration by updateFeederClock.
+  // The loop thread reads the snapshot, so every decision of an iteration sees
+  // the same time, the other threads read the clocks
+  atomic_bool isSnapshotTaken;
+  pthread_t loopThread; // Thread which took the snapshot
+  struct timespec wallTime;
+  struct timespec monotonicTime;
+  struct tm localMinute; // Local time of the minute of the snapshot, converted once the minute changes
+  time_t localMinuteStart; // Wall clock at the start of that minute
+} feederClockS;
+
+void setVirtualClock(feederS *feeder, time_t wallTime);
+void advanceVirtualClock(feederS *feeder, uint32_t milliseconds);
+void updateFeederClock(feederS *feeder);
+time_t getFeederTime(feederS *feeder);
+void getFeederLocalTime(feederS *feeder, time_t time, struct tm *timeInfo);
+uint32_t getFeederMillis(feederS *feeder);
+uint64_t getFeederWallMillis(feederS *feeder);
+void getFeederMonotonicTime(feederS *feeder, struct timespec *monotonicTime);
+void feederDelayMicroseconds(feederS *feeder, uint32_t microseconds);
+
+#endif // clock_h
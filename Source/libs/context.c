@@ -0,0 +1,30 @@
+#include "context.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+
+/*******************************************************************************
+* initFeederContext
+*
+* @brief Clears the state of a feeder, links its motors and dispensers to it
+*        and creates the locks of its dispensers and feeding latencies, so
+*        portions can be queued before the workers start. The modules are
+*        initialized afterwards by their own init functions
+*
+* @param[in] feeder The feeder
+* @param[in] directory Directory of the feeder files, empty for the current one
+*******************************************************************************/
+void initFeederContext(feederS *feeder, const char *directory) {
+  memset(feeder, 0, sizeof(*feeder));
+  snprintf(feeder->directory, sizeof(feeder->directory), "%s", directory);
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    feeder->motors[i].feeder = feeder;
+    feeder->motors[i].hopper = i;
+    feeder->dispensers[i].feeder = feeder;
+    feeder->dispensers[i].hopper = i;
+    pthread_mutex_init(&feeder->dispensers[i].mutex, NULL);
+    pthread_cond_init(&feeder->dispensers[i].condition, NULL);
+  }
+  pthread_mutex_init(&feeder->sla.mutex, NULL);
+}
@@ -0,0 +1,44 @@
+#ifndef context_h
+#define context_h
+
+#include <stdint.h>
+#include "../config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "lcd.h"
+#include "lcd_utils.h"
+#include "buttons.h"
+#include "feeding.h"
+#include "dispenser.h"
+#include "motor.h"
+#include "encoder.h"
+#include "trace.h"
+#include "watchdog.h"
+#include "clock.h"
+#include "sla.h"
+
+// State of a feeder. Every module keeps its state here instead of in globals,
+// so several feeders can run in one process, each with its own files in its
+// directory. The WiringPi ISRs and the SIGUSR1 handler take no arguments, they
+// are bound to the feeder which initialized the hardware
+typedef struct feederS {
+  char directory[FEEDER_FILE_NAME_LENGTH]; // Directory of the feeder files, empty for the working directory
+  feederClockS clock;
+  loggerS logger;
+  metricsS metrics;
+  lcd_paramsS lcd;
+  lcdStateMachineS lcdState;
+  buttonsS buttons;
+  feedingHopperS feedingHoppers[HOPPERS_COUNT];
+  uint32_t journalLines[HOPPERS_COUNT]; // Lines in the journal file of every hopper
+  dispenserS dispensers[HOPPERS_COUNT];
+  slaS sla;
+  motorS motors[HOPPERS_COUNT];
+  encoderS encoder;
+  traceS trace;
+  watchdogS watchdog;
+} feederS;
+
+void initFeederContext(feederS *feeder, const char *directory);
+
+#endif // context_h
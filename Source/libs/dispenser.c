@@ -0,0 +1,483 @@
+#include "dispenser.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <wiringPi.h>
+#include "../config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "motor.h"
+#include "feeding.h"
+#include "clock.h"
+#include "context.h"
+
+const char* dispenseSourceStrings[] = {
+  "Feeding",
+  "Catch-up",
+  "Treat"
+};
+
+// Scheduled feedings go before the late ones, a treat waits for both
+const uint8_t dispenseSourcePriorities[] = {
+  2,
+  1,
+  0
+};
+
+int8_t queueDispenseJob(feederS *feeder, uint8_t hopper, dispenseSourceE source, uint8_t portions, feedModeE mode, time_t scheduled);
+
+/*******************************************************************************
+* initDispenser
+*
+* @brief Starts a worker thread for every hopper of a feeder which runs its
+*        queued dispense jobs, so the main loop never waits for a motor
+*
+* @param[in] feeder The feeder
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t initDispenser(feederS *feeder) {
+  char logMessageBuffer[120];
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, dispenserWorker, &feeder->dispensers[i]) != 0) {
+      sprintf(logMessageBuffer, "Error: Unable to start dispenser %hhu: %s", i + 1, strerror(errno));
+      logMessage(feeder, ERROR, logMessageBuffer);
+      return 1;
+    }
+    pthread_detach(thread);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* queueDispense
+*
+* @brief Queues portions to be dispensed by the worker and returns at once. A
+*        request is coalesced with a waiting job of the same source and mode
+*        up to DISPENSER_MAX_JOB_PORTIONS, e.g. repeated presses of the feed
+*        button become a single move
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper to dispense from
+* @param[in] source Who requests the portions
+* @param[in] portions The amount of portions to dispense
+* @param[in] mode How the portions are dispensed
+*
+* @return 0 on success, -1 if the queue is full
+*******************************************************************************/
+int8_t queueDispense(feederS *feeder, uint8_t hopper, dispenseSourceE source, uint8_t portions, feedModeE mode) {
+  return queueDispenseJob(feeder, hopper, source, portions, mode, 0);
+}
+
+/*******************************************************************************
+* queueScheduledDispense
+*
+* @brief Queues the portions of a scheduled feeding. The job is timed from the
+*        due time of the feeding until it is done and never coalesced, so the
+*        latencies of every feeding are measured
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper to dispense from
+* @param[in] portions The amount of portions to dispense
+* @param[in] mode How the portions are dispensed
+* @param[in] scheduled Time the feeding was due
+*
+* @return 0 on success, -1 if the queue is full
+*******************************************************************************/
+int8_t queueScheduledDispense(feederS *feeder, uint8_t hopper, uint8_t portions, feedModeE mode, time_t scheduled) {
+  return queueDispenseJob(feeder, hopper, DISPENSE_SOURCE_SCHEDULE, portions, mode, scheduled);
+}
+
+/*******************************************************************************
+* queueDispenseJob
+*
+* @brief Queues a dispense job or coalesces it with a waiting one, see
+*        queueDispense. Jobs of scheduled feedings are never coalesced
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper to dispense from
+* @param[in] source Who requests the portions
+* @param[in] portions The amount of portions to dispense
+* @param[in] mode How the portions are dispensed
+* @param[in] scheduled Time the feeding was due, 0 if the job isn't timed
+*
+* @return 0 on success, -1 if the queue is full
+*******************************************************************************/
+int8_t queueDispenseJob(feederS *feeder, uint8_t hopper, dispenseSourceE source, uint8_t portions, feedModeE mode, time_t scheduled) {
+  char logMessageBuffer[120];
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+
+  if (portions == 0) return 0;
+
+  pthread_mutex_lock(&dispenser->mutex);
+
+  for (uint8_t i = 0; i < dispenser->queueLength; i++) {
+    dispenseJobS *job = &dispenser->queue[i];
+
+    if (job->source == source && job->mode == mode && job->portions + portions <= DISPENSER_MAX_JOB_PORTIONS &&
+        job->timing.scheduled == 0 && scheduled == 0) {
+      job->portions += portions;
+      pthread_mutex_unlock(&dispenser->mutex);
+
+      metricsHopperIncrement(feeder, hopper, METRIC_DISPENSE_JOBS_COALESCED);
+      return 0;
+    }
+  }
+
+  if (dispenser->queueLength >= DISPENSER_QUEUE_SIZE) {
+    pthread_mutex_unlock(&dispenser->mutex);
+
+    sprintf(logMessageBuffer, "Error: Dispense queue %hhu full, %hhu portions of %s dropped",
+      hopper + 1, portions, dispenseSourceStrings[source]);
+    logMessage(feeder, ERROR, logMessageBuffer);
+    return -1;
+  }
+
+  dispenser->queue[dispenser->queueLength++] = (dispenseJobS){
+    .id = dispenser->nextJobId++,
+    .hopper = hopper,
+    .source = source,
+    .priority = dispenseSourcePriorities[source],
+    .portions = portions,
+    .mode = mode,
+    .timing = {.scheduled = scheduled, .dispatched = scheduled != 0 ? getFeederWallMillis(feeder) : 0}
+  };
+
+  pthread_cond_signal(&dispenser->condition);
+  pthread_mutex_unlock(&dispenser->mutex);
+
+  return 0;
+}
+
+/*******************************************************************************
+* cancelDispense
+*
+* @brief Drops the waiting jobs of a hopper and stops its running one at once.
+*        The wheel may stop between two arms, the next move starts from the
+*        closest arm boundary again
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*******************************************************************************/
+void cancelDispense(feederS *feeder, uint8_t hopper) {
+  char logMessageBuffer[120];
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+  uint16_t droppedPortions = 0;
+
+  pthread_mutex_lock(&dispenser->mutex);
+
+  for (uint8_t i = 0; i < dispenser->queueLength; i++) {
+    droppedPortions += dispenser->queue[i].portions;
+  }
+  dispenser->queueLength = 0;
+
+  bool isRunning = dispenser->isDispensing;
+  if (isRunning) {
+    atomic_store(&dispenser->isCancelled, true);
+    setMotorStopRequest(getMotor(feeder, hopper), true);
+  }
+
+  pthread_mutex_unlock(&dispenser->mutex);
+
+  if (!isRunning && droppedPortions == 0) return;
+
+  metricsHopperIncrement(feeder, hopper, METRIC_DISPENSE_JOBS_CANCELLED);
+
+  sprintf(logMessageBuffer, "Dispensing of hopper %hhu cancelled, %hu waiting portions dropped", hopper + 1, droppedPortions);
+  logMessage(feeder, WARNING, logMessageBuffer);
+}
+
+/*******************************************************************************
+* getDispenseProgress
+*
+* @brief Returns the progress of the running job of a hopper and the size of
+*        its queue. Safe to call from any thread
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
+* @return The progress of the dispenser
+*******************************************************************************/
+dispenseProgressS getDispenseProgress(feederS *feeder, uint8_t hopper) {
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+  dispenseProgressS progress = {0};
+
+  pthread_mutex_lock(&dispenser->mutex);
+
+  progress.isDispensing = dispenser->isDispensing;
+  if (dispenser->isDispensing) {
+    progress.source = dispenser->runningJob.source;
+    progress.portions = dispenser->runningJob.portions;
+    progress.dispensed = atomic_load(&dispenser->dispensedPortions);
+    if (atomic_load(&dispenser->isBatchMoving)) progress.dispensed += getMotorStepsCompleted(getMotor(feeder, hopper));
+  }
+
+  progress.queuedJobs = dispenser->queueLength;
+  for (uint8_t i = 0; i < dispenser->queueLength; i++) {
+    progress.queuedPortions += dispenser->queue[i].portions;
+  }
+
+  pthread_mutex_unlock(&dispenser->mutex);
+
+  return progress;
+}
+
+/*******************************************************************************
+* getDispenseSourceName
+*
+* @brief Returns the name of a dispense source shown on the LCD
+*
+* @param[in] source The dispense source
+*
+* @return The name of the source
+*******************************************************************************/
+const char *getDispenseSourceName(dispenseSourceE source) {
+  return dispenseSourceStrings[source];
+}
+
+/*******************************************************************************
+* logDispenseStop
+*
+* @brief Logs a job which ended before all of its portions were dispensed
+*
+* @param[in] feeder The feeder
+* @param[in] job The job
+* @param[in] dispensed The amount of dispensed portions
+*******************************************************************************/
+void logDispenseStop(feederS *feeder, const dispenseJobS *job, uint16_t dispensed) {
+  char logMessageBuffer[120];
+
+  if (atomic_load(&feeder->dispensers[job->hopper].isCancelled)) {
+    sprintf(logMessageBuffer, "%s of hopper %hhu cancelled after %hu of %hhu portions",
+      dispenseSourceStrings[job->source], job->hopper + 1, dispensed, job->portions);
+    logMessage(feeder, WARNING, logMessageBuffer);
+  }
+  else {
+    sprintf(logMessageBuffer, "Error: %s of hopper %hhu stopped after %hu of %hhu portions",
+      dispenseSourceStrings[job->source], job->hopper + 1, dispensed, job->portions);
+    logMessage(feeder, ERROR, logMessageBuffer);
+  }
+}
+
+/*******************************************************************************
+* dispense
+*
+* @brief Dispenses the portions of a job. Stops at the first portion the motor
+*        fails to dispense or when the job is cancelled. In the batch modes all
+*        portions are a single move and the dispensed portions are counted from
+*        the encoder
+*
+* @param[in] feeder The feeder
+* @param[in] job The job to run
+*
+* @return The amount of dispensed portions
+*******************************************************************************/
+uint8_t dispense(feederS *feeder, const dispenseJobS *job) {
+  char logMessageBuffer[120];
+  dispenserS *dispenser = &feeder->dispensers[job->hopper];
+  motorS *motor = getMotor(feeder, job->hopper);
+  int32_t portionDegrees = 360 / getFeedingWheelArms(feeder, job->hopper);
+
+  if (job->mode != FEED_MODE_SEPARATE) {
+    uint16_t dwell = job->mode == FEED_MODE_DWELL ? FEEDING_BATCH_DWELL : 0;
+
+    atomic_store(&dispenser->isBatchMoving, true);
+    uint8_t result = rotateMotorInSteps(motor, job->portions * portionDegrees, portionDegrees, dwell);
+    recordDispenseStart(feeder, job->hopper, getLastMoveResult(motor).startTime);
+    uint16_t dispensed = getLastMoveResult(motor).stepsCompleted;
+    atomic_store(&dispenser->dispensedPortions, dispensed);
+    atomic_store(&dispenser->isBatchMoving, false);
+    metricsHopperAdd(feeder, job->hopper, METRIC_PORTIONS_DISPENSED, dispensed);
+
+    if (result != 0) {
+      logDispenseStop(feeder, job, dispensed);
+      return dispensed;
+    }
+  }
+  else {
+    for (uint8_t i = 0; i < job->portions; i++) {
+      if (atomic_load(&dispenser->isCancelled)) {
+        logDispenseStop(feeder, job, i);
+        return i;
+      }
+
+      uint8_t result = rotateMotor(motor, portionDegrees);
+      if (i == 0) recordDispenseStart(feeder, job->hopper, getLastMoveResult(motor).startTime);
+      if (result != 0) {
+        logDispenseStop(feeder, job, i);
+        return i;
+      }
+      atomic_store(&dispenser->dispensedPortions, i + 1);
+      metricsHopperIncrement(feeder, job->hopper, METRIC_PORTIONS_DISPENSED);
+      if (i + 1 < job->portions) delay(1000);
+    }
+  }
+
+  sprintf(logMessageBuffer, "%s: %hhu portions dispensed from hopper %hhu",
+    dispenseSourceStrings[job->source], job->portions, job->hopper + 1);
+  logMessage(feeder, INFO, logMessageBuffer);
+
+  return job->portions;
+}
+
+/*******************************************************************************
+* startDispenseJob
+*
+* @brief Starts the waiting job with the highest priority, of the same priority
+*        the one queued first. Called with the mutex of the dispenser held
+*
+* @param[in] dispenser The dispenser
+*******************************************************************************/
+void startDispenseJob(dispenserS *dispenser) {
+  dispenseJobS *queue = dispenser->queue;
+  uint8_t next = 0;
+  for (uint8_t i = 1; i < dispenser->queueLength; i++) {
+    if (queue[i].priority > queue[next].priority ||
+        (queue[i].priority == queue[next].priority && queue[i].id < queue[next].id)) {
+      next = i;
+    }
+  }
+
+  dispenser->runningJob = queue[next];
+  queue[next] = queue[--dispenser->queueLength];
+  dispenser->isDispensing = true;
+  atomic_store(&dispenser->dispensedPortions, 0);
+  atomic_store(&dispenser->isCancelled, false);
+  setMotorStopRequest(getMotor(dispenser->feeder, dispenser->hopper), false);
+}
+
+/*******************************************************************************
+* recordDispenseStart
+*
+* @brief Notes when the motor of the running scheduled feeding of a hopper was
+*        first driven. Later moves of the same job don't move the time
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] startTime Wall clock when the motor was first driven, 0 if it
+*                      never was [ms]
+*******************************************************************************/
+void recordDispenseStart(feederS *feeder, uint8_t hopper, uint64_t startTime) {
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+
+  if (startTime == 0) return;
+
+  pthread_mutex_lock(&dispenser->mutex);
+  feedTimingS *timing = &dispenser->runningJob.timing;
+  if (dispenser->isDispensing && timing->scheduled != 0 && timing->started == 0) {
+    timing->started = startTime;
+  }
+  pthread_mutex_unlock(&dispenser->mutex);
+}
+
+/*******************************************************************************
+* takeDispenseJob
+*
+* @brief Starts the next waiting job of a hopper of a feeder without dispenser
+*        workers, e.g. a simulated feeder whose motor is modelled by the
+*        simulation. The job runs until endDispenseJob is called
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[out] job The started job
+*
+* @return true if a job was started, false if a job runs or none is waiting
+*******************************************************************************/
+bool takeDispenseJob(feederS *feeder, uint8_t hopper, dispenseJobS *job) {
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+  bool isStarted = false;
+
+  pthread_mutex_lock(&dispenser->mutex);
+
+  if (!dispenser->isDispensing && dispenser->queueLength > 0) {
+    startDispenseJob(dispenser);
+    *job = dispenser->runningJob;
+    isStarted = true;
+  }
+
+  pthread_mutex_unlock(&dispenser->mutex);
+
+  return isStarted;
+}
+
+/*******************************************************************************
+* endDispenseJob
+*
+* @brief Marks the running job of a hopper as finished and records the
+*        latencies of a scheduled feeding which wasn't cancelled. A feeding
+*        whose motor was never driven counts as started when it finished. A
+*        feeding which dispensed fewer portions than due is counted as failed
+*        and kept out of the latencies
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] dispensed The amount of portions the job dispensed
+*******************************************************************************/
+void endDispenseJob(feederS *feeder, uint8_t hopper, uint8_t dispensed) {
+  char logMessageBuffer[120];
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+
+  pthread_mutex_lock(&dispenser->mutex);
+  bool isRunning = dispenser->isDispensing;
+  feedTimingS timing = dispenser->runningJob.timing;
+  uint8_t portions = dispenser->runningJob.portions;
+  dispenser->isDispensing = false;
+  dispenser->runningJob.timing.scheduled = 0;
+  pthread_mutex_unlock(&dispenser->mutex);
+
+  if (!isRunning || timing.scheduled == 0 || atomic_load(&dispenser->isCancelled)) return;
+
+  if (dispensed < portions) {
+    struct tm timeInfo;
+    getFeederLocalTime(feeder, timing.scheduled, &timeInfo);
+    sprintf(logMessageBuffer, "Feeding %02d:%02d of hopper %hhu failed, %hhu of %hhu portions dispensed",
+      timeInfo.tm_hour, timeInfo.tm_min, hopper + 1, dispensed, portions);
+    logMessage(feeder, ERROR, logMessageBuffer);
+
+    metricsHopperIncrement(feeder, hopper, METRIC_FEEDS_FAILED);
+    return;
+  }
+
+  timing.completed = getFeederWallMillis(feeder);
+  if (timing.started == 0) timing.started = timing.completed;
+  recordFeedingSla(feeder, hopper, &timing);
+}
+
+/*******************************************************************************
+* dispenserWorker
+*
+* @brief Worker thread of a hopper. Waits for jobs and runs them one at a
+*        time, the job with the highest priority first and jobs of the same
+*        priority in the order they were queued. Runs with a real-time
+*        priority, the control loop of the hopper's motor runs in this thread
+*
+* @param[in] arg The dispenser of the hopper
+*
+* @return Never returns
+*******************************************************************************/
+void *dispenserWorker(void *arg) {
+  dispenserS *dispenser = arg;
+  feederS *feeder = dispenser->feeder;
+
+  piHiPri(DISPENSER_PRIORITY);
+
+  while (1) {
+    pthread_mutex_lock(&dispenser->mutex);
+    while (dispenser->queueLength == 0) {
+      pthread_cond_wait(&dispenser->condition, &dispenser->mutex);
+    }
+    startDispenseJob(dispenser);
+    pthread_mutex_unlock(&dispenser->mutex);
+
+    uint8_t dispensed = dispense(feeder, &dispenser->runningJob);
+
+    endDispenseJob(feeder, dispenser->hopper, dispensed);
+  }
+
+  return NULL;
+}
@@ -0,0 +1,76 @@
+#ifndef dispenser_h
+#define dispenser_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "schedule.h"
+#include "sla.h"
+#include "../config.h"
+
+typedef struct feederS feederS; // Defined in context.h
+
+typedef enum {
+  DISPENSE_SOURCE_SCHEDULE, // Feeding due on time
+  DISPENSE_SOURCE_CATCH_UP, // Missed feeding fed late or merged
+  DISPENSE_SOURCE_TREAT, // Feed button
+  DISPENSE_SOURCES_COUNT
+} dispenseSourceE;
+
+typedef struct dispenseJobS {
+  uint32_t id; // Sequence number, jobs of the same priority run in this order
+  uint8_t hopper; // Hopper the portions are dispensed from
+  dispenseSourceE source; // Who requested the portions
+  uint8_t priority; // Jobs with a higher priority run first
+  uint8_t portions; // Portions to dispense
+  feedModeE mode; // How the portions are dispensed
+  feedTimingS timing; // Times of a scheduled feeding
+} dispenseJobS;
+
+typedef struct dispenseProgressS {
+  bool isDispensing; // Whether or not a job is running
+  dispenseSourceE source; // Source of the running job
+  uint8_t portions; // Portions of the running job
+  uint8_t dispensed; // Portions of the running job dispensed so far
+  uint8_t queuedJobs; // Jobs waiting for the running one
+  uint16_t queuedPortions; // Portions of the waiting jobs
+} dispenseProgressS;
+
+// Dispenser of a hopper, every hopper has its own queue and worker so the
+// motors dispense at the same time
+typedef struct dispenserS {
+  feederS *feeder; // Feeder the dispenser belongs to
+  uint8_t hopper; // Hopper the dispenser belongs to
+
+  // Jobs waiting for the worker, guarded by the mutex together with the
+  // running job
+  dispenseJobS queue[DISPENSER_QUEUE_SIZE];
+  uint8_t queueLength;
+  uint32_t nextJobId;
+  dispenseJobS runningJob;
+  bool isDispensing;
+  pthread_mutex_t mutex;
+  pthread_cond_t condition;
+
+  // Progress of the running job, written by the worker only
+  atomic_uint dispensedPortions; // Portions of the finished moves
+  atomic_bool isBatchMoving; // Whether or not the portions of a batch move are counted by the motor
+  atomic_bool isCancelled;
+} dispenserS;
+
+uint8_t initDispenser(feederS *feeder);
+int8_t queueDispense(feederS *feeder, uint8_t hopper, dispenseSourceE source, uint8_t portions, feedModeE mode);
+int8_t queueScheduledDispense(feederS *feeder, uint8_t hopper, uint8_t portions, feedModeE mode, time_t scheduled);
+void cancelDispense(feederS *feeder, uint8_t hopper);
+dispenseProgressS getDispenseProgress(feederS *feeder, uint8_t hopper);
+const char *getDispenseSourceName(dispenseSourceE source);
+void logDispenseStop(feederS *feeder, const dispenseJobS *job, uint16_t dispensed);
+uint8_t dispense(feederS *feeder, const dispenseJobS *job);
+void startDispenseJob(dispenserS *dispenser);
+void recordDispenseStart(feederS *feeder, uint8_t hopper, uint64_t startTime);
+bool takeDispenseJob(feederS *feeder, uint8_t hopper, dispenseJobS *job);
+void endDispenseJob(feederS *feeder, uint8_t hopper, uint8_t dispensed);
+void *dispenserWorker(void *arg);
+
+#endif // dispenser_h
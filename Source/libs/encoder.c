@@ -0,0 +1,495 @@
+#define _GNU_SOURCE
+#include "encoder.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <math.h>
+#include <time.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <wiringPi.h>
+#include "../config.h"
+#include "tools.h"
+#include "logger.h"
+#include "metrics.h"
+#include "motor.h"
+#include "watchdog.h"
+#include "context.h"
+
+const char* encoderSamplingStrings[] = {
+  "interrupt",
+  "polling",
+  "adaptive"
+};
+
+void encoderIndex1ISR();
+void encoderIndex2ISR();
+
+// WiringPi ISRs take no arguments, one per motor
+void (*const encoderIndexISRs[HOPPERS_MAX])(void) = {
+  encoderIndex1ISR,
+  encoderIndex2ISR
+};
+
+/*******************************************************************************
+* registerEncoderISRs
+*
+* @brief Registers the ISR of a motor for both of its encoder channels
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t registerEncoderISRs(motorS *motor) {
+  char logMessageBuffer[120];
+
+  if (wiringPiISR(motor->pins.encoderA, INT_EDGE_BOTH, motor->encoderISR) < 0) {
+    sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(motor->pins.encoderA), strerror(errno));
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  if (wiringPiISR(motor->pins.encoderB, INT_EDGE_BOTH, motor->encoderISR) < 0) {
+    sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(motor->pins.encoderB), strerror(errno));
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* sampleEncoder
+*
+* @brief Reads both channels of the encoder of a motor once and decodes a change
+*
+* @param[in] motor The motor
+*******************************************************************************/
+void sampleEncoder(motorS *motor) {
+  metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_ENCODER_SAMPLES);
+  if (updateEncoder(motor, readEncoderState(motor)) != 0) {
+    metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_ENCODER_EDGES);
+  }
+}
+
+/*******************************************************************************
+* isEncoderPollingRequested
+*
+* @brief Returns whether or not any motor of a feeder requests polling
+*
+* @param[in] feeder The feeder
+*
+* @return true if polling is requested
+*******************************************************************************/
+bool isEncoderPollingRequested(feederS *feeder) {
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    if (atomic_load(&getMotor(feeder, i)->encoderRequestedMode) == ENCODER_MODE_POLLING) return true;
+  }
+
+  return false;
+}
+
+/*******************************************************************************
+* encoderPollingThread
+*
+* @brief Samples the encoders of the motors which request polling and waits for
+*        the next request while none does. Pinned to its own CPU the thread
+*        samples continuously, otherwise at ENCODER_POLL_UNPINNED_PERIOD at
+*        most. The decoder only depends on the sequence of AB states, so the
+*        ISRs and the thread can both decode the same edges while one takes
+*        over from the other. Sampling starts before the ISRs are stopped and
+*        ends after they are registered again, with a last sample for an edge
+*        which came while the ISRs were registered
+*
+* @param[in] arg The feeder
+*
+* @return Never returns
+*******************************************************************************/
+void *encoderPollingThread(void *arg) {
+  feederS *feeder = arg;
+  encoderS *encoder = &feeder->encoder;
+  char logMessageBuffer[120];
+  bool isPinned = false;
+
+  if (ENCODER_POLL_CPU >= 0 && ENCODER_POLL_CPU < sysconf(_SC_NPROCESSORS_ONLN)) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(ENCODER_POLL_CPU, &cpus);
+    isPinned = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) == 0;
+  }
+  if (!isPinned) {
+    sprintf(logMessageBuffer, "Unable to pin encoder polling to CPU %d, sampling at least every %d us",
+      ENCODER_POLL_CPU, ENCODER_POLL_UNPINNED_PERIOD);
+    logMessage(feeder, WARNING, logMessageBuffer);
+  }
+  piHiPri(ENCODER_POLL_PRIORITY);
+
+  while (1) {
+    pthread_mutex_lock(&encoder->modeMutex);
+    while (!isEncoderPollingRequested(feeder)) {
+      pthread_cond_wait(&encoder->modeRequest, &encoder->modeMutex);
+    }
+    pthread_mutex_unlock(&encoder->modeMutex);
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+    bool isPolling = true;
+    while (isPolling) {
+      isPolling = false;
+
+      for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+        motorS *motor = getMotor(feeder, i);
+        encoderModeE requestedMode = atomic_load(&motor->encoderRequestedMode);
+
+        if (requestedMode == ENCODER_MODE_POLLING && atomic_load(&motor->encoderMode) != ENCODER_MODE_POLLING) {
+          // Take over from the ISRs
+          sampleEncoder(motor);
+          atomic_store(&motor->encoderMode, ENCODER_MODE_POLLING);
+          wiringPiISRStop(motor->pins.encoderA);
+          wiringPiISRStop(motor->pins.encoderB);
+          metricsHopperIncrement(feeder, i, METRIC_ENCODER_MODE_SWITCHES);
+        }
+        else if (requestedMode != ENCODER_MODE_POLLING && atomic_load(&motor->encoderMode) == ENCODER_MODE_POLLING) {
+          // Hand back to the ISRs
+          registerEncoderISRs(motor);
+          sampleEncoder(motor);
+          atomic_store(&motor->encoderMode, ENCODER_MODE_INTERRUPT);
+          metricsHopperIncrement(feeder, i, METRIC_ENCODER_MODE_SWITCHES);
+        }
+
+        if (atomic_load(&motor->encoderMode) == ENCODER_MODE_POLLING) {
+          sampleEncoder(motor);
+          isPolling = true;
+        }
+      }
+
+      if (!isPolling) break;
+
+      // Sampling continuously at real-time priority would starve every other
+      // thread on the same CPU
+      uint32_t periodNs = atomic_load(&encoder->pollPeriod) * 1000;
+      if (!isPinned && periodNs < ENCODER_POLL_UNPINNED_PERIOD * 1000) periodNs = ENCODER_POLL_UNPINNED_PERIOD * 1000;
+      if (periodNs == 0) continue;
+
+      deadline.tv_nsec += periodNs;
+      while (deadline.tv_nsec >= 1000000000) {
+        deadline.tv_nsec -= 1000000000;
+        deadline.tv_sec++;
+      }
+      clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+    }
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* initEncoder
+*
+* @brief Registers the encoder ISRs of all motors of a feeder and starts its
+*        polling thread, which waits until a motor requests polling
+*
+* @param[in] feeder The feeder
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t initEncoder(feederS *feeder) {
+  char logMessageBuffer[120];
+  encoderS *encoder = &feeder->encoder;
+
+  atomic_store(&encoder->sampling, ENCODER_SAMPLING);
+  atomic_store(&encoder->pollPeriod, ENCODER_POLL_PERIOD);
+  pthread_mutex_init(&encoder->modeMutex, NULL);
+  pthread_cond_init(&encoder->modeRequest, NULL);
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    if (registerEncoderISRs(getMotor(feeder, i)) != 0) return 1;
+  }
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, encoderPollingThread, feeder) != 0) {
+    sprintf(logMessageBuffer, "Error: Unable to start encoder polling: %s", strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+  pthread_detach(thread);
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    requestEncoderMode(getMotor(feeder, i), atomic_load(&encoder->sampling) == ENCODER_SAMPLING_POLLING ?
+      ENCODER_MODE_POLLING : ENCODER_MODE_INTERRUPT);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* setEncoderSampling
+*
+* @brief Sets how the encoders of a feeder are sampled. A fixed mode is
+*        requested right away
+*
+* @param[in] feeder The feeder
+* @param[in] sampling The sampling
+*******************************************************************************/
+void setEncoderSampling(feederS *feeder, encoderSamplingE sampling) {
+  if (sampling >= ENCODER_SAMPLINGS_COUNT) return;
+
+  atomic_store(&feeder->encoder.sampling, sampling);
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    requestEncoderMode(getMotor(feeder, i), sampling == ENCODER_SAMPLING_POLLING ? ENCODER_MODE_POLLING : ENCODER_MODE_INTERRUPT);
+  }
+}
+
+/*******************************************************************************
+* getEncoderSampling
+*
+* @brief Returns how the encoders of a feeder are sampled
+*
+* @param[in] feeder The feeder
+*
+* @return The sampling
+*******************************************************************************/
+encoderSamplingE getEncoderSampling(feederS *feeder) {
+  return atomic_load(&feeder->encoder.sampling);
+}
+
+/*******************************************************************************
+* setEncoderPollPeriod
+*
+* @brief Sets the sampling period of the polling thread of a feeder
+*
+* @param[in] feeder The feeder
+* @param[in] period Sampling period, 0 to sample continuously [us]
+*******************************************************************************/
+void setEncoderPollPeriod(feederS *feeder, uint32_t period) {
+  atomic_store(&feeder->encoder.pollPeriod, period);
+}
+
+/*******************************************************************************
+* getEncoderMode
+*
+* @brief Returns the mode currently counting the encoder edges of a motor
+*
+* @param[in] motor The motor
+*
+* @return The encoder mode
+*******************************************************************************/
+encoderModeE getEncoderMode(motorS *motor) {
+  return atomic_load(&motor->encoderMode);
+}
+
+/*******************************************************************************
+* requestEncoderMode
+*
+* @brief Requests a switch of the encoder mode of a motor, which the polling
+*        thread makes. A fixed sampling overrides the requested mode. Cheap if
+*        the mode doesn't change, so it can be called every control period
+*
+* @param[in] motor The motor
+* @param[in] mode The requested mode
+*******************************************************************************/
+void requestEncoderMode(motorS *motor, encoderModeE mode) {
+  encoderS *encoder = &motor->feeder->encoder;
+  encoderSamplingE sampling = atomic_load(&encoder->sampling);
+  if (sampling == ENCODER_SAMPLING_INTERRUPT) mode = ENCODER_MODE_INTERRUPT;
+  if (sampling == ENCODER_SAMPLING_POLLING) mode = ENCODER_MODE_POLLING;
+
+  if (atomic_exchange(&motor->encoderRequestedMode, mode) == (int)mode) return;
+
+  pthread_mutex_lock(&encoder->modeMutex);
+  pthread_cond_signal(&encoder->modeRequest);
+  pthread_mutex_unlock(&encoder->modeMutex);
+}
+
+/*******************************************************************************
+* updateEncoderMode
+*
+* @brief Requests polling once the wheel is faster than ENCODER_POLLING_VELOCITY
+*        and edge interrupts once it is slower than ENCODER_INTERRUPT_VELOCITY
+*
+* @param[in] motor The motor
+* @param[in] velocity Encoder velocity [ticks/s]
+*******************************************************************************/
+void updateEncoderMode(motorS *motor, float velocity) {
+  float speed = fabsf(velocity) / getEncoderTicksPerDegree(motor);
+  encoderModeE requestedMode = atomic_load(&motor->encoderRequestedMode);
+
+  if (requestedMode == ENCODER_MODE_INTERRUPT && speed >= ENCODER_POLLING_VELOCITY) {
+    requestEncoderMode(motor, ENCODER_MODE_POLLING);
+  }
+  else if (requestedMode == ENCODER_MODE_POLLING && speed < ENCODER_INTERRUPT_VELOCITY) {
+    requestEncoderMode(motor, ENCODER_MODE_INTERRUPT);
+  }
+}
+
+/*******************************************************************************
+* getEncoderSamplingName
+*
+* @brief Returns the name of an encoder sampling
+*
+* @param[in] sampling The sampling
+*
+* @return The name of the sampling
+*******************************************************************************/
+const char *getEncoderSamplingName(encoderSamplingE sampling) {
+  return sampling < ENCODER_SAMPLINGS_COUNT ? encoderSamplingStrings[sampling] : "unknown";
+}
+
+/*******************************************************************************
+* encoderIndexISR
+*
+* @brief ISR for the index sensor of a motor. Records the encoder position at
+*        the start of every index pulse. The ISR thread runs after the edge, so
+*        the position is moved back to the edge time with the timestamp and the
+*        period of the last encoder edge. Pulses closer than half a revolution
+*        to the last one are bounces of the same mark
+*
+* @param[in] motor The motor
+*******************************************************************************/
+void encoderIndexISR(motorS *motor) {
+  if (digitalRead(motor->pins.index) != LOW) return;
+
+  uint32_t indexTime = micros();
+  uint64_t timing;
+  int64_t position;
+  do {
+    timing = atomic_load(&motor->encoderEdgeTiming);
+    position = getEncoderPosition(motor);
+  } while (timing != atomic_load(&motor->encoderEdgeTiming));
+
+  // Edges counted after the index edge are taken back, edges between the last
+  // counted one and the index edge are added
+  int32_t edgePeriod = atomic_load(&motor->encoderEdgePeriod);
+  int32_t sinceEdge = (int32_t)(indexTime - (uint32_t)(timing >> 32));
+  if (edgePeriod != 0 && abs(sinceEdge) < MOTOR_VELOCITY_TIMEOUT * 1000) {
+    int32_t period = abs(edgePeriod);
+    int32_t steps = sinceEdge >= 0 ? sinceEdge / period : -((-sinceEdge + period - 1) / period);
+    position += edgePeriod > 0 ? steps : -steps;
+  }
+
+  uint32_t pulses = atomic_load(&motor->encoderIndexPulses);
+  if (pulses > ENCODER_CALIBRATION_REVOLUTIONS) return;
+
+  if (pulses > 0 &&
+      llabs(position - atomic_load(&motor->encoderIndexPositions[pulses - 1])) < MOTOR_ENCODER_TICKS_PER_DEGREE * 180) {
+    return;
+  }
+
+  atomic_store(&motor->encoderIndexPositions[pulses], position);
+  atomic_store(&motor->encoderIndexPulses, pulses + 1);
+}
+
+/*******************************************************************************
+* encoderIndex1ISR
+*
+* @brief ISR for the index sensor of the first motor
+*******************************************************************************/
+void encoderIndex1ISR() {
+  encoderIndexISR(getInterruptMotor(0));
+}
+
+/*******************************************************************************
+* encoderIndex2ISR
+*
+* @brief ISR for the index sensor of the second motor
+*******************************************************************************/
+void encoderIndex2ISR() {
+  encoderIndexISR(getInterruptMotor(HOPPERS_COUNT - 1));
+}
+
+/*******************************************************************************
+* calibrateEncoder
+*
+* @brief Measures the encoder ticks per revolution of the wheel with the index
+*        sensor. The wheel turns at ENCODER_CALIBRATION_DUTY until the index
+*        passed ENCODER_CALIBRATION_REVOLUTIONS + 1 times, the ticks between the
+*        first and the last pulse are averaged. The result is rejected if the
+*        single revolutions differ by more than ENCODER_CALIBRATION_SPREAD ticks
+*        or it is further than ENCODER_CALIBRATION_TOLERANCE from the nominal
+*        gear ratio, otherwise it is saved and used by the next moves
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t calibrateEncoder(motorS *motor) {
+  char logMessageBuffer[120];
+  int8_t indexPin = motor->pins.index;
+
+  if (indexPin < 0) {
+    sprintf(logMessageBuffer, "Encoder %hhu calibration needs the index sensor, its pin is not set", motor->hopper + 1);
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  sprintf(logMessageBuffer, "Calibrating encoder %hhu ticks per revolution", motor->hopper + 1);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  pinMode(indexPin, INPUT);
+  pullUpDnControl(indexPin, PUD_UP);
+  atomic_store(&motor->encoderIndexPulses, 0);
+
+  if (wiringPiISR(indexPin, INT_EDGE_FALLING, encoderIndexISRs[motor->hopper]) < 0) {
+    sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(indexPin), strerror(errno));
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  watchdogBeginMove(motor->feeder, motor->hopper);
+  watchdogSetPhase(motor->feeder, motor->hopper, WATCHDOG_PHASE_MOVING);
+
+  uint32_t startTime = millis();
+  driveMotor(motor, ENCODER_CALIBRATION_DUTY * MOTOR_PWM_RANGE);
+  while (atomic_load(&motor->encoderIndexPulses) <= ENCODER_CALIBRATION_REVOLUTIONS &&
+         millis() - startTime < ENCODER_CALIBRATION_TIMEOUT && !watchdogIsMoveAborted(motor->feeder, motor->hopper)) {
+    delay(10);
+  }
+  stopMotor(motor);
+
+  watchdogEndMove(motor->feeder, motor->hopper);
+  wiringPiISRStop(indexPin);
+
+  uint32_t pulses = atomic_load(&motor->encoderIndexPulses);
+  if (pulses <= ENCODER_CALIBRATION_REVOLUTIONS) {
+    sprintf(logMessageBuffer, "Encoder calibration failed, %u of %d index pulses seen",
+      pulses, ENCODER_CALIBRATION_REVOLUTIONS + 1);
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  // Missed or late index pulses show up as revolutions of different length
+  int64_t minTicks = INT64_MAX;
+  int64_t maxTicks = 0;
+  for (uint8_t i = 0; i < ENCODER_CALIBRATION_REVOLUTIONS; i++) {
+    int64_t revolution = llabs(atomic_load(&motor->encoderIndexPositions[i + 1]) -
+      atomic_load(&motor->encoderIndexPositions[i]));
+    if (revolution < minTicks) minTicks = revolution;
+    if (revolution > maxTicks) maxTicks = revolution;
+  }
+
+  if (maxTicks - minTicks > ENCODER_CALIBRATION_SPREAD) {
+    sprintf(logMessageBuffer, "Encoder calibration rejected, revolutions between %lld and %lld ticks",
+      (long long)minTicks, (long long)maxTicks);
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  float ticks = llabs(atomic_load(&motor->encoderIndexPositions[ENCODER_CALIBRATION_REVOLUTIONS]) -
+    atomic_load(&motor->encoderIndexPositions[0])) / (float)ENCODER_CALIBRATION_REVOLUTIONS;
+  float nominal = MOTOR_ENCODER_TICKS_PER_DEGREE * 360;
+
+  if (fabsf(ticks - nominal) > nominal * ENCODER_CALIBRATION_TOLERANCE) {
+    sprintf(logMessageBuffer, "Encoder calibration rejected, %.2f ticks per revolution, nominal %.2f", ticks, nominal);
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  setEncoderTicksPerRevolution(motor, ticks);
+
+  return 0;
+}
@@ -0,0 +1,41 @@
+#ifndef encoder_h
+#define encoder_h
+
+#include <stdint.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "motor.h"
+
+typedef enum {
+  ENCODER_MODE_INTERRUPT, // Edge interrupts, while the wheel is slow or stopped
+  ENCODER_MODE_POLLING, // Sampling thread, while the wheel is fast
+  ENCODER_MODES_COUNT
+} encoderModeE;
+
+typedef enum {
+  ENCODER_SAMPLING_INTERRUPT, // Always edge interrupts
+  ENCODER_SAMPLING_POLLING, // Always the sampling thread
+  ENCODER_SAMPLING_ADAPTIVE, // Switch by the velocity of the wheel
+  ENCODER_SAMPLINGS_COUNT
+} encoderSamplingE;
+
+// Sampling of the encoders of a feeder, shared by all of its motors
+typedef struct encoderS {
+  atomic_int sampling; // encoderSamplingE
+  atomic_uint pollPeriod; // [us]
+  pthread_mutex_t modeMutex;
+  pthread_cond_t modeRequest; // Signalled when a motor requests another mode
+} encoderS;
+
+uint8_t initEncoder(feederS *feeder);
+void setEncoderSampling(feederS *feeder, encoderSamplingE sampling);
+encoderSamplingE getEncoderSampling(feederS *feeder);
+void setEncoderPollPeriod(feederS *feeder, uint32_t period);
+encoderModeE getEncoderMode(motorS *motor);
+void requestEncoderMode(motorS *motor, encoderModeE mode);
+void updateEncoderMode(motorS *motor, float velocity);
+const char *getEncoderSamplingName(encoderSamplingE sampling);
+void encoderIndexISR(motorS *motor);
+uint8_t calibrateEncoder(motorS *motor);
+
+#endif // encoder_h
@@ -1,41 +1,187 @@
 #include "feeding.h"
 #include <string.h>
+#include <stdlib.h>
 #include "motor.h"
 #include <wiringPi.h>
+#include "tools.h"
 #include "logger.h"
+#include "metrics.h"
+#include "journal.h"
+#include "dispenser.h"
+#include "../config.h"
+#include "clock.h"
+#include "context.h"
+
+const char* feedModeStrings[] = {
+  "separate",
+  "batch",
+  "dwell"
+};
+
+// Weekday letters of the feeding.cfg file from Monday to Sunday
+const char weekdayLetters[] = "MTWTFSS";
 
-feedingScheduleS feedingSchedule = {0};
+/*******************************************************************************
+* invalidateSchedule
+*
+* @brief Marks the compiled days and the next feeding as outdated after a
+*        change of the schedule
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*******************************************************************************/
+void invalidateSchedule(feederS *feeder, uint8_t hopper) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+
+  feeding->compiledDays[0].date = 0;
+  feeding->compiledDays[1].date = 0;
+  feeding->isNextFeedingValid = false;
+}
+
+/*******************************************************************************
+* dateOf
+*
+* @brief Converts a broken-down local time to a date
+*
+* @param[in] timeInfo The local time
+*
+* @return The date as YYYYMMDD
+*******************************************************************************/
+uint32_t dateOf(const struct tm *timeInfo) {
+  return (timeInfo->tm_year + 1900) * 10000 + (timeInfo->tm_mon + 1) * 100 + timeInfo->tm_mday;
+}
+
+/*******************************************************************************
+* saveFeedingTime
+*
+* @brief Writes a feeding time as a line of the feeding.cfg file. Weekdays and
+*        dates are only written when they limit the feeding time
+*
+* @param[in] fp The file
+* @param[in] entry The feeding time
+*******************************************************************************/
+void saveFeedingTime(FILE *fp, const feedingTimeS *entry) {
+  fprintf(fp, "%hhu:%hhu - %hhu %s", entry->hour, entry->minute, entry->portions, feedModeStrings[entry->mode]);
+
+  if (entry->weekdays != SCHEDULE_ALL_DAYS) {
+    char days[8] = {0};
+    for (uint8_t i = 0; i < 7; i++) {
+      days[i] = entry->weekdays & (1 << ((i + 1) % 7)) ? weekdayLetters[i] : '-';
+    }
+    fprintf(fp, " days %s", days);
+  }
+  if (entry->firstDate != 0) {
+    fprintf(fp, " from %04u-%02u-%02u", entry->firstDate / 10000, entry->firstDate / 100 % 100, entry->firstDate % 100);
+  }
+  if (entry->lastDate != 0) {
+    fprintf(fp, " until %04u-%02u-%02u", entry->lastDate / 10000, entry->lastDate / 100 % 100, entry->lastDate % 100);
+  }
+
+  fprintf(fp, "\n");
+}
+
+/*******************************************************************************
+* saveFeedingTimes
+*
+* @brief Writes the feeding times of a subtree in their order
+*
+* @param[in] fp The file
+* @param[in] node Root of the subtree
+*******************************************************************************/
+void saveFeedingTimes(FILE *fp, const scheduleNodeS *node) {
+  if (node == NULL) return;
+
+  saveFeedingTimes(fp, node->left);
+  saveFeedingTime(fp, &node->entry);
+  saveFeedingTimes(fp, node->right);
+}
 
 /*******************************************************************************
 * saveFeedingSchedule
 *
-* @brief Saves the feeding schedule to the feeding.cfg file
+* @brief Saves the feeding schedule of a hopper to its feeding.cfg file
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 *
 * @return 0 on success, -1 on failure
 *******************************************************************************/
-int8_t saveFeedingSchedule() {
+int8_t saveFeedingSchedule(feederS *feeder, uint8_t hopper) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
   char logMessageBuffer[120];
+  char fileName[FEEDER_FILE_NAME_LENGTH];
 
-  FILE *fp = fopen("feeding.cfg", "w");
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, FEEDING_SCHEDULE_FILE, hopper);
+  FILE *fp = fopen(fileName, "w");
   if (fp == NULL) {
-    sprintf(logMessageBuffer, "Error during feeding schedule saving: %s", strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
+    sprintf(logMessageBuffer, "Error during feeding schedule %hhu saving: %s", hopper + 1, strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
     return -1;
   }
 
-  fprintf(fp, "arms: %hhu\n", feedingSchedule.feedingWheelArms);
-
-  for (uint8_t i = 0; i < feedingSchedule.activeFeedingTimes; i++) {
-    fprintf(fp, "%hhu:%hhu - %hhu\n", feedingSchedule.feedingTime[i].hour, feedingSchedule.feedingTime[i].minute, feedingSchedule.feedingTime[i].portions);
-  }
+  fprintf(fp, "arms: %hhu\n", feeding->schedule.feedingWheelArms);
+  saveFeedingTimes(fp, feeding->schedule.feedingTimes);
 
   fclose(fp);
 
-  sprintf(logMessageBuffer, "Saved feeding schedule with %hhu active feedings "
-    "times. Feeding wheel configured with %hhu arms",
-    feedingSchedule.activeFeedingTimes,
-    feedingSchedule.feedingWheelArms);
-  logMessage(INFO, logMessageBuffer);
+  sprintf(logMessageBuffer, "Saved feeding schedule %hhu with %u active feedings "
+    "times. Feeding wheel configured with %hhu arms", hopper + 1,
+    scheduleSize(feeding->schedule.feedingTimes),
+    feeding->schedule.feedingWheelArms);
+  logMessage(feeder, INFO, logMessageBuffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+* parseFeedingTime
+*
+* @brief Parses a line of the feeding.cfg file, e.g.
+*        "8:30 - 2 batch days MTWTF-- from 2024-06-01 until 2024-06-14". The
+*        mode, the weekdays and the dates are optional, a feeding time without
+*        them is fed every day in the default mode
+*
+* @param[in] line The line
+* @param[out] entry The parsed feeding time
+*
+* @return 0 on success, -1 if the line isn't a feeding time
+*******************************************************************************/
+int8_t parseFeedingTime(const char *line, feedingTimeS *entry) {
+  char mode[16];
+  int length = 0;
+
+  *entry = (feedingTimeS){.mode = FEEDING_DEFAULT_MODE, .weekdays = SCHEDULE_ALL_DAYS};
+
+  if (sscanf(line, "%hhu:%hhu - %hhu%n", &entry->hour, &entry->minute, &entry->portions, &length) != 3) return -1;
+  if (entry->hour > 23 || entry->minute > 59) return -1;
+  line += length;
+
+  if (sscanf(line, " %15s%n", mode, &length) == 1) {
+    for (uint8_t i = 0; i < FEED_MODES_COUNT; i++) {
+      if (strcmp(mode, feedModeStrings[i]) == 0) {
+        entry->mode = i;
+        line += length;
+      }
+    }
+  }
+
+  char key[8];
+  char value[16];
+  while (sscanf(line, " %7s %15s%n", key, value, &length) == 2) {
+    line += length;
+    unsigned year, month, day;
+
+    if (strcmp(key, "days") == 0 && strlen(value) == 7) {
+      entry->weekdays = 0;
+      for (uint8_t i = 0; i < 7; i++) {
+        if (value[i] != '-') entry->weekdays |= 1 << ((i + 1) % 7);
+      }
+    }
+    else if (sscanf(value, "%u-%u-%u", &year, &month, &day) == 3) {
+      if (strcmp(key, "from") == 0) entry->firstDate = year * 10000 + month * 100 + day;
+      if (strcmp(key, "until") == 0) entry->lastDate = year * 10000 + month * 100 + day;
+    }
+  }
 
   return 0;
 }
@@ -43,50 +189,58 @@ int8_t saveFeedingSchedule() {
 /*******************************************************************************
 * loadFeedingSchedule
 *
-* @brief Loads the feeding schedule from the feeding.cfg file
+* @brief Loads the feeding schedule of a hopper from its feeding.cfg file
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 *
 * @return 0 on success, -1 on failure
 *******************************************************************************/
-int8_t loadFeedingSchedule() {
+int8_t loadFeedingSchedule(feederS *feeder, uint8_t hopper) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
   char logMessageBuffer[120];
+  char fileName[FEEDER_FILE_NAME_LENGTH];
 
-  FILE *fp = fopen("feeding.cfg", "r");
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, FEEDING_SCHEDULE_FILE, hopper);
+  FILE *fp = fopen(fileName, "r");
   if (fp == NULL) {
-    sprintf(logMessageBuffer, "Error during feeding schedule loading: %s", strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
-    feedingSchedule.feedingWheelArms = 4;
+    sprintf(logMessageBuffer, "Error during feeding schedule %hhu loading: %s", hopper + 1, strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
+    feeding->schedule.feedingWheelArms = 4;
     return -1;
   }
 
-  char line[20];
-  uint8_t index = 0;
+  char line[80];
+  feedingTimeS entry;
 
   if (fgets(line, sizeof(line), fp) != NULL) {
-    sscanf(line, "arms: %hhu", &feedingSchedule.feedingWheelArms);
+    sscanf(line, "arms: %hhu", &feeding->schedule.feedingWheelArms);
   }
   else {
-    feedingSchedule.feedingWheelArms = 4;
+    feeding->schedule.feedingWheelArms = 4;
+    fclose(fp);
     return -1;
   }
 
-  while (fgets(line, sizeof(line), fp) != NULL && index < 10) {
-    if (3 == sscanf(line, "%hhu:%hhu - %hhu",
-      &feedingSchedule.feedingTime[index].hour,
-      &feedingSchedule.feedingTime[index].minute,
-      &feedingSchedule.feedingTime[index].portions)) {
-      index++;
+  scheduleClear(&feeding->schedule.feedingTimes);
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (parseFeedingTime(line, &entry) != 0) continue;
+
+    if (scheduleInsert(&feeding->schedule.feedingTimes, &entry) != 0) {
+      sprintf(logMessageBuffer, "Skipped duplicate feeding time %hhu:%hhu", entry.hour, entry.minute);
+      logMessage(feeder, WARNING, logMessageBuffer);
     }
-    feedingSchedule.activeFeedingTimes++;
   }
 
   fclose(fp);
+  invalidateSchedule(feeder, hopper);
 
-  sprintf(logMessageBuffer, "Loaded feeding schedule with %hhu active feedings "
-    "times. Feeding wheel configured with %hhu arms",
-    feedingSchedule.activeFeedingTimes,
-    feedingSchedule.feedingWheelArms);
+  sprintf(logMessageBuffer, "Loaded feeding schedule %hhu with %u active feedings "
+    "times. Feeding wheel configured with %hhu arms", hopper + 1,
+    scheduleSize(feeding->schedule.feedingTimes),
+    feeding->schedule.feedingWheelArms);
 
-  logMessage(INFO, logMessageBuffer);
+  logMessage(feeder, INFO, logMessageBuffer);
 
   return 0;
 }
@@ -97,101 +251,225 @@ int8_t loadFeedingSchedule() {
 * @brief Modifies the feeding time at the specified index and reorders it in the
 *        schedule by removing and adding it again
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] index The index of the feeding time to modify
 * @param[in] hour The new hour for the feeding time
 * @param[in] minute The new minute for the feeding time
 *******************************************************************************/
-void saveModifiedFeedingTime(uint8_t index, uint8_t hour, uint8_t minute) {
-  uint8_t portions = feedingSchedule.feedingTime[index].portions;
-
-  removeFeedingTime(index);
-
-  addFeedingTime(hour, minute, portions);
+void saveModifiedFeedingTime(feederS *feeder, uint8_t hopper, uint16_t index, uint8_t hour, uint8_t minute) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *selected = scheduleSelect(feeding->schedule.feedingTimes, index);
+  if (selected == NULL) return;
+
+  feedingTimeS entry = *selected;
+  feedingTimeS previous = entry;
+  scheduleRemove(&feeding->schedule.feedingTimes, &entry);
+
+  entry.hour = hour;
+  entry.minute = minute;
+  if (addFeedingTimeEntry(feeder, hopper, &entry) != 0) {
+    scheduleInsert(&feeding->schedule.feedingTimes, &previous);
+    return;
+  }
 
   char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Feeding time index %hhu modified. New time %hhu:%hhu", index, hour, minute);
-  logMessage(INFO, logMessageBuffer);
+  sprintf(logMessageBuffer, "Feeding time index %hu modified. New time %hhu:%hhu", index, hour, minute);
+  logMessage(feeder, INFO, logMessageBuffer);
 }
 
 /*******************************************************************************
 * removeFeedingTime
 *
-* @brief Removes a feeding time from the schedule and shifts the rest of the
-* schedule
+* @brief Removes a feeding time from the schedule
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] index The index of the feeding time to remove
 *******************************************************************************/
-void removeFeedingTime(uint8_t index) {
-  uint8_t i;
-
-  // Reset values at index
-  feedingSchedule.feedingTime[index].hour = 0;
-  feedingSchedule.feedingTime[index].minute = 0;
-  feedingSchedule.feedingTime[index].portions = 0;
-  feedingSchedule.activeFeedingTimes--;
-
-  // Shift the rest of the schedule up one index
-  for (i = index; i < feedingSchedule.activeFeedingTimes; i++) {
-    feedingSchedule.feedingTime[i].hour = feedingSchedule.feedingTime[i + 1].hour;
-    feedingSchedule.feedingTime[i].minute = feedingSchedule.feedingTime[i + 1].minute;
-    feedingSchedule.feedingTime[i].portions = feedingSchedule.feedingTime[i + 1].portions;
-  }
+void removeFeedingTime(feederS *feeder, uint8_t hopper, uint16_t index) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *selected = scheduleSelect(feeding->schedule.feedingTimes, index);
+  if (selected == NULL) return;
 
-  // Clear the last entry
-  feedingSchedule.feedingTime[i].hour = 0;
-  feedingSchedule.feedingTime[i].minute = 0;
-  feedingSchedule.feedingTime[i].portions = 0;
+  feedingTimeS entry = *selected;
+  scheduleRemove(&feeding->schedule.feedingTimes, &entry);
+  invalidateSchedule(feeder, hopper);
 
   char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Removed feeding time with index: %hhu", index);
-  logMessage(INFO, logMessageBuffer);
+  sprintf(logMessageBuffer, "Removed feeding time with index: %hu", index);
+  logMessage(feeder, INFO, logMessageBuffer);
 
-  saveFeedingSchedule();
+  saveFeedingSchedule(feeder, hopper);
+}
+
+/*******************************************************************************
+* addFeedingTimeEntry
+*
+* @brief Adds a feeding time with its weekdays and dates to the schedule
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] entry The feeding time to add
+*
+* @return 0 on success, -1 if the same feeding time is already in the schedule
+*******************************************************************************/
+int8_t addFeedingTimeEntry(feederS *feeder, uint8_t hopper, const feedingTimeS *entry) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  char logMessageBuffer[120];
+
+  if (scheduleInsert(&feeding->schedule.feedingTimes, entry) != 0) {
+    sprintf(logMessageBuffer, "Feeding time %hhu:%hhu not added, already in the schedule", entry->hour, entry->minute);
+    logMessage(feeder, WARNING, logMessageBuffer);
+    return -1;
+  }
+  invalidateSchedule(feeder, hopper);
+
+  sprintf(logMessageBuffer, "Added feeding time %hhu:%hhu", entry->hour, entry->minute);
+  logMessage(feeder, INFO, logMessageBuffer);
+
+  saveFeedingSchedule(feeder, hopper);
+
+  return 0;
 }
 
 /*******************************************************************************
 * addFeedingTime
 *
-* @brief Adds a feeding time to the schedule in the correct position.
+* @brief Adds a feeding time fed every day to the schedule
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] hour Hour of the feeding time
 * @param[in] minute Minute of the feeding time
 * @param[in] portions Amount of portions for that feeding time
+* @param[in] mode How the portions are dispensed
+*******************************************************************************/
+void addFeedingTime(feederS *feeder, uint8_t hopper, uint8_t hour, uint8_t minute, uint8_t portions, feedModeE mode) {
+  feedingTimeS entry = {
+    .hour = hour,
+    .minute = minute,
+    .portions = portions,
+    .mode = mode,
+    .weekdays = SCHEDULE_ALL_DAYS
+  };
+
+  addFeedingTimeEntry(feeder, hopper, &entry);
+}
+
+/*******************************************************************************
+* compileFeedingDays
+*
+* @brief Compiles today and tomorrow from the schedule unless they already are
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] today Local time of today
+* @param[in] tomorrow Local time of tomorrow
 *******************************************************************************/
-void addFeedingTime(uint8_t hour, uint8_t minute, uint8_t portions) {
-  uint8_t i;
-  uint8_t index = feedingSchedule.activeFeedingTimes;
-
-  // Find correct index based on hour and minute
-  for (i = 0; i < feedingSchedule.activeFeedingTimes; i++) {
-    if ((feedingSchedule.feedingTime[i].hour > hour) ||
-        (feedingSchedule.feedingTime[i].hour == hour &&
-         feedingSchedule.feedingTime[i].minute > minute)) {
-      index = i;
-      break;
+void compileFeedingDays(feederS *feeder, uint8_t hopper, const struct tm *today, const struct tm *tomorrow) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  const struct tm *days[2] = {today, tomorrow};
+
+  for (uint8_t i = 0; i < 2; i++) {
+    if (feeding->compiledDays[i].date != dateOf(days[i])) {
+      scheduleCompileDay(feeding->schedule.feedingTimes, dateOf(days[i]), days[i]->tm_wday, &feeding->compiledDays[i]);
     }
   }
+}
 
-  // Move schedule 1 index down from the index for new feeding time
-  if (feedingSchedule.activeFeedingTimes < 10) {
-    for (i = feedingSchedule.activeFeedingTimes; i > index; i--) {
-      feedingSchedule.feedingTime[i].hour = feedingSchedule.feedingTime[i - 1].hour;
-      feedingSchedule.feedingTime[i].minute = feedingSchedule.feedingTime[i - 1].minute;
-      feedingSchedule.feedingTime[i].portions = feedingSchedule.feedingTime[i - 1].portions;
+/*******************************************************************************
+* scheduleNextFeeding
+*
+* @brief Finds the first feeding due from the start of the current minute,
+*        today or tomorrow, and stores its absolute time, portions and mode. A
+*        feeding which already fired isn't due again. The lookup runs on the
+*        compiled days and doesn't depend on the size of the schedule
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] now The current time
+*******************************************************************************/
+void scheduleNextFeeding(feederS *feeder, uint8_t hopper, time_t now) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+
+  feeding->isNextFeedingValid = true;
+  feeding->scheduledWallTime = now;
+  getFeederMonotonicTime(feeder, &feeding->scheduledMonotonicTime);
+  feeding->nextFeedingTime = 0;
+
+  struct tm today, tomorrow;
+  getFeederLocalTime(feeder, now, &today);
+  tomorrow = today;
+  tomorrow.tm_mday++;
+  tomorrow.tm_hour = 12;
+  tomorrow.tm_isdst = -1;
+  mktime(&tomorrow);
+  compileFeedingDays(feeder, hopper, &today, &tomorrow);
+
+  struct tm *days[2] = {&today, &tomorrow};
+  uint16_t from = today.tm_hour * 60 + today.tm_min;
+
+  for (uint8_t i = 0; i < 2; i++) {
+    int16_t minute = scheduleNextMinute(&feeding->compiledDays[i], i == 0 ? from : 0);
+
+    while (minute >= 0) {
+      struct tm feedingTimeInfo = *days[i];
+      feedingTimeInfo.tm_hour = minute / 60;
+      feedingTimeInfo.tm_min = minute % 60;
+      feedingTimeInfo.tm_sec = 0;
+      feedingTimeInfo.tm_isdst = -1;
+      time_t feedingTime = mktime(&feedingTimeInfo);
+
+      if (feedingTime > feeding->lastFeedingTime) {
+        feeding->nextFeedingTime = feedingTime;
+        feeding->nextFeedingPortions = feeding->compiledDays[i].portions[minute];
+        feeding->nextFeedingMode = feeding->compiledDays[i].modes[minute];
+        return;
+      }
+
+      minute = scheduleNextMinute(&feeding->compiledDays[i], minute + 1);
     }
-
-    // Add new feeding time at index
-    feedingSchedule.feedingTime[index].hour = hour;
-    feedingSchedule.feedingTime[index].minute = minute;
-    feedingSchedule.feedingTime[index].portions = portions;
-    feedingSchedule.activeFeedingTimes++;
   }
+}
 
-  char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Added feeding time with index: %hhu", index);
-  logMessage(INFO, logMessageBuffer);
+/*******************************************************************************
+* getClockStep
+*
+* @brief Returns how far the wall clock was set since the next feeding was
+*        computed, e.g. by the time synchronization after boot
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] now The current time
+*
+* @return Difference between the wall clock and the monotonic clock [s]
+*******************************************************************************/
+int32_t getClockStep(feederS *feeder, uint8_t hopper, time_t now) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  struct timespec monotonicTime;
+  getFeederMonotonicTime(feeder, &monotonicTime);
+
+  return now - (feeding->scheduledWallTime + (monotonicTime.tv_sec - feeding->scheduledMonotonicTime.tv_sec));
+}
+
+/*******************************************************************************
+* getNextFeedingTime
+*
+* @brief Returns when the next feeding of a hopper is due, the deadline of the
+*        scheduler
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
+* @return The absolute time of the next feeding or 0 if the schedule is empty
+*******************************************************************************/
+time_t getNextFeedingTime(feederS *feeder, uint8_t hopper) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+
+  if (!feeding->isNextFeedingValid) scheduleNextFeeding(feeder, hopper, getFeederTime(feeder));
 
-  saveFeedingSchedule();
+  return feeding->nextFeedingTime;
 }
 
 /*******************************************************************************
@@ -199,49 +477,20 @@ void addFeedingTime(uint8_t hour, uint8_t minute, uint8_t portions) {
 *
 * @brief Returns the number of minutes until the next feeding
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
 * @return The number of minutes until the next feeding or UINT16_MAX if schedule
 *         is empty
 *******************************************************************************/
-uint16_t minutesToNextFeeding() {
-  if (feedingSchedule.activeFeedingTimes == 0) return UINT16_MAX;
-
-  uint8_t nextFeedingIndex;
-  time_t rawTime;
-  struct tm *timeInfo;
-
-  time(&rawTime);
-  timeInfo = localtime(&rawTime);
-
-  // Look for the next feeding time today
-  for (nextFeedingIndex = 0; nextFeedingIndex < feedingSchedule.activeFeedingTimes; nextFeedingIndex++) {
-    if (feedingSchedule.feedingTime[nextFeedingIndex].hour > timeInfo->tm_hour ||
-        (feedingSchedule.feedingTime[nextFeedingIndex].hour == timeInfo->tm_hour &&
-         feedingSchedule.feedingTime[nextFeedingIndex].minute > timeInfo->tm_min)) {
-      break;
-    }
-  }
+uint16_t minutesToNextFeeding(feederS *feeder, uint8_t hopper) {
+  time_t feedingTime = getNextFeedingTime(feeder, hopper);
+  if (feedingTime == 0) return UINT16_MAX;
 
-  int8_t hoursDiff, minutesDiff;
+  time_t now = getFeederTime(feeder);
+  if (feedingTime <= now) return 0;
 
-  // If no feeding time is found today, return the time until the first feeding time tomorrow
-  if (nextFeedingIndex == feedingSchedule.activeFeedingTimes) {
-    hoursDiff = 24 - timeInfo->tm_hour + feedingSchedule.feedingTime[0].hour;
-    minutesDiff = feedingSchedule.feedingTime[0].minute - timeInfo->tm_min;
-  } else {
-    hoursDiff = feedingSchedule.feedingTime[nextFeedingIndex].hour - timeInfo->tm_hour;
-    minutesDiff = feedingSchedule.feedingTime[nextFeedingIndex].minute - timeInfo->tm_min;
-  }
-
-  if (minutesDiff < 0) {
-    minutesDiff += 60;
-    hoursDiff--;
-  }
-
-  if (hoursDiff < 0) {
-    hoursDiff += 24;
-  }
-
-  return (hoursDiff * 60) + minutesDiff;
+  return feedingTime / 60 - now / 60;
 }
 
 /*******************************************************************************
@@ -249,98 +498,292 @@ uint16_t minutesToNextFeeding() {
 *
 * @brief Checks if the specified hour and minute is already in the schedule
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] hour The hour to check
 * @param[in] minute The minute to check
 *
 * @return True if the time is a duplicate, false otherwise
 *******************************************************************************/
-bool isFeedingTimeDuplicate(uint8_t hour, uint8_t minute) {
-  for (uint8_t i = 0; i < feedingSchedule.activeFeedingTimes; i++) {
-    if (feedingSchedule.feedingTime[i].hour == hour && feedingSchedule.feedingTime[i].minute == minute) {
-      return true;
+bool isFeedingTimeDuplicate(feederS *feeder, uint8_t hopper, uint8_t hour, uint8_t minute) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS entry = {.hour = hour, .minute = minute, .weekdays = SCHEDULE_ALL_DAYS};
+
+  return scheduleFind(feeding->schedule.feedingTimes, &entry) != NULL;
+}
+
+/*******************************************************************************
+* loadLastFeeding
+*
+* @brief Resumes the scheduler from the last feeding in the journal, the last
+*        one decided about before a restart. It isn't fed again and feedings
+*        due since then are caught up by the first handleFeeding call
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
+* @return 0 on success, -1 if the journal holds no feeding
+*******************************************************************************/
+int8_t loadLastFeeding(feederS *feeder, uint8_t hopper) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  char logMessageBuffer[120];
+  journalEntryS entry;
+
+  if (loadFeedingJournal(feeder, hopper, &entry) != 0) return -1;
+
+  feeding->lastFeedingTime = entry.scheduled;
+  feeding->lastFeedingCheck = entry.scheduled;
+  feeding->isNextFeedingValid = false;
+
+  struct tm timeInfo;
+  char timeBuffer[20];
+  getFeederLocalTime(feeder, entry.scheduled, &timeInfo);
+  strftime(timeBuffer, sizeof(timeBuffer), "%d.%m.%Y %H:%M", &timeInfo);
+  sprintf(logMessageBuffer, "Resuming feedings of hopper %hhu after the feeding due at %s", hopper + 1, timeBuffer);
+  logMessage(feeder, INFO, logMessageBuffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+* journalFeeding
+*
+* @brief Records the decision about a feeding in the journal before the food
+*        is dispensed, so a restart in the middle of a feed doesn't feed it
+*        again
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] scheduled Time the feeding was due
+* @param[in] portions Portions of the feeding time
+* @param[in] decision What is done with the feeding
+*******************************************************************************/
+void journalFeeding(feederS *feeder, uint8_t hopper, time_t scheduled, uint8_t portions, journalDecisionE decision) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  journalEntryS entry = {
+    .scheduled = scheduled,
+    .decided = getFeederTime(feeder),
+    .portions = portions,
+    .decision = decision
+  };
+
+  appendFeedingJournal(feeder, hopper, &entry);
+  if (scheduled > feeding->lastFeedingTime) feeding->lastFeedingTime = scheduled;
+}
+
+/*******************************************************************************
+* catchUpFeedings
+*
+* @brief Applies the FEEDING_CATCH_UP_POLICY to feedings which fell strictly
+*        between two checks of the schedule and therefore were never matched
+*        by handleFeeding, after a stall of the loop or a restart. Every day of
+*        the gap is compiled and its feedings within the gap are walked in
+*        order. Feedings later than FEEDING_CATCH_UP_WINDOW are always skipped
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] lastCheck Time of the previous schedule check
+* @param[in] currentCheck Time of the current schedule check
+*
+* @return The number of missed feedings
+*******************************************************************************/
+uint16_t catchUpFeedings(feederS *feeder, uint8_t hopper, time_t lastCheck, time_t currentCheck) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  scheduleDayS day;
+  char logMessageBuffer[120];
+  struct tm timeInfo, currentTimeInfo;
+  uint16_t missed = 0;
+  uint16_t skipped = 0;
+  time_t lastSkipped = 0;
+  uint8_t lastSkippedPortions = 0;
+  uint16_t mergedPortions = 0;
+  feedModeE mergedMode = FEEDING_DEFAULT_MODE;
+
+  getFeederLocalTime(feeder, lastCheck, &timeInfo);
+  getFeederLocalTime(feeder, currentCheck, &currentTimeInfo);
+
+  uint16_t from = timeInfo.tm_hour * 60 + timeInfo.tm_min + 1;
+  uint32_t currentDate = dateOf(&currentTimeInfo);
+
+  while (dateOf(&timeInfo) <= currentDate) {
+    bool isCurrentDay = dateOf(&timeInfo) == currentDate;
+    uint16_t to = isCurrentDay ? currentTimeInfo.tm_hour * 60 + currentTimeInfo.tm_min : SCHEDULE_DAY_MINUTES;
+
+    scheduleCompileDay(feeding->schedule.feedingTimes, dateOf(&timeInfo), timeInfo.tm_wday, &day);
+
+    for (int16_t minute = scheduleNextMinute(&day, from); minute >= 0 && minute < to; minute = scheduleNextMinute(&day, minute + 1)) {
+      struct tm feedingTimeInfo = timeInfo;
+      feedingTimeInfo.tm_hour = minute / 60;
+      feedingTimeInfo.tm_min = minute % 60;
+      feedingTimeInfo.tm_sec = 0;
+      feedingTimeInfo.tm_isdst = -1;
+      time_t feedingTime = mktime(&feedingTimeInfo);
+
+      // Decided before a restart
+      if (feedingTime <= feeding->lastFeedingTime) continue;
+
+      uint8_t portions = day.portions[minute];
+      time_t lateness = currentCheck - feedingTime;
+      missed++;
+
+      if (FEEDING_CATCH_UP_POLICY == FEEDING_CATCH_UP_SKIP || lateness > FEEDING_CATCH_UP_WINDOW * 60) {
+        skipped++;
+        lastSkipped = feedingTime;
+        lastSkippedPortions = portions;
+        metricsHopperIncrement(feeder, hopper, METRIC_FEEDS_MISSED);
+      }
+      else if (FEEDING_CATCH_UP_POLICY == FEEDING_CATCH_UP_LATE) {
+        metricsHopperIncrement(feeder, hopper, METRIC_FEEDS_LATE);
+        metricsObserve(feeder, METRIC_FEED_LATENESS, lateness);
+
+        sprintf(logMessageBuffer, "Feeding due at %02d:%02d missed, feeding %hhu portions %ld minutes late",
+          minute / 60, minute % 60, portions, (long)(lateness / 60));
+        logMessage(feeder, WARNING, logMessageBuffer);
+
+        journalFeeding(feeder, hopper, feedingTime, portions, JOURNAL_LATE);
+        queueDispense(feeder, hopper, DISPENSE_SOURCE_CATCH_UP, portions, day.modes[minute]);
+      }
+      else {
+        metricsHopperIncrement(feeder, hopper, METRIC_FEEDS_MERGED);
+        metricsObserve(feeder, METRIC_FEED_LATENESS, lateness);
+
+        journalFeeding(feeder, hopper, feedingTime, portions, JOURNAL_MERGED);
+        mergedPortions += portions;
+        mergedMode = day.modes[minute];
+      }
     }
+    if (isCurrentDay) break;
+
+    from = 0;
+    timeInfo.tm_mday++;
+    timeInfo.tm_hour = 12;
+    timeInfo.tm_isdst = -1;
+    mktime(&timeInfo);
+  }
+
+  if (skipped > 0) {
+    sprintf(logMessageBuffer, "Skipped %hu missed feedings, the last one due %ld minutes ago",
+      skipped, (long)((currentCheck - lastSkipped) / 60));
+    logMessage(feeder, WARNING, logMessageBuffer);
+
+    // Only the latest skipped feeding is journaled, it is where a restart resumes
+    if (lastSkipped > feeding->lastFeedingTime) journalFeeding(feeder, hopper, lastSkipped, lastSkippedPortions, JOURNAL_SKIPPED);
+  }
+
+  if (mergedPortions > 0) {
+    uint8_t portions = mergedPortions > FEEDING_CATCH_UP_MAX_PORTIONS ? FEEDING_CATCH_UP_MAX_PORTIONS : mergedPortions;
+
+    sprintf(logMessageBuffer, "Feeding %hhu portions merged from %hu missed portions", portions, mergedPortions);
+    logMessage(feeder, WARNING, logMessageBuffer);
+
+    queueDispense(feeder, hopper, DISPENSE_SOURCE_CATCH_UP, portions, mergedMode);
   }
 
-  return false;
+  return missed;
 }
 
 /*******************************************************************************
-* handleFeeding
+* handleHopperFeeding
 *
-* @brief Handles the feeding process
+* @brief Handles the feeding process of a hopper. Only compares the current
+*        time with the time the next feeding is due, which is recomputed after
+*        a feeding and when the schedule or the clock changes. Feedings passed
+*        during a stall of the loop or a restart are caught up
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 ******************************************************************************/
-void handleFeeding() {
-  uint8_t feedIndex;
-  time_t rawTime;
-  struct tm *timeInfo;
-
-  time(&rawTime);
-  timeInfo = localtime(&rawTime);
-
-  for (feedIndex = 0; feedIndex < feedingSchedule.activeFeedingTimes; feedIndex++) {
-    if (feedingSchedule.feedingTime[feedIndex].hour == timeInfo->tm_hour &&
-        feedingSchedule.feedingTime[feedIndex].minute == timeInfo->tm_min &&
-        !feedingSchedule.feedingTime[feedIndex].isDone) {
-      feed(feedingSchedule.feedingTime[feedIndex].portions);
-      feedingSchedule.feedingTime[feedIndex].isDone = true;
-      break;
-    }
+void handleHopperFeeding(feederS *feeder, uint8_t hopper) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  char logMessageBuffer[120];
+  time_t rawTime = getFeederTime(feeder);
+
+  int32_t clockStep = feeding->isNextFeedingValid ? getClockStep(feeder, hopper, rawTime) : 0;
+  if (abs(clockStep) > FEEDING_CLOCK_STEP) {
+    sprintf(logMessageBuffer, "Clock changed by %d seconds, rescheduling feedings of hopper %hhu", clockStep, hopper + 1);
+    logMessage(feeder, WARNING, logMessageBuffer);
+
+    // Feedings the clock stepped over are caught up from the last feeding,
+    // e.g. when the time is synchronized after a boot without a real time
+    // clock. The last feeding stays, so a step back doesn't feed the same
+    // time again
+    feeding->lastFeedingCheck = feeding->lastFeedingTime;
+    feeding->isNextFeedingValid = false;
   }
 
-  for (feedIndex = 0; feedIndex < feedingSchedule.activeFeedingTimes; feedIndex++) {
-    if (feedingSchedule.feedingTime[feedIndex].isDone &&
-        feedingSchedule.feedingTime[feedIndex].hour == timeInfo->tm_hour &&
-        feedingSchedule.feedingTime[feedIndex].minute == timeInfo->tm_min + 1) {
-      feedingSchedule.feedingTime[feedIndex].isDone = false;
-      break;
+  // Feeding times which passed while the loop was stalled can't be matched anymore
+  if (feeding->lastFeedingCheck != 0 && rawTime - feeding->lastFeedingCheck > 60) {
+    uint16_t missed = catchUpFeedings(feeder, hopper, feeding->lastFeedingCheck, rawTime);
+    if (missed > 0) {
+      sprintf(logMessageBuffer, "Missed %hu feedings of hopper %hhu in %ld seconds without a schedule check", missed, hopper + 1, (long)(rawTime - feeding->lastFeedingCheck));
+      logMessage(feeder, WARNING, logMessageBuffer);
     }
+    feeding->isNextFeedingValid = false;
   }
+  feeding->lastFeedingCheck = rawTime;
+
+  if (!feeding->isNextFeedingValid) scheduleNextFeeding(feeder, hopper, rawTime);
+
+  if (feeding->nextFeedingTime == 0 || rawTime < feeding->nextFeedingTime) return;
+
+  // A feeding dropped by a full dispense queue is skipped like a missed one
+  if (queueScheduledDispense(feeder, hopper, feeding->nextFeedingPortions, feeding->nextFeedingMode, feeding->nextFeedingTime) != 0) {
+    journalFeeding(feeder, hopper, feeding->nextFeedingTime, feeding->nextFeedingPortions, JOURNAL_SKIPPED);
+    metricsHopperIncrement(feeder, hopper, METRIC_FEEDS_MISSED);
+  } else {
+    journalFeeding(feeder, hopper, feeding->nextFeedingTime, feeding->nextFeedingPortions, JOURNAL_FED);
+    metricsHopperIncrement(feeder, hopper, METRIC_FEEDS_DONE);
+  }
+
+  scheduleNextFeeding(feeder, hopper, getFeederTime(feeder));
 }
 
 /*******************************************************************************
-* feed
+* handleFeeding
 *
-* @brief Feeds the specified amount of portions
+* @brief Handles the feeding process of every hopper
 *
-* @param[in] portions The amount of portions to feed
-*******************************************************************************/
-void feed(uint8_t portions) {
-  for (uint8_t i = 0; i < portions; i++) {
-    rotateMotor(360 / feedingSchedule.feedingWheelArms);
-    delay(1000);
+* @param[in] feeder The feeder
+******************************************************************************/
+void handleFeeding(feederS *feeder) {
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    handleHopperFeeding(feeder, i);
   }
-
-  char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Feed %hhu portions", portions);
-  logMessage(INFO, logMessageBuffer);
 }
 
 /*******************************************************************************
 * getFeedingWheelArms
 *
-* @brief Returns the amount of arms on the feeding wheel
+* @brief Returns the amount of arms on the feeding wheel of a hopper
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 *
 * @return Amount of arms on the feeding wheel
 *******************************************************************************/
-uint8_t getFeedingWheelArms() {
-  return feedingSchedule.feedingWheelArms;
+uint8_t getFeedingWheelArms(feederS *feeder, uint8_t hopper) {
+  return feeder->feedingHoppers[hopper].schedule.feedingWheelArms;
 }
 
 /*******************************************************************************
 * setFeedingWheelArms
 *
-* @brief Sets the amount of arms on the feeding wheel
+* @brief Sets the amount of arms on the feeding wheel of a hopper
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] feedingWheelArms New amount of arms on the feeding wheel
 *******************************************************************************/
-void setFeedingWheelArms(uint8_t feedingWheelArms) {
-  feedingSchedule.feedingWheelArms = feedingWheelArms;
+void setFeedingWheelArms(feederS *feeder, uint8_t hopper, uint8_t feedingWheelArms) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+
+  feeding->schedule.feedingWheelArms = feedingWheelArms;
 
   char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Set feeding wheel arms to %hhu", feedingSchedule.feedingWheelArms);
-  logMessage(INFO, logMessageBuffer);
+  sprintf(logMessageBuffer, "Set feeding wheel %hhu arms to %hhu", hopper + 1, feeding->schedule.feedingWheelArms);
+  logMessage(feeder, INFO, logMessageBuffer);
 
-  saveFeedingSchedule();
+  saveFeedingSchedule(feeder, hopper);
 }
 
 /*******************************************************************************
@@ -348,12 +791,16 @@ void setFeedingWheelArms(uint8_t feedingWheelArms) {
 *
 * @brief Gets the hour of the feeding time at the specified index
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] index The index of the feeding time
 *
 * @return The hour of the feeding time
 *******************************************************************************/
-uint8_t getFeedingTimeHour(uint8_t index) {
-  return feedingSchedule.feedingTime[index].hour;
+uint8_t getFeedingTimeHour(feederS *feeder, uint8_t hopper, uint16_t index) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *entry = scheduleSelect(feeding->schedule.feedingTimes, index);
+  return entry != NULL ? entry->hour : 0;
 }
 
 /*******************************************************************************
@@ -361,12 +808,16 @@ uint8_t getFeedingTimeHour(uint8_t index) {
 *
 * @brief Gets the minute of the feeding time at the specified index
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] index The index of the feeding time
 *
 * @return The minute of the feeding time
 *******************************************************************************/
-uint8_t getFeedingTimeMinute(uint8_t index) {
-  return feedingSchedule.feedingTime[index].minute;
+uint8_t getFeedingTimeMinute(feederS *feeder, uint8_t hopper, uint16_t index) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *entry = scheduleSelect(feeding->schedule.feedingTimes, index);
+  return entry != NULL ? entry->minute : 0;
 }
 
 /*******************************************************************************
@@ -374,12 +825,34 @@ uint8_t getFeedingTimeMinute(uint8_t index) {
 *
 * @brief Gets the amount of portions for the feeding time at the specified index
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] index The index of the feeding time
 *
 * @return The amount of portions for the feeding time
 *******************************************************************************/
-uint8_t getFeedingTimePortions(uint8_t index) {
-  return feedingSchedule.feedingTime[index].portions;
+uint8_t getFeedingTimePortions(feederS *feeder, uint8_t hopper, uint16_t index) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *entry = scheduleSelect(feeding->schedule.feedingTimes, index);
+  return entry != NULL ? entry->portions : 0;
+}
+
+/*******************************************************************************
+* getFeedingTimeMode
+*
+* @brief Gets how the portions of the feeding time at the specified index are
+*        dispensed
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] index The index of the feeding time
+*
+* @return The feed mode of the feeding time
+*******************************************************************************/
+feedModeE getFeedingTimeMode(feederS *feeder, uint8_t hopper, uint16_t index) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *entry = scheduleSelect(feeding->schedule.feedingTimes, index);
+  return entry != NULL ? entry->mode : FEEDING_DEFAULT_MODE;
 }
 
 /*******************************************************************************
@@ -387,17 +860,24 @@ uint8_t getFeedingTimePortions(uint8_t index) {
 *
 * @brief Sets the amount of portions for the feeding time at the specified index
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
 * @param[in] index The index of the feeding time
 * @param[in] portions The amount of portions to set
 *******************************************************************************/
-void setFeedingTimePortions(uint8_t index, uint8_t portions) {
-  feedingSchedule.feedingTime[index].portions = portions;
+void setFeedingTimePortions(feederS *feeder, uint8_t hopper, uint16_t index, uint8_t portions) {
+  feedingHopperS *feeding = &feeder->feedingHoppers[hopper];
+  feedingTimeS *entry = scheduleSelect(feeding->schedule.feedingTimes, index);
+  if (entry == NULL) return;
+
+  entry->portions = portions;
+  invalidateSchedule(feeder, hopper);
 
   char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Set portions for feeding time index %hhu to %hhu", index, feedingSchedule.feedingTime[index].portions);
-  logMessage(INFO, logMessageBuffer);
+  sprintf(logMessageBuffer, "Set portions for feeding time index %hu to %hhu", index, entry->portions);
+  logMessage(feeder, INFO, logMessageBuffer);
 
-  saveFeedingSchedule();
+  saveFeedingSchedule(feeder, hopper);
 }
 
 /*******************************************************************************
@@ -405,8 +885,11 @@ void setFeedingTimePortions(uint8_t index, uint8_t portions) {
 *
 * @brief Gets the amount of active feeding times
 *
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
 * @return The amount of active feeding times
 *******************************************************************************/
-uint8_t getActiveFeedingTimes() {
-  return feedingSchedule.activeFeedingTimes;
+uint16_t getActiveFeedingTimes(feederS *feeder, uint8_t hopper) {
+  return scheduleSize(feeder->feedingHoppers[hopper].schedule.feedingTimes);
 }
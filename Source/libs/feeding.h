@@ -5,35 +5,62 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include <time.h>
+#include "schedule.h"
 
-typedef struct feedingTimeS {
-  uint8_t hour; // Hour of the feeding time
-  uint8_t minute; // Minute of the feeding time
-  uint8_t portions; // Number of portions to feed in the feed
-  bool isDone;
-} feedingTimeS;
+typedef struct feederS feederS; // Defined in context.h
+
+typedef enum {
+  FEEDING_CATCH_UP_SKIP, // Missed feedings aren't fed
+  FEEDING_CATCH_UP_LATE, // Every missed feeding within the window is fed late
+  FEEDING_CATCH_UP_MERGE // Missed feedings within the window are fed as a single feed
+} feedingCatchUpPolicyE;
 
 typedef struct feedingScheduleS {
-  uint8_t activeFeedingTimes; // Number of active feeding times
-  feedingTimeS feedingTime[10]; // Max 10 feeding times per day
+  scheduleNodeS *feedingTimes; // Feeding times ordered by time of the day
   uint8_t feedingWheelArms; // Arms of the feeding wheel
 } feedingScheduleS;
 
-int8_t saveFeedingSchedule();
-int8_t loadFeedingSchedule();
-void saveModifiedFeedingTime(uint8_t index, uint8_t hour, uint8_t minute);
-void removeFeedingTime(uint8_t index);
-void addFeedingTime(uint8_t hour, uint8_t minute, uint8_t portions);
-uint16_t minutesToNextFeeding();
-bool isFeedingTimeDuplicate(uint8_t hour, uint8_t minute);
-void handleFeeding();
-void feed(uint8_t portions);
-uint8_t getFeedingWheelArms();
-void setFeedingWheelArms(uint8_t feedingWheelArms);
-uint8_t getFeedingTimeHour(uint8_t index);
-uint8_t getFeedingTimeMinute(uint8_t index);
-uint8_t getFeedingTimePortions(uint8_t index);
-void setFeedingTimePortions(uint8_t index, uint8_t portions);
-uint8_t getActiveFeedingTimes();
+// Scheduler state of a hopper, every hopper has its own schedule
+typedef struct feedingHopperS {
+  feedingScheduleS schedule;
+  time_t lastFeedingCheck;
+
+  // Today and tomorrow compiled from the schedule, recompiled when the day or
+  // the schedule changes
+  scheduleDayS compiledDays[2];
+
+  // Next due feeding, recomputed only when the schedule or the clock changes
+  bool isNextFeedingValid;
+  time_t nextFeedingTime; // Absolute time the next feeding is due, 0 if none is due
+  uint8_t nextFeedingPortions;
+  feedModeE nextFeedingMode;
+  time_t lastFeedingTime; // Time of the last feeding, never due twice
+  time_t scheduledWallTime; // Wall clock when the next feeding was computed
+  struct timespec scheduledMonotonicTime; // Monotonic clock at the same moment
+} feedingHopperS;
+
+int8_t saveFeedingSchedule(feederS *feeder, uint8_t hopper);
+int8_t loadFeedingSchedule(feederS *feeder, uint8_t hopper);
+void saveModifiedFeedingTime(feederS *feeder, uint8_t hopper, uint16_t index, uint8_t hour, uint8_t minute);
+void removeFeedingTime(feederS *feeder, uint8_t hopper, uint16_t index);
+int8_t addFeedingTimeEntry(feederS *feeder, uint8_t hopper, const feedingTimeS *entry);
+void addFeedingTime(feederS *feeder, uint8_t hopper, uint8_t hour, uint8_t minute, uint8_t portions, feedModeE mode);
+void scheduleNextFeeding(feederS *feeder, uint8_t hopper, time_t now);
+int32_t getClockStep(feederS *feeder, uint8_t hopper, time_t now);
+time_t getNextFeedingTime(feederS *feeder, uint8_t hopper);
+uint16_t minutesToNextFeeding(feederS *feeder, uint8_t hopper);
+bool isFeedingTimeDuplicate(feederS *feeder, uint8_t hopper, uint8_t hour, uint8_t minute);
+int8_t loadLastFeeding(feederS *feeder, uint8_t hopper);
+uint16_t catchUpFeedings(feederS *feeder, uint8_t hopper, time_t lastCheck, time_t currentCheck);
+void handleHopperFeeding(feederS *feeder, uint8_t hopper);
+void handleFeeding(feederS *feeder);
+uint8_t getFeedingWheelArms(feederS *feeder, uint8_t hopper);
+void setFeedingWheelArms(feederS *feeder, uint8_t hopper, uint8_t feedingWheelArms);
+uint8_t getFeedingTimeHour(feederS *feeder, uint8_t hopper, uint16_t index);
+uint8_t getFeedingTimeMinute(feederS *feeder, uint8_t hopper, uint16_t index);
+uint8_t getFeedingTimePortions(feederS *feeder, uint8_t hopper, uint16_t index);
+void setFeedingTimePortions(feederS *feeder, uint8_t hopper, uint16_t index, uint8_t portions);
+feedModeE getFeedingTimeMode(feederS *feeder, uint8_t hopper, uint16_t index);
+uint16_t getActiveFeedingTimes(feederS *feeder, uint8_t hopper);
 
 #endif // feeding_h
@@ -0,0 +1,136 @@
+#include "friction.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <time.h>
+#include <wiringPi.h>
+#include "../config.h"
+#include "logger.h"
+#include "motor.h"
+#include "watchdog.h"
+
+/*******************************************************************************
+* measureFriction
+*
+* @brief Measures the friction of one direction with a duty ramp. The duty rises
+*        by FRICTION_RAMP_RATE until the motor moved FRICTION_BREAK_AWAY_TICKS,
+*        which is the break-away duty. It then falls at the same rate until no
+*        edge arrived for FRICTION_STOP_TIME, which is the Coulomb duty
+*
+* @param[in] motor The motor
+* @param[in] direction Direction of the output
+* @param[out] friction Measured duties, fractions of the PWM range
+*
+* @return 0 on success, 1 if the motor didn't move at full duty
+*******************************************************************************/
+uint8_t measureFriction(motorS *motor, motorDirectionE direction, motorFrictionS *friction) {
+  uint16_t rate = getMotorControlRate(motor);
+  uint32_t periodNs = 1000000000 / rate;
+  float dutyStep = FRICTION_RAMP_RATE / rate;
+  int8_t sign = direction == MOTOR_REVERSE ? -1 : 1;
+
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+
+  int64_t startPosition = getEncoderPosition(motor);
+  float duty = 0;
+  bool isMoving = false;
+
+  // Ramp up to the break-away
+  while (!isMoving) {
+    if (watchdogIsMoveAborted(motor->feeder, motor->hopper) || duty >= 1) {
+      driveMotor(motor, 0);
+      return 1;
+    }
+
+    duty += dutyStep;
+    driveMotor(motor, sign * duty * MOTOR_PWM_RANGE);
+    waitForNextPeriod(motor, &deadline, periodNs);
+
+    isMoving = llabs(getEncoderPosition(motor) - startPosition) >= FRICTION_BREAK_AWAY_TICKS;
+  }
+  friction->breakAway = duty;
+
+  // Ramp down until the motor stops
+  int64_t lastPosition = getEncoderPosition(motor);
+  uint32_t lastEdgeTime = millis();
+  while (millis() - lastEdgeTime < FRICTION_STOP_TIME && duty > 0) {
+    if (watchdogIsMoveAborted(motor->feeder, motor->hopper)) {
+      driveMotor(motor, 0);
+      return 1;
+    }
+
+    if (getEncoderPosition(motor) != lastPosition) {
+      lastPosition = getEncoderPosition(motor);
+      lastEdgeTime = millis();
+    }
+
+    duty -= dutyStep;
+    driveMotor(motor, sign * duty * MOTOR_PWM_RANGE);
+    waitForNextPeriod(motor, &deadline, periodNs);
+  }
+
+  driveMotor(motor, 0);
+
+  // The motor stopped FRICTION_STOP_TIME ago
+  friction->coulomb = duty + dutyStep * FRICTION_STOP_TIME * rate / 1000;
+  if (friction->coulomb > friction->breakAway) friction->coulomb = friction->breakAway;
+
+  return 0;
+}
+
+/*******************************************************************************
+* calibrateFriction
+*
+* @brief Measures the friction of both directions FRICTION_CALIBRATION_RUNS
+*        times, alternating so the wheel stays close to its position, and saves
+*        the duties. The break-away duty depends on the position of the wheel,
+*        so the highest one is kept with FRICTION_BREAK_AWAY_MARGIN on top. The
+*        Coulomb duties are averaged
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t calibrateFriction(motorS *motor) {
+  char logMessageBuffer[120];
+  motorFrictionS results[MOTOR_DIRECTIONS_COUNT] = {0};
+  uint8_t status = 0;
+
+  sprintf(logMessageBuffer, "Calibrating motor %hhu friction", motor->hopper + 1);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  watchdogBeginMove(motor->feeder, motor->hopper);
+  watchdogSetPhase(motor->feeder, motor->hopper, WATCHDOG_PHASE_MOVING);
+
+  for (uint8_t run = 0; run < FRICTION_CALIBRATION_RUNS && status == 0; run++) {
+    for (uint8_t direction = 0; direction < MOTOR_DIRECTIONS_COUNT && status == 0; direction++) {
+      motorFrictionS friction;
+      status = measureFriction(motor, direction, &friction);
+      if (status != 0) break;
+
+      sprintf(logMessageBuffer, "Friction run %hhu %s: break-away %.3f coulomb %.3f",
+        run + 1, direction == MOTOR_FORWARD ? "forward" : "reverse", friction.breakAway, friction.coulomb);
+      logMessage(motor->feeder, INFO, logMessageBuffer);
+
+      if (friction.breakAway > results[direction].breakAway) results[direction].breakAway = friction.breakAway;
+      results[direction].coulomb += friction.coulomb / FRICTION_CALIBRATION_RUNS;
+
+      delay(FRICTION_STOP_TIME);
+    }
+  }
+
+  watchdogEndMove(motor->feeder, motor->hopper);
+
+  if (status != 0) {
+    logMessage(motor->feeder, ERROR, "Friction calibration failed, the motor didn't move");
+    return 1;
+  }
+
+  for (uint8_t direction = 0; direction < MOTOR_DIRECTIONS_COUNT; direction++) {
+    float breakAway = results[direction].breakAway * FRICTION_BREAK_AWAY_MARGIN;
+    setMotorFriction(motor, direction, breakAway < 1 ? breakAway : 1, results[direction].coulomb);
+  }
+
+  return 0;
+}
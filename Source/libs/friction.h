@@ -0,0 +1,10 @@
+#ifndef friction_h
+#define friction_h
+
+#include <stdint.h>
+#include "motor.h"
+
+uint8_t measureFriction(motorS *motor, motorDirectionE direction, motorFrictionS *friction);
+uint8_t calibrateFriction(motorS *motor);
+
+#endif // friction_h
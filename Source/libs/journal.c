@@ -0,0 +1,184 @@
+#include "journal.h"
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include "tools.h"
+#include "logger.h"
+#include "../config.h"
+#include "context.h"
+
+#define JOURNAL_LINE_LENGTH 64
+
+const char* journalDecisionStrings[] = {
+  "fed",
+  "late",
+  "merged",
+  "skipped"
+};
+
+/*******************************************************************************
+* parseJournalEntry
+*
+* @brief Parses a line of the journal file, e.g. "1719815400 1719815403 2 fed",
+*        the scheduled time, the decision time, the portions and the decision
+*
+* @param[in] line The line
+* @param[out] entry The parsed journal entry
+*
+* @return 0 on success, -1 if the line isn't a journal entry
+*******************************************************************************/
+int8_t parseJournalEntry(const char *line, journalEntryS *entry) {
+  long long scheduled, decided;
+  char decision[16];
+
+  if (sscanf(line, "%lld %lld %hhu %15s", &scheduled, &decided, &entry->portions, decision) != 4) {
+    return -1;
+  }
+
+  // A decision is never made before the feeding is due, a line glued to a
+  // torn one fails this check
+  if (decided < scheduled) return -1;
+
+  for (uint8_t i = 0; i < JOURNAL_DECISIONS_COUNT; i++) {
+    if (strcmp(decision, journalDecisionStrings[i]) == 0) {
+      entry->scheduled = scheduled;
+      entry->decided = decided;
+      entry->decision = i;
+      return 0;
+    }
+  }
+
+  return -1;
+}
+
+/*******************************************************************************
+* loadFeedingJournal
+*
+* @brief Reads the journal file and returns its entry with the latest scheduled
+*        time, the last feeding the scheduler decided about before a restart.
+*        A line torn by a power loss is ignored. Every hopper has its own
+*        journal file
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[out] lastEntry The entry with the latest scheduled time
+*
+* @return 0 on success, -1 if the journal is missing or empty
+*******************************************************************************/
+int8_t loadFeedingJournal(feederS *feeder, uint8_t hopper, journalEntryS *lastEntry) {
+  char line[JOURNAL_LINE_LENGTH];
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+  journalEntryS entry;
+  int8_t result = -1;
+
+  feeder->journalLines[hopper] = 0;
+
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, FEEDING_JOURNAL_FILE, hopper);
+  FILE *fp = fopen(fileName, "r");
+  if (fp == NULL) return -1;
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    feeder->journalLines[hopper]++;
+
+    if (parseJournalEntry(line, &entry) != 0) continue;
+
+    if (result != 0 || entry.scheduled >= lastEntry->scheduled) {
+      *lastEntry = entry;
+      result = 0;
+    }
+  }
+
+  fclose(fp);
+
+  return result;
+}
+
+/*******************************************************************************
+* compactFeedingJournal
+*
+* @brief Rewrites the journal file with only its last FEEDING_JOURNAL_ENTRIES
+*        lines. The file is replaced at once, so a power loss while compacting
+*        keeps the previous journal
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t compactFeedingJournal(feederS *feeder, uint8_t hopper) {
+  char lines[FEEDING_JOURNAL_ENTRIES][JOURNAL_LINE_LENGTH];
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+  char tmpFileName[FEEDER_FILE_NAME_LENGTH + 4];
+  uint32_t count = 0;
+
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, FEEDING_JOURNAL_FILE, hopper);
+  sprintf(tmpFileName, "%s.tmp", fileName);
+
+  FILE *fp = fopen(fileName, "r");
+  if (fp == NULL) return -1;
+
+  while (fgets(lines[count % FEEDING_JOURNAL_ENTRIES], JOURNAL_LINE_LENGTH, fp) != NULL) {
+    count++;
+  }
+  fclose(fp);
+
+  fp = fopen(tmpFileName, "w");
+  if (fp == NULL) return -1;
+
+  uint32_t first = count > FEEDING_JOURNAL_ENTRIES ? count - FEEDING_JOURNAL_ENTRIES : 0;
+  for (uint32_t i = first; i < count; i++) {
+    fputs(lines[i % FEEDING_JOURNAL_ENTRIES], fp);
+  }
+
+  fflush(fp);
+  fsync(fileno(fp));
+  fclose(fp);
+
+  if (rename(tmpFileName, fileName) != 0) return -1;
+
+  feeder->journalLines[hopper] = count - first;
+
+  return 0;
+}
+
+/*******************************************************************************
+* appendFeedingJournal
+*
+* @brief Appends an entry to the journal file and waits until it is on the
+*        storage, so the decision survives a restart right after it. The file
+*        is compacted once it holds twice FEEDING_JOURNAL_ENTRIES lines
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] entry The journal entry
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t appendFeedingJournal(feederS *feeder, uint8_t hopper, const journalEntryS *entry) {
+  char logMessageBuffer[120];
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, FEEDING_JOURNAL_FILE, hopper);
+  FILE *fp = fopen(fileName, "a");
+  if (fp == NULL) {
+    sprintf(logMessageBuffer, "Error during feeding journal %hhu writing: %s", hopper + 1, strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
+    return -1;
+  }
+
+  fprintf(fp, "%lld %lld %hhu %s\n", (long long)entry->scheduled, (long long)entry->decided,
+    entry->portions, journalDecisionStrings[entry->decision]);
+
+  fflush(fp);
+  fsync(fileno(fp));
+  fclose(fp);
+
+  feeder->journalLines[hopper]++;
+  if (feeder->journalLines[hopper] >= 2 * FEEDING_JOURNAL_ENTRIES && compactFeedingJournal(feeder, hopper) != 0) {
+    sprintf(logMessageBuffer, "Error during feeding journal %hhu compaction: %s", hopper + 1, strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
+  }
+
+  return 0;
+}
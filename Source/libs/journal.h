@@ -0,0 +1,27 @@
+#ifndef journal_h
+#define journal_h
+
+#include <stdint.h>
+#include <time.h>
+
+typedef struct feederS feederS; // Defined in context.h
+
+typedef enum {
+  JOURNAL_FED, // Fed on time
+  JOURNAL_LATE, // Missed and fed late within the catch-up window
+  JOURNAL_MERGED, // Missed and its portions merged into a single catch-up feed
+  JOURNAL_SKIPPED, // Missed and not fed
+  JOURNAL_DECISIONS_COUNT
+} journalDecisionE;
+
+typedef struct journalEntryS {
+  time_t scheduled; // Time the feeding was due
+  time_t decided; // Time the decision was made
+  uint8_t portions; // Portions of the feeding time
+  journalDecisionE decision; // What was done with the feeding
+} journalEntryS;
+
+int8_t loadFeedingJournal(feederS *feeder, uint8_t hopper, journalEntryS *lastEntry);
+int8_t appendFeedingJournal(feederS *feeder, uint8_t hopper, const journalEntryS *entry);
+
+#endif // journal_h
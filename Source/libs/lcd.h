@@ -4,6 +4,8 @@
 #include <stdint.h>
 #include <wiringPi.h>
 
+typedef struct feederS feederS; // Defined in context.h
+
 // Commands
 #define LCD_CLEARDISPLAY 0x01
 #define LCD_RETURNHOME 0x02
@@ -66,22 +68,22 @@ typedef struct lcd_paramsS {
 } lcd_paramsS;
 
 
-void lcd_init_i2c(uint8_t address, uint8_t cols, uint8_t rows, uint8_t charsize);
+void lcd_init_i2c(feederS *feeder, uint8_t address, uint8_t cols, uint8_t rows, uint8_t charsize);
 
-void lcd_begin_i2c(uint8_t cols, uint8_t rows);
-void lcd_setRowOffsets(uint8_t row1, uint8_t row2, uint8_t row3, uint8_t row4);
+void lcd_begin_i2c(feederS *feeder, uint8_t cols, uint8_t rows);
+void lcd_setRowOffsets(feederS *feeder, uint8_t row1, uint8_t row2, uint8_t row3, uint8_t row4);
 
-void lcd_command_i2c(uint8_t value);
-void lcd_send_i2c(uint8_t value, uint8_t mode);
-void lcd_pulse_i2c(uint8_t value);
+void lcd_command_i2c(feederS *feeder, uint8_t value);
+void lcd_send_i2c(feederS *feeder, uint8_t value, uint8_t mode);
+void lcd_pulse_i2c(feederS *feeder, uint8_t value);
 
-void lcd_writeChar_i2c(char c);
-void lcd_writeString_i2c(char *s);
-void lcd_removeChar_i2c(uint8_t col, uint8_t row);
-void lcd_clear_i2c();
-void lcd_cursorOff_i2c();
-void lcd_blinkOn_i2c();
-void lcd_blinkOff_i2c();
-void lcd_setCursor_i2c(uint8_t col, uint8_t row);
+void lcd_writeChar_i2c(feederS *feeder, char c);
+void lcd_writeString_i2c(feederS *feeder, char *s);
+void lcd_removeChar_i2c(feederS *feeder, uint8_t col, uint8_t row);
+void lcd_clear_i2c(feederS *feeder);
+void lcd_cursorOff_i2c(feederS *feeder);
+void lcd_blinkOn_i2c(feederS *feeder);
+void lcd_blinkOff_i2c(feederS *feeder);
+void lcd_setCursor_i2c(feederS *feeder, uint8_t col, uint8_t row);
 
 #endif // lcd_h
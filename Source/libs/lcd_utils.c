@@ -1,45 +1,63 @@
 #include "lcd_utils.h"
 #include "lcd.h"
 #include "feeding.h"
+#include "../config.h"
 #include <stdint.h>
 #include <time.h>
 
 #include <stdio.h>
-
-lcdStateMachineS lcdState = {0};
+#include "clock.h"
+#include "context.h"
 
 /*******************************************************************************
 * handleLCD
 *
 * @brief Handles the main LCD state machine
+*
+* @param[in] feeder The feeder
 *******************************************************************************/
-void handleLCD() {
-  switch (lcdState.state) {
+void handleLCD(feederS *feeder) {
+  lcdStateMachineS *lcdState = &feeder->lcdState;
+  switch (lcdState->state) {
     case LCD_WELCOME:
-      lcdWelcomeScreen();
-      lcdState.state = LCD_IDLE;
+      lcdWelcomeScreen(feeder);
+      lcdState->state = LCD_IDLE;
       break;
     case LCD_IDLE: {
-      if (lcdState.lastPressedButton != NONE) {
-        lcdState.lastPressedButton = NONE;
-        lcdState.state = LCD_SETTINGS;
-        lcdState.settingsState = LCD_SETTINGS_START;
-        lcdState.isUpdateNeeded = true;
+      bool isDispensing = false;
+      for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+        if (getDispenseProgress(feeder, i).isDispensing) isDispensing = true;
+      }
+
+      if (isDispensing) {
+        lcdState->state = LCD_DISPENSING;
+        lcdState->isUpdateNeeded = true;
         break;
       }
 
-      uint32_t currentTime = millis();
-      if (currentTime - lcdState.lastIdleUpdate > 20000) {
-        lcdState.lastIdleUpdate = currentTime;
-        lcdIdleScreen();
-      } else if (lcdState.isUpdateNeeded) {
-        lcdIdleScreen();
-        lcdState.isUpdateNeeded = false;
+      if (lcdState->lastPressedButton != NONE) {
+        lcdState->lastPressedButton = NONE;
+        lcdState->state = LCD_SETTINGS;
+        lcdState->settingsState = HOPPERS_COUNT > 1 ? LCD_SETTINGS_HOPPER : LCD_SETTINGS_START;
+        lcdState->isUpdateNeeded = true;
+        break;
+      }
+
+      uint32_t currentTime = getFeederMillis(feeder);
+      if (currentTime - lcdState->lastIdleUpdate > 20000) {
+        lcdState->lastIdleUpdate = currentTime;
+        lcdIdleScreen(feeder);
+      } else if (lcdState->isUpdateNeeded) {
+        lcdIdleScreen(feeder);
+        lcdState->isUpdateNeeded = false;
       }
       break;
     }
     case LCD_SETTINGS:
-      lcdSettingsScreen();
+      lcdSettingsScreen(feeder);
+      break;
+    case LCD_DISPENSING:
+      lcdDispenseScreen(feeder);
       break;
   }
 }
@@ -48,34 +66,41 @@ void handleLCD() {
 * lcdWelcomeScreen
 *
 * @brief Displays the welcome screen
+*
+* @param[in] feeder The feeder
 *******************************************************************************/
-void lcdWelcomeScreen() {
-  lcd_clear_i2c();
-  lcd_setCursor_i2c(3, 0);
-  lcd_writeString_i2c("Pet Feeder");
-  lcd_setCursor_i2c(4, 1);
-  lcd_writeString_i2c("Welcome!");
+void lcdWelcomeScreen(feederS *feeder) {
+  lcd_clear_i2c(feeder);
+  lcd_setCursor_i2c(feeder, 3, 0);
+  lcd_writeString_i2c(feeder, "Pet Feeder");
+  lcd_setCursor_i2c(feeder, 4, 1);
+  lcd_writeString_i2c(feeder, "Welcome!");
 }
 
 /*******************************************************************************
 * lcdIdleScreen
 *
 * @brief Displays the idle screen with the current time and the time until the
-*        next feeding
+*        next feeding of any hopper
+*
+* @param[in] feeder The feeder
 *******************************************************************************/
-void lcdIdleScreen() {
-  time_t rawTime;
-  struct tm* timeInfo;
+void lcdIdleScreen(feederS *feeder) {
+  time_t rawTime = getFeederTime(feeder);
+  struct tm timeInfo;
   char timeBuffer[17];
 
-  time(&rawTime);
-  timeInfo = localtime(&rawTime);
+  getFeederLocalTime(feeder, rawTime, &timeInfo);
 
   // Locale dependent date and time format
-  strftime(timeBuffer, sizeof(timeBuffer), "%H:%M - %d.%m.%y", timeInfo);
+  strftime(timeBuffer, sizeof(timeBuffer), "%H:%M - %d.%m.%y", &timeInfo);
 
   char feedingTimeBuffer[17];
-  uint16_t minutesUntilFeeding = minutesToNextFeeding();
+  uint16_t minutesUntilFeeding = UINT16_MAX;
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    uint16_t minutes = minutesToNextFeeding(feeder, i);
+    if (minutes < minutesUntilFeeding) minutesUntilFeeding = minutes;
+  }
   if (minutesUntilFeeding != UINT16_MAX) {
     uint8_t hours = minutesUntilFeeding / 60;
     uint8_t minutes = minutesUntilFeeding % 60;
@@ -85,211 +110,331 @@ void lcdIdleScreen() {
     sprintf(feedingTimeBuffer, "Schedule empty!");
   }
 
-  lcd_clear_i2c();
-  lcd_writeString_i2c(timeBuffer);
-  lcd_setCursor_i2c(0, 1);
-  lcd_writeString_i2c(feedingTimeBuffer);
+  lcd_clear_i2c(feeder);
+  lcd_writeString_i2c(feeder, timeBuffer);
+  lcd_setCursor_i2c(feeder, 0, 1);
+  lcd_writeString_i2c(feeder, feedingTimeBuffer);
+}
+
+/*******************************************************************************
+* lcdDispenseScreen
+*
+* @brief Displays the progress of the dispensed portions and the portions
+*        waiting for them, of the first hopper which dispenses. Button left
+*        cancels the dispensing of all hoppers, the screen returns to idle once
+*        the dispensers are done
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void lcdDispenseScreen(feederS *feeder) {
+  lcdStateMachineS *lcdState = &feeder->lcdState;
+  dispenseProgressS progress = {0};
+  uint8_t hopper = 0;
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    progress = getDispenseProgress(feeder, i);
+    hopper = i;
+    if (progress.isDispensing || progress.queuedJobs > 0) break;
+  }
+
+  if (!progress.isDispensing && progress.queuedJobs == 0) {
+    lcdState->lastPressedButton = NONE;
+    lcdState->state = LCD_IDLE;
+    lcdState->isUpdateNeeded = true;
+    return;
+  }
+
+  if (lcdState->lastPressedButton == LEFT) {
+    for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+      cancelDispense(feeder, i);
+    }
+  }
+  lcdState->lastPressedButton = NONE;
+
+  dispenseProgressS *shown = &lcdState->dispenseProgress;
+  if (!lcdState->isUpdateNeeded && hopper == lcdState->dispenseHopper &&
+      progress.isDispensing == shown->isDispensing && progress.source == shown->source &&
+      progress.portions == shown->portions && progress.dispensed == shown->dispensed &&
+      progress.queuedPortions == shown->queuedPortions) {
+    return;
+  }
+  *shown = progress;
+  lcdState->dispenseHopper = hopper;
+  lcdState->isUpdateNeeded = false;
+
+  char line1Buffer[17];
+  char line2Buffer[17];
+  char hopperBuffer[4] = "";
+
+  // The hopper is only worth the space on the screen if there are several
+  if (HOPPERS_COUNT > 1) sprintf(hopperBuffer, "%hhu:", hopper + 1);
+
+  if (progress.isDispensing) {
+    sprintf(line1Buffer, "%s%s %hhu/%hhu", hopperBuffer, getDispenseSourceName(progress.source),
+      progress.dispensed, progress.portions);
+  }
+  else {
+    sprintf(line1Buffer, "%sDispensing", hopperBuffer);
+  }
+
+  if (progress.queuedPortions > 0) {
+    sprintf(line2Buffer, "<Cancel  +%hu", progress.queuedPortions);
+  }
+  else {
+    sprintf(line2Buffer, "<Cancel");
+  }
+
+  lcd_clear_i2c(feeder);
+  lcd_writeString_i2c(feeder, line1Buffer);
+  lcd_setCursor_i2c(feeder, 0, 1);
+  lcd_writeString_i2c(feeder, line2Buffer);
 }
 
 /*******************************************************************************
 * handleLCD
 *
 * @brief Handles the settings LCD state machine
+*
+* @param[in] feeder The feeder
 *******************************************************************************/
-void lcdSettingsScreen() {
-  if (millis() - lcdState.lastButtonPressTime > 30000) {
-    lcdState.state = LCD_IDLE;
-    lcdState.settingsState = LCD_SETTINGS_START;
-    lcdState.selectedRow = 0;
-    lcdState.selectedFeedSchedule = 0;
-    lcdState.entryMode = (lcdEntryModeS){0};
-    lcdState.isUpdateNeeded = true;
-    lcd_blinkOff_i2c();
+void lcdSettingsScreen(feederS *feeder) {
+  lcdStateMachineS *lcdState = &feeder->lcdState;
+  if (getFeederMillis(feeder) - lcdState->lastButtonPressTime > 30000) {
+    lcdState->state = LCD_IDLE;
+    lcdState->settingsState = LCD_SETTINGS_START;
+    lcdState->selectedRow = 0;
+    lcdState->selectedFeedSchedule = 0;
+    lcdState->selectedHopper = 0;
+    lcdState->entryMode = (lcdEntryModeS){0};
+    lcdState->isUpdateNeeded = true;
+    lcd_blinkOff_i2c(feeder);
     return;
   }
 
-  switch (lcdState.settingsState) {
+  switch (lcdState->settingsState) {
+    case LCD_SETTINGS_HOPPER:
+      if (lcdState->isUpdateNeeded) {
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, "Hopper 1");
+        lcd_setCursor_i2c(feeder, 0, 1);
+        lcd_writeString_i2c(feeder, "Hopper 2");
+        lcdDrawPointingArrow(feeder);
+
+        lcdState->isUpdateNeeded = false;
+      }
+
+      switch (lcdState->lastPressedButton) {
+        case UP:
+        case DOWN:
+          lcdState->lastPressedButton = NONE;
+          lcdState->selectedRow = !lcdState->selectedRow;
+          lcdDrawPointingArrow(feeder);
+          break;
+        case LEFT:
+          lcdState->lastPressedButton = NONE;
+          lcdState->selectedRow = 0;
+          lcdState->selectedHopper = 0;
+          lcdState->state = LCD_IDLE;
+          lcdState->isUpdateNeeded = true;
+          break;
+        case RIGHT:
+          lcdState->lastPressedButton = NONE;
+          lcdState->selectedHopper = lcdState->selectedRow;
+          lcdState->settingsState = LCD_SETTINGS_START;
+          lcdState->selectedRow = 0;
+          lcdState->isUpdateNeeded = true;
+        default:
+          break;
+      }
+
+      break;
     case LCD_SETTINGS_START:
-      if (lcdState.isUpdateNeeded) {
-        lcd_clear_i2c();
-        lcd_writeString_i2c("Schedule");
-        lcd_setCursor_i2c(0, 1);
-        lcd_writeString_i2c("Feeder wheel");
-        lcdDrawPointingArrow();
-
-        lcdState.isUpdateNeeded = false;
+      if (lcdState->isUpdateNeeded) {
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, "Schedule");
+        lcd_setCursor_i2c(feeder, 0, 1);
+        lcd_writeString_i2c(feeder, "Feeder wheel");
+        lcdDrawPointingArrow(feeder);
+
+        lcdState->isUpdateNeeded = false;
       }
 
-      switch (lcdState.lastPressedButton) {
+      switch (lcdState->lastPressedButton) {
         case UP:
         case DOWN:
-          lcdState.lastPressedButton = NONE;
-          lcdState.selectedRow = !lcdState.selectedRow;
-          lcdDrawPointingArrow();
+          lcdState->lastPressedButton = NONE;
+          lcdState->selectedRow = !lcdState->selectedRow;
+          lcdDrawPointingArrow(feeder);
           break;
         case LEFT:
-          lcdState.lastPressedButton = NONE;
-          lcdState.selectedRow = 0;
-          lcdState.state = LCD_IDLE;
-          lcdState.isUpdateNeeded = true;
+          lcdState->lastPressedButton = NONE;
+          if (HOPPERS_COUNT > 1) {
+            lcdState->selectedRow = lcdState->selectedHopper;
+            lcdState->settingsState = LCD_SETTINGS_HOPPER;
+          }
+          else {
+            lcdState->selectedRow = 0;
+            lcdState->state = LCD_IDLE;
+          }
+          lcdState->isUpdateNeeded = true;
           break;
         case RIGHT:
-          lcdState.lastPressedButton = NONE;
-          switch (lcdState.selectedRow) {
+          lcdState->lastPressedButton = NONE;
+          switch (lcdState->selectedRow) {
             case 0:
-              lcdState.settingsState = LCD_SETTINGS_SCHEDULE;
+              lcdState->settingsState = LCD_SETTINGS_SCHEDULE;
               break;
             case 1:
-              lcdState.settingsState = LCD_SETTINGS_WHEEL_EDIT;
+              lcdState->settingsState = LCD_SETTINGS_WHEEL_EDIT;
               break;
           }
-          lcdState.selectedRow = 0;
-          lcdState.isUpdateNeeded = true;
+          lcdState->selectedRow = 0;
+          lcdState->isUpdateNeeded = true;
         default:
           break;
       }
 
       break;
     case LCD_SETTINGS_SCHEDULE:
-      if (lcdState.isUpdateNeeded) {
+      if (lcdState->isUpdateNeeded) {
         char line1Buffer[17];
         char line2Buffer[17];
 
         // Calculate the schedule indexes to display on the screen
-        uint8_t scheduleIndex1 = lcdState.selectedFeedSchedule;
-        uint8_t scheduleIndex2 = scheduleIndex1 + 1;
+        uint16_t scheduleIndex1 = lcdState->selectedFeedSchedule;
+        uint16_t scheduleIndex2 = scheduleIndex1 + 1;
 
-        if (lcdState.selectedRow == 1) {
+        if (lcdState->selectedRow == 1) {
           scheduleIndex1 = scheduleIndex1 > 0 ? scheduleIndex1 - 1 : 0;
-          scheduleIndex2 = lcdState.selectedFeedSchedule;
+          scheduleIndex2 = lcdState->selectedFeedSchedule;
         }
 
-        if (getActiveFeedingTimes() == 0) {
+        if (getActiveFeedingTimes(feeder, lcdState->selectedHopper) == 0) {
           sprintf(line1Buffer, "Schedule empty!");
         }
-        else if (scheduleIndex1 < getActiveFeedingTimes()) {
-          uint8_t hour = getFeedingTimeHour(scheduleIndex1);
-          uint8_t minute = getFeedingTimeMinute(scheduleIndex1);
+        else if (scheduleIndex1 < getActiveFeedingTimes(feeder, lcdState->selectedHopper)) {
+          uint8_t hour = getFeedingTimeHour(feeder, lcdState->selectedHopper, scheduleIndex1);
+          uint8_t minute = getFeedingTimeMinute(feeder, lcdState->selectedHopper, scheduleIndex1);
 
           if (hour < 10 && minute < 10) {
             sprintf(line1Buffer, "%hhu. 0%hhu:0%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1));
           }
           else if (hour < 10 && minute >= 10) {
             sprintf(line1Buffer, "%hhu. 0%hhu:%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1));
           }
           else if (hour >= 10 && minute < 10) {
             sprintf(line1Buffer, "%hhu. %hhu:0%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1));
           }
           else {
             sprintf(line1Buffer, "%hhu. %hhu:%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1));
           }
         }
         else {
-          uint8_t hour = getFeedingTimeHour(scheduleIndex1 - 1);
-          uint8_t minute = getFeedingTimeMinute(scheduleIndex1 - 1);
+          uint8_t hour = getFeedingTimeHour(feeder, lcdState->selectedHopper, scheduleIndex1 - 1);
+          uint8_t minute = getFeedingTimeMinute(feeder, lcdState->selectedHopper, scheduleIndex1 - 1);
 
           if (hour < 10 && minute < 10) {
             sprintf(line1Buffer, "%hhu. 0%hhu:0%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1 - 1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1 - 1));
           }
           else if (hour < 10 && minute >= 10) {
             sprintf(line1Buffer, "%hhu. 0%hhu:%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1 - 1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1 - 1));
           }
           else if (hour >= 10 && minute < 10) {
             sprintf(line1Buffer, "%hhu. %hhu:0%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1 - 1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1 - 1));
           }
           else {
             sprintf(line1Buffer, "%hhu. %hhu:%hhu - %hhu", scheduleIndex1,
-                    hour, minute, getFeedingTimePortions(scheduleIndex1 - 1));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex1 - 1));
           }
         }
 
-        if (scheduleIndex2 < getActiveFeedingTimes()) {
-          uint8_t hour = getFeedingTimeHour(scheduleIndex2);
-          uint8_t minute = getFeedingTimeMinute(scheduleIndex2);
+        if (scheduleIndex2 < getActiveFeedingTimes(feeder, lcdState->selectedHopper)) {
+          uint8_t hour = getFeedingTimeHour(feeder, lcdState->selectedHopper, scheduleIndex2);
+          uint8_t minute = getFeedingTimeMinute(feeder, lcdState->selectedHopper, scheduleIndex2);
 
           if (hour < 10 && minute < 10) {
             sprintf(line2Buffer, "%hhu. 0%hhu:0%hhu - %hhu", scheduleIndex2,
-                    hour, minute, getFeedingTimePortions(scheduleIndex2));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex2));
           }
           else if (hour < 10 && minute >= 10) {
             sprintf(line2Buffer, "%hhu. 0%hhu:%hhu - %hhu", scheduleIndex2,
-                    hour, minute, getFeedingTimePortions(scheduleIndex2));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex2));
           }
           else if (hour >= 10 && minute < 10) {
             sprintf(line2Buffer, "%hhu. %hhu:0%hhu - %hhu", scheduleIndex2,
-                    hour, minute, getFeedingTimePortions(scheduleIndex2));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex2));
           }
           else {
             sprintf(line2Buffer, "%hhu. %hhu:%hhu - %hhu", scheduleIndex2,
-                    hour, minute, getFeedingTimePortions(scheduleIndex2));
+                    hour, minute, getFeedingTimePortions(feeder, lcdState->selectedHopper, scheduleIndex2));
           }
         }
         else {
           sprintf(line2Buffer, "Add new");
         }
 
-        lcd_clear_i2c();
-        lcd_writeString_i2c(line1Buffer);
-        lcd_setCursor_i2c(0, 1);
-        lcd_writeString_i2c(line2Buffer);
-        lcdDrawPointingArrow();
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, line1Buffer);
+        lcd_setCursor_i2c(feeder, 0, 1);
+        lcd_writeString_i2c(feeder, line2Buffer);
+        lcdDrawPointingArrow(feeder);
 
-        lcdState.isUpdateNeeded = false;
+        lcdState->isUpdateNeeded = false;
       }
 
-      switch (lcdState.lastPressedButton) {
+      switch (lcdState->lastPressedButton) {
         case UP:
-          lcdState.lastPressedButton = NONE;
-          if (lcdState.selectedFeedSchedule > 0) {
-            lcdState.selectedFeedSchedule--;
+          lcdState->lastPressedButton = NONE;
+          if (lcdState->selectedFeedSchedule > 0) {
+            lcdState->selectedFeedSchedule--;
           }
 
-          if (lcdState.selectedRow == 0) {
-              lcdState.isUpdateNeeded = true;
+          if (lcdState->selectedRow == 0) {
+              lcdState->isUpdateNeeded = true;
           }
           else {
-            lcdState.selectedRow = 0;
-            lcdDrawPointingArrow();
+            lcdState->selectedRow = 0;
+            lcdDrawPointingArrow(feeder);
           }
           break;
         case DOWN:
-          lcdState.lastPressedButton = NONE;
-          if (lcdState.selectedFeedSchedule < getActiveFeedingTimes()) { // allows to go 1 over for add new
-            lcdState.selectedFeedSchedule++;
+          lcdState->lastPressedButton = NONE;
+          if (lcdState->selectedFeedSchedule < getActiveFeedingTimes(feeder, lcdState->selectedHopper)) { // allows to go 1 over for add new
+            lcdState->selectedFeedSchedule++;
           }
 
-          if (lcdState.selectedRow == 1) {
-            lcdState.isUpdateNeeded = true;
+          if (lcdState->selectedRow == 1) {
+            lcdState->isUpdateNeeded = true;
           }
           else {
-            lcdState.selectedRow = 1;
-            lcdDrawPointingArrow();
+            lcdState->selectedRow = 1;
+            lcdDrawPointingArrow(feeder);
           }
           break;
         case LEFT:
-          lcdState.lastPressedButton = NONE;
-          lcdState.settingsState = LCD_SETTINGS_START;
-          lcdState.isUpdateNeeded = true;
-          lcdState.selectedRow = 0;
-          lcdState.selectedFeedSchedule = 0;
+          lcdState->lastPressedButton = NONE;
+          lcdState->settingsState = LCD_SETTINGS_START;
+          lcdState->isUpdateNeeded = true;
+          lcdState->selectedRow = 0;
+          lcdState->selectedFeedSchedule = 0;
           break;
         case RIGHT:
-          lcdState.lastPressedButton = NONE;
-          if (lcdState.selectedFeedSchedule < getActiveFeedingTimes()) {
-            lcdState.settingsState = LCD_SETTINGS_SCHEDULE_ENTRY_OPTIONS;
+          lcdState->lastPressedButton = NONE;
+          if (lcdState->selectedFeedSchedule < getActiveFeedingTimes(feeder, lcdState->selectedHopper)) {
+            lcdState->settingsState = LCD_SETTINGS_SCHEDULE_ENTRY_OPTIONS;
           }
           else {
-            lcdState.settingsState = LCD_SETTINGS_SCHEDULE_ADD;
+            lcdState->settingsState = LCD_SETTINGS_SCHEDULE_ADD;
           }
-          lcdState.selectedRow = 0;
-          lcdState.isUpdateNeeded = true;
+          lcdState->selectedRow = 0;
+          lcdState->isUpdateNeeded = true;
           break;
         default:
           break;
@@ -297,42 +442,42 @@ void lcdSettingsScreen() {
 
       break;
     case LCD_SETTINGS_SCHEDULE_ENTRY_OPTIONS:
-      if (lcdState.isUpdateNeeded) {
-        lcd_clear_i2c();
-        lcd_writeString_i2c("Modify");
-        lcd_setCursor_i2c(0, 1);
-        lcd_writeString_i2c("Remove");
-        lcdDrawPointingArrow();
-
-        lcdState.isUpdateNeeded = false;
+      if (lcdState->isUpdateNeeded) {
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, "Modify");
+        lcd_setCursor_i2c(feeder, 0, 1);
+        lcd_writeString_i2c(feeder, "Remove");
+        lcdDrawPointingArrow(feeder);
+
+        lcdState->isUpdateNeeded = false;
       }
 
-      switch (lcdState.lastPressedButton) {
+      switch (lcdState->lastPressedButton) {
         case UP:
         case DOWN:
-          lcdState.lastPressedButton = NONE;
-          lcdState.selectedRow = !lcdState.selectedRow;
-          lcdDrawPointingArrow();
+          lcdState->lastPressedButton = NONE;
+          lcdState->selectedRow = !lcdState->selectedRow;
+          lcdDrawPointingArrow(feeder);
           break;
         case LEFT:
-          lcdState.lastPressedButton = NONE;
-          lcdState.settingsState = LCD_SETTINGS_SCHEDULE;
-          lcdState.selectedRow = 0;
-          lcdState.selectedFeedSchedule = 0;
-          lcdState.isUpdateNeeded = true;
+          lcdState->lastPressedButton = NONE;
+          lcdState->settingsState = LCD_SETTINGS_SCHEDULE;
+          lcdState->selectedRow = 0;
+          lcdState->selectedFeedSchedule = 0;
+          lcdState->isUpdateNeeded = true;
           break;
         case RIGHT:
-          lcdState.lastPressedButton = NONE;
-          lcdState.isUpdateNeeded = true;
+          lcdState->lastPressedButton = NONE;
+          lcdState->isUpdateNeeded = true;
 
-          if (lcdState.selectedRow == 0) {
-            lcdState.settingsState = LCD_SETTINGS_SCHEDULE_ENTRY_EDIT;
+          if (lcdState->selectedRow == 0) {
+            lcdState->settingsState = LCD_SETTINGS_SCHEDULE_ENTRY_EDIT;
           }
           else {
-            removeFeedingTime(lcdState.selectedFeedSchedule);
-            lcdState.settingsState = LCD_SETTINGS_SCHEDULE;
-            lcdState.selectedRow = 0;
-            lcdState.selectedFeedSchedule = 0;
+            removeFeedingTime(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule);
+            lcdState->settingsState = LCD_SETTINGS_SCHEDULE;
+            lcdState->selectedRow = 0;
+            lcdState->selectedFeedSchedule = 0;
           }
           break;
         default:
@@ -341,17 +486,17 @@ void lcdSettingsScreen() {
 
       break;
     case LCD_SETTINGS_SCHEDULE_ENTRY_EDIT:
-      if (lcdState.isUpdateNeeded) {
+      if (lcdState->isUpdateNeeded) {
         char line1Buffer[17];
         char line2Buffer[17];
 
-        if (lcdState.entryMode.isNewTimeTaken) {
+        if (lcdState->entryMode.isNewTimeTaken) {
           sprintf(line1Buffer, "Time in schedule");
           sprintf(line2Buffer, " ");
         }
         else {
-          uint8_t hour = getFeedingTimeHour(lcdState.selectedFeedSchedule);
-          uint8_t minute = getFeedingTimeMinute(lcdState.selectedFeedSchedule);
+          uint8_t hour = getFeedingTimeHour(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule);
+          uint8_t minute = getFeedingTimeMinute(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule);
 
           if (hour < 10 && minute < 10) {
             sprintf(line1Buffer, "Time: 0%hhu:0%hhu", hour, minute);
@@ -367,72 +512,72 @@ void lcdSettingsScreen() {
           }
 
           sprintf(line2Buffer, "Portions: %hhu",
-            getFeedingTimePortions(lcdState.selectedFeedSchedule));
+            getFeedingTimePortions(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule));
         }
 
-        lcd_clear_i2c();
-        lcd_writeString_i2c(line1Buffer);
-        lcd_setCursor_i2c(0, 1);
-        lcd_writeString_i2c(line2Buffer);
-        if (!lcdState.entryMode.isNewTimeTaken) lcdDrawPointingArrow();
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, line1Buffer);
+        lcd_setCursor_i2c(feeder, 0, 1);
+        lcd_writeString_i2c(feeder, line2Buffer);
+        if (!lcdState->entryMode.isNewTimeTaken) lcdDrawPointingArrow(feeder);
 
-        lcdState.isUpdateNeeded = false;
+        lcdState->isUpdateNeeded = false;
       }
 
-      if (lcdState.entryMode.isEntryMode) {
-        lcd_blinkOn_i2c();
+      if (lcdState->entryMode.isEntryMode) {
+        lcd_blinkOn_i2c(feeder);
 
         // Editing time of feeding time
-        if (lcdState.selectedRow == 0) {
+        if (lcdState->selectedRow == 0) {
           char numBuffer[3];
 
           // Editing hour of feeding time
-          if (!lcdState.entryMode.isMinutesEdited) {
-            lcd_setCursor_i2c(6, 0);
+          if (!lcdState->entryMode.isMinutesEdited) {
+            lcd_setCursor_i2c(feeder, 6, 0);
 
-            switch (lcdState.lastPressedButton) {
+            switch (lcdState->lastPressedButton) {
               case UP:
-                lcdState.lastPressedButton = NONE;
-                if (lcdState.entryMode.currentlySelectedValue < 23) {
-                  lcdState.entryMode.currentlySelectedValue++;
-                  if (lcdState.entryMode.currentlySelectedValue < 10) {
-                    sprintf(numBuffer, "0%hhu", lcdState.entryMode.currentlySelectedValue);
+                lcdState->lastPressedButton = NONE;
+                if (lcdState->entryMode.currentlySelectedValue < 23) {
+                  lcdState->entryMode.currentlySelectedValue++;
+                  if (lcdState->entryMode.currentlySelectedValue < 10) {
+                    sprintf(numBuffer, "0%hhu", lcdState->entryMode.currentlySelectedValue);
                   }
                   else {
-                    sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue);
+                    sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue);
                   }
-                  lcd_setCursor_i2c(6, 0);
-                  lcd_writeString_i2c(numBuffer);
+                  lcd_setCursor_i2c(feeder, 6, 0);
+                  lcd_writeString_i2c(feeder, numBuffer);
                 }
                 break;
               case DOWN:
-                lcdState.lastPressedButton = NONE;
-                if (lcdState.entryMode.currentlySelectedValue > 0) {
-                  lcdState.entryMode.currentlySelectedValue--;
-                  if (lcdState.entryMode.currentlySelectedValue < 10) {
-                    sprintf(numBuffer, "0%hhu", lcdState.entryMode.currentlySelectedValue);
+                lcdState->lastPressedButton = NONE;
+                if (lcdState->entryMode.currentlySelectedValue > 0) {
+                  lcdState->entryMode.currentlySelectedValue--;
+                  if (lcdState->entryMode.currentlySelectedValue < 10) {
+                    sprintf(numBuffer, "0%hhu", lcdState->entryMode.currentlySelectedValue);
                   }
                   else {
-                    sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue);
+                    sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue);
                   }
-                  lcd_setCursor_i2c(6, 0);
-                  lcd_writeString_i2c(numBuffer);
+                  lcd_setCursor_i2c(feeder, 6, 0);
+                  lcd_writeString_i2c(feeder, numBuffer);
                 }
                 break;
               case LEFT:
-                lcdState.lastPressedButton = NONE;
-                lcdState.entryMode.isEntryMode = false;
-                if (lcdState.entryMode.valueBeforeEdit < 10)
-                  sprintf(numBuffer, "0%hhu", lcdState.entryMode.valueBeforeEdit);
+                lcdState->lastPressedButton = NONE;
+                lcdState->entryMode.isEntryMode = false;
+                if (lcdState->entryMode.valueBeforeEdit < 10)
+                  sprintf(numBuffer, "0%hhu", lcdState->entryMode.valueBeforeEdit);
                 else
-                  sprintf(numBuffer, "%hhu", lcdState.entryMode.valueBeforeEdit);
-                lcd_setCursor_i2c(6, 0);
-                lcd_writeString_i2c(numBuffer);
-                lcd_blinkOff_i2c();
+                  sprintf(numBuffer, "%hhu", lcdState->entryMode.valueBeforeEdit);
+                lcd_setCursor_i2c(feeder, 6, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
+                lcd_blinkOff_i2c(feeder);
                 break;
               case RIGHT:
-                lcdState.lastPressedButton = NONE;
-                lcdState.entryMode.isMinutesEdited = true;
+                lcdState->lastPressedButton = NONE;
+                lcdState->entryMode.isMinutesEdited = true;
                 break;
               default:
                 break;
@@ -440,58 +585,58 @@ void lcdSettingsScreen() {
           }
           // Editing minute of feeding time
           else {
-            lcd_setCursor_i2c(9, 0);
+            lcd_setCursor_i2c(feeder, 9, 0);
 
-            switch (lcdState.lastPressedButton) {
+            switch (lcdState->lastPressedButton) {
               case UP:
-                lcdState.lastPressedButton = NONE;
-                if (lcdState.entryMode.currentlySelectedValue2 < 59) {
-                  lcdState.entryMode.currentlySelectedValue2++;
-                  if (lcdState.entryMode.currentlySelectedValue2 < 10) {
-                    sprintf(numBuffer, "0%hhu", lcdState.entryMode.currentlySelectedValue2);
+                lcdState->lastPressedButton = NONE;
+                if (lcdState->entryMode.currentlySelectedValue2 < 59) {
+                  lcdState->entryMode.currentlySelectedValue2++;
+                  if (lcdState->entryMode.currentlySelectedValue2 < 10) {
+                    sprintf(numBuffer, "0%hhu", lcdState->entryMode.currentlySelectedValue2);
                   }
                   else {
-                    sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue2);
+                    sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue2);
                   }
-                  lcd_setCursor_i2c(9, 0);
-                  lcd_writeString_i2c(numBuffer);
+                  lcd_setCursor_i2c(feeder, 9, 0);
+                  lcd_writeString_i2c(feeder, numBuffer);
                 }
                 break;
               case DOWN:
-                lcdState.lastPressedButton = NONE;
-                if (lcdState.entryMode.currentlySelectedValue2 > 0) {
-                  lcdState.entryMode.currentlySelectedValue2--;
-                  if (lcdState.entryMode.currentlySelectedValue2 < 10) {
-                    sprintf(numBuffer, "0%hhu", lcdState.entryMode.currentlySelectedValue2);
+                lcdState->lastPressedButton = NONE;
+                if (lcdState->entryMode.currentlySelectedValue2 > 0) {
+                  lcdState->entryMode.currentlySelectedValue2--;
+                  if (lcdState->entryMode.currentlySelectedValue2 < 10) {
+                    sprintf(numBuffer, "0%hhu", lcdState->entryMode.currentlySelectedValue2);
                   }
                   else {
-                    sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue2);
+                    sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue2);
                   }
-                  lcd_setCursor_i2c(9, 0);
-                  lcd_writeString_i2c(numBuffer);
+                  lcd_setCursor_i2c(feeder, 9, 0);
+                  lcd_writeString_i2c(feeder, numBuffer);
                 }
                 break;
               case LEFT:
-                lcdState.lastPressedButton = NONE;
-                lcdState.entryMode.isMinutesEdited = false;
-                sprintf(numBuffer, "%hhu", lcdState.entryMode.valueBeforeEdit2);
-                lcd_setCursor_i2c(9, 0);
-                lcd_writeString_i2c(numBuffer);
+                lcdState->lastPressedButton = NONE;
+                lcdState->entryMode.isMinutesEdited = false;
+                sprintf(numBuffer, "%hhu", lcdState->entryMode.valueBeforeEdit2);
+                lcd_setCursor_i2c(feeder, 9, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
                 break;
               case RIGHT:
-                lcdState.lastPressedButton = NONE;
-                lcd_blinkOff_i2c();
-                if (isFeedingTimeDuplicate(lcdState.entryMode.currentlySelectedValue, lcdState.entryMode.currentlySelectedValue2)) {
-                  lcdState.isUpdateNeeded = true;
-                  lcdState.entryMode.isEntryMode = false;
-                  lcdState.entryMode.isMinutesEdited = false;
-                  lcdState.entryMode.isNewTimeTaken = true;
+                lcdState->lastPressedButton = NONE;
+                lcd_blinkOff_i2c(feeder);
+                if (isFeedingTimeDuplicate(feeder, lcdState->selectedHopper, lcdState->entryMode.currentlySelectedValue, lcdState->entryMode.currentlySelectedValue2)) {
+                  lcdState->isUpdateNeeded = true;
+                  lcdState->entryMode.isEntryMode = false;
+                  lcdState->entryMode.isMinutesEdited = false;
+                  lcdState->entryMode.isNewTimeTaken = true;
                   break;
                 } else {
-                  saveModifiedFeedingTime(lcdState.selectedFeedSchedule,
-                                          lcdState.entryMode.currentlySelectedValue,
-                                          lcdState.entryMode.currentlySelectedValue2);
-                  lcdState.entryMode.isEntryMode = false;
+                  saveModifiedFeedingTime(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule,
+                                          lcdState->entryMode.currentlySelectedValue,
+                                          lcdState->entryMode.currentlySelectedValue2);
+                  lcdState->entryMode.isEntryMode = false;
                 }
                 break;
               default:
@@ -500,43 +645,43 @@ void lcdSettingsScreen() {
           }
         }
         // Editing portions of feeding time
-        else if (lcdState.selectedRow == 1) {
-          lcd_setCursor_i2c(10, 1);
+        else if (lcdState->selectedRow == 1) {
+          lcd_setCursor_i2c(feeder, 10, 1);
           char numBuffer[3];
 
-          switch (lcdState.lastPressedButton) {
+          switch (lcdState->lastPressedButton) {
             case UP:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.currentlySelectedValue < 10) {
-                lcdState.entryMode.currentlySelectedValue++;
-                sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue);
-                lcd_setCursor_i2c(10, 1);
-                lcd_writeString_i2c(numBuffer);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.currentlySelectedValue < 10) {
+                lcdState->entryMode.currentlySelectedValue++;
+                sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue);
+                lcd_setCursor_i2c(feeder, 10, 1);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case DOWN:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.currentlySelectedValue > 1) {
-                lcdState.entryMode.currentlySelectedValue--;
-                sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue);
-                lcd_setCursor_i2c(10, 1);
-                lcd_writeString_i2c(numBuffer);
-                lcd_removeChar_i2c(11, 1); // remove second digit so there is no left over from value 10
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.currentlySelectedValue > 1) {
+                lcdState->entryMode.currentlySelectedValue--;
+                sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue);
+                lcd_setCursor_i2c(feeder, 10, 1);
+                lcd_writeString_i2c(feeder, numBuffer);
+                lcd_removeChar_i2c(feeder, 11, 1); // remove second digit so there is no left over from value 10
               }
               break;
             case LEFT:
-              lcdState.lastPressedButton = NONE;
-              lcdState.entryMode.isEntryMode = false;
-              sprintf(numBuffer, "%hhu", lcdState.entryMode.valueBeforeEdit);
-              lcd_setCursor_i2c(10, 1);
-              lcd_writeString_i2c(numBuffer);
-              lcd_blinkOff_i2c();
+              lcdState->lastPressedButton = NONE;
+              lcdState->entryMode.isEntryMode = false;
+              sprintf(numBuffer, "%hhu", lcdState->entryMode.valueBeforeEdit);
+              lcd_setCursor_i2c(feeder, 10, 1);
+              lcd_writeString_i2c(feeder, numBuffer);
+              lcd_blinkOff_i2c(feeder);
               break;
             case RIGHT:
-              lcdState.lastPressedButton = NONE;
-              setFeedingTimePortions(lcdState.selectedFeedSchedule, lcdState.entryMode.currentlySelectedValue);
-              lcdState.entryMode.isEntryMode = false;
-              lcd_blinkOff_i2c();
+              lcdState->lastPressedButton = NONE;
+              setFeedingTimePortions(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule, lcdState->entryMode.currentlySelectedValue);
+              lcdState->entryMode.isEntryMode = false;
+              lcd_blinkOff_i2c(feeder);
               break;
             default:
               break;
@@ -544,41 +689,41 @@ void lcdSettingsScreen() {
         }
       }
       else {
-        switch (lcdState.lastPressedButton) {
+        switch (lcdState->lastPressedButton) {
           case UP:
           case DOWN:
-            if (lcdState.entryMode.isNewTimeTaken) break;
-            lcdState.lastPressedButton = NONE;
-            lcdState.selectedRow = !lcdState.selectedRow;
-            lcdDrawPointingArrow();
+            if (lcdState->entryMode.isNewTimeTaken) break;
+            lcdState->lastPressedButton = NONE;
+            lcdState->selectedRow = !lcdState->selectedRow;
+            lcdDrawPointingArrow(feeder);
             break;
           case LEFT:
-            lcdState.lastPressedButton = NONE;
-            if (lcdState.entryMode.isNewTimeTaken) break;
-            lcdState.settingsState = LCD_SETTINGS_SCHEDULE_ENTRY_OPTIONS;
-            lcdState.selectedRow = 0;
-            lcdState.selectedFeedSchedule = 0;
-            lcdState.entryMode = (lcdEntryModeS){0};
-            lcdState.isUpdateNeeded = true;
+            lcdState->lastPressedButton = NONE;
+            if (lcdState->entryMode.isNewTimeTaken) break;
+            lcdState->settingsState = LCD_SETTINGS_SCHEDULE_ENTRY_OPTIONS;
+            lcdState->selectedRow = 0;
+            lcdState->selectedFeedSchedule = 0;
+            lcdState->entryMode = (lcdEntryModeS){0};
+            lcdState->isUpdateNeeded = true;
             break;
           case RIGHT:
-            lcdState.lastPressedButton = NONE;
-            if (lcdState.entryMode.isNewTimeTaken) {
-              lcdState.entryMode.isNewTimeTaken = false;
-              lcdState.isUpdateNeeded = true;
+            lcdState->lastPressedButton = NONE;
+            if (lcdState->entryMode.isNewTimeTaken) {
+              lcdState->entryMode.isNewTimeTaken = false;
+              lcdState->isUpdateNeeded = true;
               break;
             }
-            lcdState.entryMode.isEntryMode = true;
-            if (lcdState.selectedRow == 0) {
-              lcdState.entryMode.valueBeforeEdit = getFeedingTimeHour(lcdState.selectedFeedSchedule);
-              lcdState.entryMode.valueBeforeEdit2 = getFeedingTimeMinute(lcdState.selectedFeedSchedule);
+            lcdState->entryMode.isEntryMode = true;
+            if (lcdState->selectedRow == 0) {
+              lcdState->entryMode.valueBeforeEdit = getFeedingTimeHour(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule);
+              lcdState->entryMode.valueBeforeEdit2 = getFeedingTimeMinute(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule);
             }
             else {
-              lcdState.entryMode.valueBeforeEdit = getFeedingTimePortions(lcdState.selectedFeedSchedule);
+              lcdState->entryMode.valueBeforeEdit = getFeedingTimePortions(feeder, lcdState->selectedHopper, lcdState->selectedFeedSchedule);
             }
 
-            lcdState.entryMode.currentlySelectedValue = lcdState.entryMode.valueBeforeEdit;
-            lcdState.entryMode.currentlySelectedValue2 = lcdState.entryMode.valueBeforeEdit2;
+            lcdState->entryMode.currentlySelectedValue = lcdState->entryMode.valueBeforeEdit;
+            lcdState->entryMode.currentlySelectedValue2 = lcdState->entryMode.valueBeforeEdit2;
             break;
           default:
             break;
@@ -587,19 +732,19 @@ void lcdSettingsScreen() {
 
       break;
     case LCD_SETTINGS_SCHEDULE_ADD:
-      if (lcdState.isUpdateNeeded) {
+      if (lcdState->isUpdateNeeded) {
         char line1Buffer[17];
 
-        if (getActiveFeedingTimes() == 10) {
+        if (getActiveFeedingTimes(feeder, lcdState->selectedHopper) == 10) {
           sprintf(line1Buffer, "Schedule full!");
-          lcdState.entryMode.add.isScheduleFull = true;
+          lcdState->entryMode.add.isScheduleFull = true;
         }
-        else if (lcdState.entryMode.add.isScheduleAdded) {
+        else if (lcdState->entryMode.add.isScheduleAdded) {
           sprintf(line1Buffer, "Time in schedule");
         }
-        else if (!lcdState.entryMode.isPortionsEdited) {
-          uint8_t hour = lcdState.entryMode.add.hour;
-          uint8_t minute = lcdState.entryMode.add.minute;
+        else if (!lcdState->entryMode.isPortionsEdited) {
+          uint8_t hour = lcdState->entryMode.add.hour;
+          uint8_t minute = lcdState->entryMode.add.minute;
 
           if (hour < 10 && minute < 10) {
           sprintf(line1Buffer, "Time: 0%hhu:0%hhu", hour, minute);
@@ -616,162 +761,162 @@ void lcdSettingsScreen() {
         }
         else {
           sprintf(line1Buffer, "Portions: %hhu",
-            lcdState.entryMode.add.portions);
+            lcdState->entryMode.add.portions);
         }
 
-        lcd_clear_i2c();
-        lcd_writeString_i2c(line1Buffer);
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, line1Buffer);
 
-        lcdState.isUpdateNeeded = false;
+        lcdState->isUpdateNeeded = false;
       }
 
-      if (lcdState.entryMode.isEntryMode) {
-        lcd_blinkOn_i2c();
+      if (lcdState->entryMode.isEntryMode) {
+        lcd_blinkOn_i2c(feeder);
         char numBuffer[3];
 
         // Editing hour of feeding
-        if (!lcdState.entryMode.isMinutesEdited && !lcdState.entryMode.isPortionsEdited) {
-          lcd_setCursor_i2c(6, 0);
-          switch (lcdState.lastPressedButton) {
+        if (!lcdState->entryMode.isMinutesEdited && !lcdState->entryMode.isPortionsEdited) {
+          lcd_setCursor_i2c(feeder, 6, 0);
+          switch (lcdState->lastPressedButton) {
             case UP:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.add.hour < 23) {
-                lcdState.entryMode.add.hour++;
-                if (lcdState.entryMode.add.hour < 10) {
-                  sprintf(numBuffer, "0%hhu", lcdState.entryMode.add.hour);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.add.hour < 23) {
+                lcdState->entryMode.add.hour++;
+                if (lcdState->entryMode.add.hour < 10) {
+                  sprintf(numBuffer, "0%hhu", lcdState->entryMode.add.hour);
                 }
                 else {
-                  sprintf(numBuffer, "%hhu", lcdState.entryMode.add.hour);
+                  sprintf(numBuffer, "%hhu", lcdState->entryMode.add.hour);
                 }
-                lcd_setCursor_i2c(6, 0);
-                lcd_writeString_i2c(numBuffer);
+                lcd_setCursor_i2c(feeder, 6, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case DOWN:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.add.hour > 0) {
-                lcdState.entryMode.add.hour--;
-                if (lcdState.entryMode.add.hour < 10) {
-                  sprintf(numBuffer, "0%hhu", lcdState.entryMode.add.hour);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.add.hour > 0) {
+                lcdState->entryMode.add.hour--;
+                if (lcdState->entryMode.add.hour < 10) {
+                  sprintf(numBuffer, "0%hhu", lcdState->entryMode.add.hour);
                 }
                 else {
-                  sprintf(numBuffer, "%hhu", lcdState.entryMode.add.hour);
+                  sprintf(numBuffer, "%hhu", lcdState->entryMode.add.hour);
                 }
-                lcd_setCursor_i2c(6, 0);
-                lcd_writeString_i2c(numBuffer);
+                lcd_setCursor_i2c(feeder, 6, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case LEFT:
-              lcdState.lastPressedButton = NONE;
-              lcdState.entryMode.isEntryMode = false;
-              lcdState.entryMode.add.hour = 0;
-              lcdState.entryMode.add.minute = 0;
-              lcdState.entryMode.add.portions = 1;
-              lcdState.isUpdateNeeded = true;
-              lcd_blinkOff_i2c();
+              lcdState->lastPressedButton = NONE;
+              lcdState->entryMode.isEntryMode = false;
+              lcdState->entryMode.add.hour = 0;
+              lcdState->entryMode.add.minute = 0;
+              lcdState->entryMode.add.portions = 1;
+              lcdState->isUpdateNeeded = true;
+              lcd_blinkOff_i2c(feeder);
               break;
             case RIGHT:
-              lcdState.lastPressedButton = NONE;
-              lcdState.entryMode.isMinutesEdited = true;
-              lcdState.isUpdateNeeded = true;
+              lcdState->lastPressedButton = NONE;
+              lcdState->entryMode.isMinutesEdited = true;
+              lcdState->isUpdateNeeded = true;
               break;
             default:
               break;
             }
         }
         // Editing minute of feeding
-        else if (lcdState.entryMode.isMinutesEdited && !lcdState.entryMode.isPortionsEdited) {
-          lcd_setCursor_i2c(9, 0);
-          switch (lcdState.lastPressedButton) {
+        else if (lcdState->entryMode.isMinutesEdited && !lcdState->entryMode.isPortionsEdited) {
+          lcd_setCursor_i2c(feeder, 9, 0);
+          switch (lcdState->lastPressedButton) {
             case UP:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.add.minute < 59) {
-                lcdState.entryMode.add.minute++;
-                if (lcdState.entryMode.add.minute < 10) {
-                  sprintf(numBuffer, "0%hhu", lcdState.entryMode.add.minute);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.add.minute < 59) {
+                lcdState->entryMode.add.minute++;
+                if (lcdState->entryMode.add.minute < 10) {
+                  sprintf(numBuffer, "0%hhu", lcdState->entryMode.add.minute);
                 }
                 else {
-                  sprintf(numBuffer, "%hhu", lcdState.entryMode.add.minute);
+                  sprintf(numBuffer, "%hhu", lcdState->entryMode.add.minute);
                 }
-                lcd_setCursor_i2c(9, 0);
-                lcd_writeString_i2c(numBuffer);
+                lcd_setCursor_i2c(feeder, 9, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case DOWN:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.add.minute > 0) {
-                lcdState.entryMode.add.minute--;
-                if (lcdState.entryMode.add.minute < 10) {
-                  sprintf(numBuffer, "0%hhu", lcdState.entryMode.add.minute);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.add.minute > 0) {
+                lcdState->entryMode.add.minute--;
+                if (lcdState->entryMode.add.minute < 10) {
+                  sprintf(numBuffer, "0%hhu", lcdState->entryMode.add.minute);
                 }
                 else {
-                  sprintf(numBuffer, "%hhu", lcdState.entryMode.add.minute);
+                  sprintf(numBuffer, "%hhu", lcdState->entryMode.add.minute);
                 }
-                lcd_setCursor_i2c(9, 0);
-                lcd_writeString_i2c(numBuffer);
+                lcd_setCursor_i2c(feeder, 9, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case LEFT:
-              lcdState.lastPressedButton = NONE;
-              lcdState.entryMode.isMinutesEdited = false;
-              lcdState.isUpdateNeeded = true;
+              lcdState->lastPressedButton = NONE;
+              lcdState->entryMode.isMinutesEdited = false;
+              lcdState->isUpdateNeeded = true;
               break;
             case RIGHT:
-              lcdState.lastPressedButton = NONE;
-              lcdState.isUpdateNeeded = true;
+              lcdState->lastPressedButton = NONE;
+              lcdState->isUpdateNeeded = true;
               // Same time already exists in schedule
-              if (isFeedingTimeDuplicate(lcdState.entryMode.add.hour, lcdState.entryMode.add.minute)) {
-                lcd_blinkOff_i2c();
-                lcdState.entryMode.isEntryMode = false;
-                lcdState.entryMode.isMinutesEdited = false;
-                lcdState.entryMode.isPortionsEdited = false;
-                lcdState.entryMode.add.isScheduleAdded = true;
+              if (isFeedingTimeDuplicate(feeder, lcdState->selectedHopper, lcdState->entryMode.add.hour, lcdState->entryMode.add.minute)) {
+                lcd_blinkOff_i2c(feeder);
+                lcdState->entryMode.isEntryMode = false;
+                lcdState->entryMode.isMinutesEdited = false;
+                lcdState->entryMode.isPortionsEdited = false;
+                lcdState->entryMode.add.isScheduleAdded = true;
                 break;
               }
-              lcdState.entryMode.isMinutesEdited = false;
-              lcdState.entryMode.isPortionsEdited = true;
+              lcdState->entryMode.isMinutesEdited = false;
+              lcdState->entryMode.isPortionsEdited = true;
               break;
             default:
               break;
             }
         }
         // Editing portions of feeding
-        else if (!lcdState.entryMode.isMinutesEdited && lcdState.entryMode.isPortionsEdited) {
-          lcd_setCursor_i2c(10, 0);
-          switch (lcdState.lastPressedButton) {
+        else if (!lcdState->entryMode.isMinutesEdited && lcdState->entryMode.isPortionsEdited) {
+          lcd_setCursor_i2c(feeder, 10, 0);
+          switch (lcdState->lastPressedButton) {
             case UP:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.add.portions < 10) {
-                lcdState.entryMode.add.portions++;
-                sprintf(numBuffer, "%hhu", lcdState.entryMode.add.portions);
-                lcd_setCursor_i2c(10, 0);
-                lcd_writeString_i2c(numBuffer);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.add.portions < 10) {
+                lcdState->entryMode.add.portions++;
+                sprintf(numBuffer, "%hhu", lcdState->entryMode.add.portions);
+                lcd_setCursor_i2c(feeder, 10, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case DOWN:
-              lcdState.lastPressedButton = NONE;
-              if (lcdState.entryMode.add.portions > 1) {
-                lcdState.entryMode.add.portions--;
-                sprintf(numBuffer, "%hhu ", lcdState.entryMode.add.portions);
-                lcd_setCursor_i2c(10, 0);
-                lcd_writeString_i2c(numBuffer);
+              lcdState->lastPressedButton = NONE;
+              if (lcdState->entryMode.add.portions > 1) {
+                lcdState->entryMode.add.portions--;
+                sprintf(numBuffer, "%hhu ", lcdState->entryMode.add.portions);
+                lcd_setCursor_i2c(feeder, 10, 0);
+                lcd_writeString_i2c(feeder, numBuffer);
               }
               break;
             case LEFT:
-              lcdState.lastPressedButton = NONE;
-              lcdState.entryMode.isMinutesEdited = true;
-              lcdState.entryMode.isPortionsEdited = false;
-              lcdState.isUpdateNeeded = true;
+              lcdState->lastPressedButton = NONE;
+              lcdState->entryMode.isMinutesEdited = true;
+              lcdState->entryMode.isPortionsEdited = false;
+              lcdState->isUpdateNeeded = true;
               break;
             case RIGHT:
-              lcdState.lastPressedButton = NONE;
-              addFeedingTime(lcdState.entryMode.add.hour, lcdState.entryMode.add.minute, lcdState.entryMode.add.portions);
-              lcdState.entryMode = (lcdEntryModeS){0};
-              lcdState.settingsState = LCD_SETTINGS_SCHEDULE;
-              lcdState.selectedRow = 0;
-              lcdState.selectedFeedSchedule = 0;
-              lcdState.isUpdateNeeded = true;
-              lcd_blinkOff_i2c();
+              lcdState->lastPressedButton = NONE;
+              addFeedingTime(feeder, lcdState->selectedHopper, lcdState->entryMode.add.hour, lcdState->entryMode.add.minute, lcdState->entryMode.add.portions, FEEDING_DEFAULT_MODE);
+              lcdState->entryMode = (lcdEntryModeS){0};
+              lcdState->settingsState = LCD_SETTINGS_SCHEDULE;
+              lcdState->selectedRow = 0;
+              lcdState->selectedFeedSchedule = 0;
+              lcdState->isUpdateNeeded = true;
+              lcd_blinkOff_i2c(feeder);
               break;
             default:
               break;
@@ -779,33 +924,33 @@ void lcdSettingsScreen() {
         }
       }
       else {
-        switch (lcdState.lastPressedButton) {
+        switch (lcdState->lastPressedButton) {
           case UP:
           case DOWN:
             break;
           case LEFT:
-            lcdState.lastPressedButton = NONE;
-            lcdState.settingsState = LCD_SETTINGS_SCHEDULE;
-            lcdState.selectedRow = 0;
-            lcdState.selectedFeedSchedule = 0;
-            lcdState.entryMode = (lcdEntryModeS){0};
-            lcdState.isUpdateNeeded = true;
+            lcdState->lastPressedButton = NONE;
+            lcdState->settingsState = LCD_SETTINGS_SCHEDULE;
+            lcdState->selectedRow = 0;
+            lcdState->selectedFeedSchedule = 0;
+            lcdState->entryMode = (lcdEntryModeS){0};
+            lcdState->isUpdateNeeded = true;
             break;
           case RIGHT:
-            lcdState.lastPressedButton = NONE;
-            if (lcdState.entryMode.add.isScheduleFull) break;
-            if (lcdState.entryMode.add.isScheduleAdded) {
-              lcdState.entryMode.add.isScheduleAdded = false;
-              lcdState.entryMode.add.hour = 0;
-              lcdState.entryMode.add.minute = 0;
-              lcdState.entryMode.add.portions = 1;
-              lcdState.isUpdateNeeded = true;
+            lcdState->lastPressedButton = NONE;
+            if (lcdState->entryMode.add.isScheduleFull) break;
+            if (lcdState->entryMode.add.isScheduleAdded) {
+              lcdState->entryMode.add.isScheduleAdded = false;
+              lcdState->entryMode.add.hour = 0;
+              lcdState->entryMode.add.minute = 0;
+              lcdState->entryMode.add.portions = 1;
+              lcdState->isUpdateNeeded = true;
               break;
             }
-            lcdState.entryMode.isEntryMode = true;
-            lcdState.entryMode.add.hour = 0;
-            lcdState.entryMode.add.minute = 0;
-            lcdState.entryMode.add.portions = 1;
+            lcdState->entryMode.isEntryMode = true;
+            lcdState->entryMode.add.hour = 0;
+            lcdState->entryMode.add.minute = 0;
+            lcdState->entryMode.add.portions = 1;
             break;
           default:
             break;
@@ -814,74 +959,74 @@ void lcdSettingsScreen() {
 
       break;
     case LCD_SETTINGS_WHEEL_EDIT:
-      if (lcdState.isUpdateNeeded) {
+      if (lcdState->isUpdateNeeded) {
         char buffer[8];
-        sprintf(buffer, "Arms: %hhu", getFeedingWheelArms());
+        sprintf(buffer, "Arms: %hhu", getFeedingWheelArms(feeder, lcdState->selectedHopper));
 
-        lcd_clear_i2c();
-        lcd_writeString_i2c(buffer);
-        lcdDrawPointingArrow();
+        lcd_clear_i2c(feeder);
+        lcd_writeString_i2c(feeder, buffer);
+        lcdDrawPointingArrow(feeder);
 
-        lcdState.isUpdateNeeded = false;
+        lcdState->isUpdateNeeded = false;
       }
 
-      if (lcdState.entryMode.isEntryMode) {
-        lcd_blinkOn_i2c();
-        lcd_setCursor_i2c(6, 0);
+      if (lcdState->entryMode.isEntryMode) {
+        lcd_blinkOn_i2c(feeder);
+        lcd_setCursor_i2c(feeder, 6, 0);
         char numBuffer[2];
 
-        switch (lcdState.lastPressedButton) {
+        switch (lcdState->lastPressedButton) {
           case UP:
-            lcdState.lastPressedButton = NONE;
-            if (lcdState.entryMode.currentlySelectedValue < 8) {
-              lcdState.entryMode.currentlySelectedValue += 2;
-              sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue);
-              lcd_setCursor_i2c(6, 0);
-              lcd_writeString_i2c(numBuffer);
+            lcdState->lastPressedButton = NONE;
+            if (lcdState->entryMode.currentlySelectedValue < 8) {
+              lcdState->entryMode.currentlySelectedValue += 2;
+              sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue);
+              lcd_setCursor_i2c(feeder, 6, 0);
+              lcd_writeString_i2c(feeder, numBuffer);
             }
             break;
           case DOWN:
-            lcdState.lastPressedButton = NONE;
-            if (lcdState.entryMode.currentlySelectedValue > 4) {
-              lcdState.entryMode.currentlySelectedValue -= 2;
-              sprintf(numBuffer, "%hhu", lcdState.entryMode.currentlySelectedValue);
-              lcd_setCursor_i2c(6, 0);
-              lcd_writeString_i2c(numBuffer);
+            lcdState->lastPressedButton = NONE;
+            if (lcdState->entryMode.currentlySelectedValue > 4) {
+              lcdState->entryMode.currentlySelectedValue -= 2;
+              sprintf(numBuffer, "%hhu", lcdState->entryMode.currentlySelectedValue);
+              lcd_setCursor_i2c(feeder, 6, 0);
+              lcd_writeString_i2c(feeder, numBuffer);
             }
             break;
           case LEFT:
-            lcdState.lastPressedButton = NONE;
-            lcdState.entryMode.isEntryMode = false;
-            sprintf(numBuffer, "%hhu", lcdState.entryMode.valueBeforeEdit);
-            lcd_setCursor_i2c(6, 0);
-            lcd_writeString_i2c(numBuffer);
-            lcd_blinkOff_i2c();
+            lcdState->lastPressedButton = NONE;
+            lcdState->entryMode.isEntryMode = false;
+            sprintf(numBuffer, "%hhu", lcdState->entryMode.valueBeforeEdit);
+            lcd_setCursor_i2c(feeder, 6, 0);
+            lcd_writeString_i2c(feeder, numBuffer);
+            lcd_blinkOff_i2c(feeder);
             break;
           case RIGHT:
-            lcdState.lastPressedButton = NONE;
-            setFeedingWheelArms(lcdState.entryMode.currentlySelectedValue);
-            lcdState.entryMode.isEntryMode = false;
-            lcd_blinkOff_i2c();
+            lcdState->lastPressedButton = NONE;
+            setFeedingWheelArms(feeder, lcdState->selectedHopper, lcdState->entryMode.currentlySelectedValue);
+            lcdState->entryMode.isEntryMode = false;
+            lcd_blinkOff_i2c(feeder);
             break;
           default:
             break;
         }
       }
       else {
-        switch (lcdState.lastPressedButton) {
+        switch (lcdState->lastPressedButton) {
           case LEFT:
-            lcdState.lastPressedButton = NONE;
-            lcdState.settingsState = LCD_SETTINGS_START;
-            lcdState.selectedRow = 0;
-            lcdState.selectedFeedSchedule = 0;
-            lcdState.entryMode = (lcdEntryModeS){0};
-            lcdState.isUpdateNeeded = true;
+            lcdState->lastPressedButton = NONE;
+            lcdState->settingsState = LCD_SETTINGS_START;
+            lcdState->selectedRow = 0;
+            lcdState->selectedFeedSchedule = 0;
+            lcdState->entryMode = (lcdEntryModeS){0};
+            lcdState->isUpdateNeeded = true;
             break;
           case RIGHT:
-            lcdState.lastPressedButton = NONE;
-            lcdState.entryMode.valueBeforeEdit = getFeedingWheelArms();
-            lcdState.entryMode.currentlySelectedValue = lcdState.entryMode.valueBeforeEdit;
-            lcdState.entryMode.isEntryMode = true;
+            lcdState->lastPressedButton = NONE;
+            lcdState->entryMode.valueBeforeEdit = getFeedingWheelArms(feeder, lcdState->selectedHopper);
+            lcdState->entryMode.currentlySelectedValue = lcdState->entryMode.valueBeforeEdit;
+            lcdState->entryMode.isEntryMode = true;
             break;
           default:
             break;
@@ -897,10 +1042,13 @@ void lcdSettingsScreen() {
 *
 * @brief Processes the button press and updates the last pressed button and the
 *        time of the press
+*
+* @param[in] feeder The feeder
 *******************************************************************************/
-void processButtonPress(lcdButtonsE button) {
-  lcdState.lastPressedButton = button;
-  lcdState.lastButtonPressTime = millis();
+void processButtonPress(feederS *feeder, lcdButtonsE button) {
+  lcdStateMachineS *lcdState = &feeder->lcdState;
+  lcdState->lastPressedButton = button;
+  lcdState->lastButtonPressTime = getFeederMillis(feeder);
 }
 
 /*******************************************************************************
@@ -908,15 +1056,18 @@ void processButtonPress(lcdButtonsE button) {
 *
 * @brief Prints the pointing arrow on the last position in the row to indicate
 *        the row selected by the user
+*
+* @param[in] feeder The feeder
 *******************************************************************************/
-void lcdDrawPointingArrow() {
-  switch (lcdState.selectedRow) {
+void lcdDrawPointingArrow(feederS *feeder) {
+  lcdStateMachineS *lcdState = &feeder->lcdState;
+  switch (lcdState->selectedRow) {
     case 0:
-      lcd_removeChar_i2c(15, 1);
+      lcd_removeChar_i2c(feeder, 15, 1);
     case 1:
-      lcd_removeChar_i2c(15, 0);
+      lcd_removeChar_i2c(feeder, 15, 0);
   }
 
-  lcd_setCursor_i2c(15, lcdState.selectedRow);
-  lcd_writeString_i2c("<");
+  lcd_setCursor_i2c(feeder, 15, lcdState->selectedRow);
+  lcd_writeString_i2c(feeder, "<");
 }
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "dispenser.h"
+
+typedef struct feederS feederS; // Defined in context.h
 
 /* Enum definitions */
 typedef enum {
@@ -16,10 +19,12 @@ typedef enum {
 typedef enum {
   LCD_WELCOME,
   LCD_IDLE,
-  LCD_SETTINGS
+  LCD_SETTINGS,
+  LCD_DISPENSING
 } lcdStateE;
 
 typedef enum {
+  LCD_SETTINGS_HOPPER,
   LCD_SETTINGS_START,
   LCD_SETTINGS_SCHEDULE,
   LCD_SETTINGS_SCHEDULE_ENTRY_OPTIONS,
@@ -56,15 +61,19 @@ typedef struct lcdStateMachineS {
   lcdButtonsE lastPressedButton; // last button that was pressed
   bool isUpdateNeeded; // whether or not screen needs to be updated
   bool selectedRow; // row which user is currently selecting
-  uint8_t selectedFeedSchedule; // schedule which user is currently selecting
+  uint16_t selectedFeedSchedule; // schedule which user is currently selecting
+  uint8_t selectedHopper; // hopper whose schedule and wheel are shown in settings
   lcdEntryModeS entryMode; // parameters for entry mode
+  dispenseProgressS dispenseProgress; // dispense progress shown on the screen
+  uint8_t dispenseHopper; // hopper whose dispense progress is shown on the screen
 } lcdStateMachineS;
 
-void handleLCD();
-void lcdWelcomeScreen();
-void lcdIdleScreen();
-void lcdSettingsScreen();
-void processButtonPress(lcdButtonsE button);
-void lcdDrawPointingArrow();
+void handleLCD(feederS *feeder);
+void lcdWelcomeScreen(feederS *feeder);
+void lcdIdleScreen(feederS *feeder);
+void lcdSettingsScreen(feederS *feeder);
+void lcdDispenseScreen(feederS *feeder);
+void processButtonPress(feederS *feeder, lcdButtonsE button);
+void lcdDrawPointingArrow(feederS *feeder);
 
 #endif // lcd_utils_h
@@ -3,6 +3,11 @@
 #include <stdint.h>
 #include "logger.h"
 #include <string.h>
+#include <pthread.h>
+#include "metrics.h"
+#include "tools.h"
+#include "clock.h"
+#include "context.h"
 
 const char* loggerEventStrings[] = {
   "INFO",
@@ -10,28 +15,32 @@ const char* loggerEventStrings[] = {
   "ERROR"
 };
 
-char loggerFileName[25] = {0};
-
 /*******************************************************************************
 * initLogger
 *
-* @brief Initializes the logger file
+* @brief Initializes the logger file of a feeder in its directory
+*
+* @param[in] feeder The feeder
 *
 * @return 0 on success, -1 on failure
 *******************************************************************************/
-int8_t initLogger() {
-  time_t rawTime;
-  struct tm* timeInfo;
+int8_t initLogger(feederS *feeder) {
+  loggerS *logger = &feeder->logger;
+  time_t rawTime = getFeederTime(feeder);
+  struct tm timeInfo;
   char buffer[14];
+  char fileName[26];
 
-  time(&rawTime);
-  timeInfo = localtime(&rawTime);
+  getFeederLocalTime(feeder, rawTime, &timeInfo);
 
-  strftime(buffer, sizeof(buffer), "%d%m%y_%H%M%S", timeInfo);
+  strftime(buffer, sizeof(buffer), "%d%m%y_%H%M%S", &timeInfo);
 
-  sprintf(loggerFileName, "logger_%s.log", buffer);
+  sprintf(fileName, "logger_%s.log", buffer);
+  getHopperFileName(logger->fileName, sizeof(logger->fileName), feeder->directory, fileName, 0);
+  pthread_mutex_init(&logger->mutex, NULL);
+  logger->isEchoed = true;
 
-  FILE *fp = fopen(loggerFileName, "ab+");
+  FILE *fp = fopen(logger->fileName, "ab+");
   if (fp == NULL) {
     return -1;
   }
@@ -44,28 +53,36 @@ int8_t initLogger() {
 /*******************************************************************************
 * logMessage
 *
-* @brief Logs a message to the logger file
+* @brief Logs a message to the logger file of a feeder
 *
+* @param[in] feeder The feeder
 * @param[in] type The type of message to be logged
 * @param[in] message The message to be logged
 *******************************************************************************/
-void logMessage(loggerEventType type, char *message) {
-  time_t rawTime;
-  struct tm* timeInfo;
+void logMessage(feederS *feeder, loggerEventType type, char *message) {
+  loggerS *logger = &feeder->logger;
+  time_t rawTime = getFeederTime(feeder);
+  struct tm timeInfo;
   char buffer[22];
 
-  time(&rawTime);
-  timeInfo = localtime(&rawTime);
+  getFeederLocalTime(feeder, rawTime, &timeInfo);
+
+  strftime(buffer, sizeof(buffer), "%d.%m.%Y - %H:%M:%S", &timeInfo);
 
-  strftime(buffer, sizeof(buffer), "%d.%m.%Y - %H:%M:%S", timeInfo);
+  pthread_mutex_lock(&logger->mutex);
 
-  FILE *fp = fopen(loggerFileName, "a");
+  FILE *fp = fopen(logger->fileName, "a");
   if (fp == NULL) {
-    fprintf(stderr, "Error during logging: %s", strerror(errno));
+    fprintf(stderr, "Error during logging: %s\n", strerror(errno));
+  }
+  else {
+    fprintf(fp, "(%s) [%s] %s\n", buffer, loggerEventStrings[type], message);
+    fclose(fp);
   }
 
-  fprintf(fp, "(%s) [%s] %s\n", buffer, loggerEventStrings[type], message);
-  fprintf(stderr, "(%s) [%s] %s\n", buffer, loggerEventStrings[type], message);
+  if (logger->isEchoed) fprintf(stderr, "(%s) [%s] %s\n", buffer, loggerEventStrings[type], message);
 
-  fclose(fp);
+  pthread_mutex_unlock(&logger->mutex);
+
+  metricsIncrement(feeder, METRIC_LOG_LINES);
 }
\ No newline at end of file
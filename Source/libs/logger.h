@@ -3,17 +3,30 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
 #include <errno.h>
+#include <pthread.h>
+#include "../config.h"
 
 extern int errno;
 
+typedef struct feederS feederS; // Defined in context.h
+
 typedef enum {
   INFO,
   WARNING,
   ERROR
 } loggerEventType;
 
-int8_t initLogger();
-void logMessage(loggerEventType type, char *message);
+typedef struct loggerS {
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+  // Messages are logged from the main loop, the dispenser workers and the
+  // watchdog supervisor thread
+  pthread_mutex_t mutex;
+  bool isEchoed; // Whether or not messages are also written to stderr
+} loggerS;
+
+int8_t initLogger(feederS *feeder);
+void logMessage(feederS *feeder, loggerEventType type, char *message);
 
-#endif // logger_h
\ No newline at end of file
+#endif // logger_h
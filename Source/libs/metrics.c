@@ -0,0 +1,301 @@
+#include "metrics.h"
+#include <stdio.h>
+#include <stdbool.h>
+#include <string.h>
+#include <wiringPi.h>
+#include "../config.h"
+#include "logger.h"
+#include "tools.h"
+#include "context.h"
+
+const char* metricCounterNames[] = {
+  "feeder_i2c_bytes_written_total",
+  "feeder_log_lines_total",
+  "feeder_watchdog_breaches_total"
+};
+
+const char* metricCounterHelps[] = {
+  "Bytes written to the LCD over I2C",
+  "Lines written by the logger",
+  "Loop or move latency budgets breached"
+};
+
+const char* metricHopperCounterNames[] = {
+  "feeder_feeds_done_total",
+  "feeder_feeds_missed_total",
+  "feeder_feeds_late_total",
+  "feeder_feeds_merged_total",
+  "feeder_feeds_failed_total",
+  "feeder_portions_dispensed_total",
+  "feeder_dispense_jobs_coalesced_total",
+  "feeder_dispense_jobs_cancelled_total",
+  "feeder_motor_jams_total",
+  "feeder_motor_faults_total",
+  "feeder_pid_iterations_total",
+  "feeder_encoder_edges_total",
+  "feeder_encoder_illegal_transitions_total",
+  "feeder_encoder_samples_total",
+  "feeder_encoder_mode_switches_total",
+  "feeder_control_loop_overruns_total",
+  "feeder_feed_sla_breaches_total"
+};
+
+const char* metricHopperCounterHelps[] = {
+  "Scheduled feedings completed",
+  "Scheduled feedings missed during a main loop stall or a restart or dropped by a full queue and skipped",
+  "Missed scheduled feedings fed late",
+  "Missed scheduled feedings merged into a single catch-up feed",
+  "Scheduled feedings which dispensed fewer portions than due",
+  "Portions dispensed by schedule and treat button",
+  "Dispense requests added to a waiting job",
+  "Cancellations of the running and waiting dispense jobs",
+  "Jams detected while rotating the motor",
+  "Moves given up because a jam could not be cleared",
+  "Iterations of the motor control loop",
+  "Edges seen by the encoder ISRs and the polling thread",
+  "Encoder transitions which skipped a state",
+  "Encoder reads of the polling thread",
+  "Switches between encoder edge interrupts and polling",
+  "Control loop periods which missed their deadline",
+  "Scheduled feedings whose motor started later than the budget"
+};
+
+const metricHistogramS metricHistograms[METRIC_HISTOGRAMS_COUNT] = {
+  [METRIC_MOTOR_SETTLE_TIME] = {
+    "feeder_motor_settle_time_ms", "Time until a motor move settles within tolerance in milliseconds",
+    10, {100, 200, 300, 500, 750, 1000, 1500, 2000, 3000, 5000}
+  },
+  [METRIC_MOTOR_OVERSHOOT] = {
+    "feeder_motor_overshoot_ticks", "Largest excursion past the target during a move in encoder ticks",
+    9, {0, 2, 5, 10, 20, 50, 100, 200, 500}
+  },
+  [METRIC_MOTOR_MOVE_DELAY] = {
+    "feeder_motor_move_delay_ms", "Settle time of a motor move above its planned time in milliseconds",
+    9, {5, 10, 20, 50, 100, 200, 500, 1000, 2000}
+  },
+  [METRIC_CONTROL_LOOP_JITTER] = {
+    "feeder_control_loop_jitter_us", "Wake-up delay of the motor control loop after its deadline in microseconds",
+    10, {10, 20, 50, 100, 200, 500, 1000, 2000, 5000, 10000}
+  },
+  [METRIC_ENCODER_EDGE_RATE] = {
+    "feeder_encoder_edges_per_second", "Average encoder edges per second during a move",
+    8, {500, 1000, 2000, 3000, 4000, 5000, 7500, 10000}
+  },
+  [METRIC_LOOP_ITERATION_TIME] = {
+    "feeder_loop_iteration_time_us", "Main loop iteration time without sleep in microseconds",
+    10, {50, 100, 250, 500, 1000, 2500, 5000, 10000, 100000, 1000000}
+  },
+  [METRIC_MOTOR_PEAK_VELOCITY] = {
+    "feeder_motor_peak_velocity_degrees_per_second", "Highest estimated wheel velocity during a move in degrees per second",
+    9, {50, 100, 200, 300, 400, 500, 600, 700, 800}
+  },
+  [METRIC_FEED_LATENESS] = {
+    "feeder_feed_lateness_seconds", "Delay of missed feedings which were fed late or merged in seconds",
+    9, {60, 120, 300, 600, 900, 1800, 3600, 7200, 14400}
+  }
+};
+
+/*******************************************************************************
+* metricsIncrement
+*
+* @brief Increments a counter by one. Safe to call from ISRs and threads
+*
+* @param[in] feeder The feeder
+* @param[in] counter The counter to increment
+*******************************************************************************/
+void metricsIncrement(feederS *feeder, metricCounterE counter) {
+  atomic_fetch_add_explicit(&feeder->metrics.counters[counter], 1, memory_order_relaxed);
+}
+
+/*******************************************************************************
+* metricsAdd
+*
+* @brief Adds a value to a counter. Safe to call from ISRs and threads
+*
+* @param[in] feeder The feeder
+* @param[in] counter The counter to add to
+* @param[in] value The value to add
+*******************************************************************************/
+void metricsAdd(feederS *feeder, metricCounterE counter, uint64_t value) {
+  atomic_fetch_add_explicit(&feeder->metrics.counters[counter], value, memory_order_relaxed);
+}
+
+/*******************************************************************************
+* metricsObserve
+*
+* @brief Records a value in a histogram. Safe to call from ISRs and threads
+*
+* @param[in] feeder The feeder
+* @param[in] histogram The histogram to record the value in
+* @param[in] value The observed value
+*******************************************************************************/
+void metricsObserve(feederS *feeder, metricHistogramE histogram, uint32_t value) {
+  const metricHistogramS *h = &metricHistograms[histogram];
+  metricHistogramCountsS *counts = &feeder->metrics.histograms[histogram];
+  uint8_t bucket = 0;
+
+  while (bucket < h->bucketsCount && value > h->upperBounds[bucket]) {
+    bucket++;
+  }
+
+  atomic_fetch_add_explicit(&counts->buckets[bucket], 1, memory_order_relaxed);
+  atomic_fetch_add_explicit(&counts->sum, value, memory_order_relaxed);
+}
+
+/*******************************************************************************
+* metricsGetCounter
+*
+* @brief Returns the current value of a counter
+*
+* @param[in] feeder The feeder
+* @param[in] counter The counter to read
+*
+* @return The current value of the counter
+*******************************************************************************/
+uint64_t metricsGetCounter(feederS *feeder, metricCounterE counter) {
+  return atomic_load_explicit(&feeder->metrics.counters[counter], memory_order_relaxed);
+}
+
+/*******************************************************************************
+* metricsHopperIncrement
+*
+* @brief Increments a counter of a hopper by one. Safe to call from ISRs and
+*        threads
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] counter The counter to increment
+*******************************************************************************/
+void metricsHopperIncrement(feederS *feeder, uint8_t hopper, metricHopperCounterE counter) {
+  atomic_fetch_add_explicit(&feeder->metrics.hopperCounters[hopper][counter], 1, memory_order_relaxed);
+}
+
+/*******************************************************************************
+* metricsHopperAdd
+*
+* @brief Adds a value to a counter of a hopper. Safe to call from ISRs and
+*        threads
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] counter The counter to add to
+* @param[in] value The value to add
+*******************************************************************************/
+void metricsHopperAdd(feederS *feeder, uint8_t hopper, metricHopperCounterE counter, uint64_t value) {
+  atomic_fetch_add_explicit(&feeder->metrics.hopperCounters[hopper][counter], value, memory_order_relaxed);
+}
+
+/*******************************************************************************
+* metricsGetHopperCounter
+*
+* @brief Returns the current value of a counter of a hopper
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] counter The counter to read
+*
+* @return The current value of the counter
+*******************************************************************************/
+uint64_t metricsGetHopperCounter(feederS *feeder, uint8_t hopper, metricHopperCounterE counter) {
+  return atomic_load_explicit(&feeder->metrics.hopperCounters[hopper][counter], memory_order_relaxed);
+}
+
+/*******************************************************************************
+* exportMetrics
+*
+* @brief Writes all counters and histograms of a feeder in Prometheus text
+*        format to the metrics file in its directory, the counters of the
+*        hoppers with a hopper label. The histograms are shared by the hoppers.
+*        The file is replaced atomically so a scraper never sees a partially
+*        written file
+*
+* @param[in] feeder The feeder
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t exportMetrics(feederS *feeder) {
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+  char tmpFileName[FEEDER_FILE_NAME_LENGTH + 4];
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, METRICS_FILE, 0);
+  sprintf(tmpFileName, "%s.tmp", fileName);
+
+  FILE *fp = fopen(tmpFileName, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+
+  for (uint8_t i = 0; i < METRIC_COUNTERS_COUNT; i++) {
+    fprintf(fp, "# HELP %s %s\n", metricCounterNames[i], metricCounterHelps[i]);
+    fprintf(fp, "# TYPE %s counter\n", metricCounterNames[i]);
+    fprintf(fp, "%s %llu\n", metricCounterNames[i], (unsigned long long)metricsGetCounter(feeder, i));
+  }
+
+  for (uint8_t i = 0; i < METRIC_HOPPER_COUNTERS_COUNT; i++) {
+    fprintf(fp, "# HELP %s %s\n", metricHopperCounterNames[i], metricHopperCounterHelps[i]);
+    fprintf(fp, "# TYPE %s counter\n", metricHopperCounterNames[i]);
+    for (uint8_t hopper = 0; hopper < HOPPERS_COUNT; hopper++) {
+      fprintf(fp, "%s{hopper=\"%hhu\"} %llu\n", metricHopperCounterNames[i], hopper + 1,
+        (unsigned long long)metricsGetHopperCounter(feeder, hopper, i));
+    }
+  }
+
+  for (uint8_t i = 0; i < METRIC_HISTOGRAMS_COUNT; i++) {
+    const metricHistogramS *h = &metricHistograms[i];
+    metricHistogramCountsS *counts = &feeder->metrics.histograms[i];
+    uint64_t cumulative = 0;
+
+    fprintf(fp, "# HELP %s %s\n", h->name, h->help);
+    fprintf(fp, "# TYPE %s histogram\n", h->name);
+
+    for (uint8_t bucket = 0; bucket < h->bucketsCount; bucket++) {
+      cumulative += atomic_load_explicit(&counts->buckets[bucket], memory_order_relaxed);
+      fprintf(fp, "%s_bucket{le=\"%u\"} %llu\n", h->name, h->upperBounds[bucket], (unsigned long long)cumulative);
+    }
+
+    cumulative += atomic_load_explicit(&counts->buckets[h->bucketsCount], memory_order_relaxed);
+    fprintf(fp, "%s_bucket{le=\"+Inf\"} %llu\n", h->name, (unsigned long long)cumulative);
+    fprintf(fp, "%s_sum %llu\n", h->name, (unsigned long long)atomic_load_explicit(&counts->sum, memory_order_relaxed));
+    // Count is derived from the buckets so it always matches the +Inf bucket
+    fprintf(fp, "%s_count %llu\n", h->name, (unsigned long long)cumulative);
+  }
+
+  exportFeedingSla(feeder, fp);
+
+  if (fclose(fp) != 0) {
+    return -1;
+  }
+
+  if (rename(tmpFileName, fileName) != 0) {
+    return -1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* handleMetrics
+*
+* @brief Periodically exports the metrics file of a feeder
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void handleMetrics(feederS *feeder) {
+  metricsS *metrics = &feeder->metrics;
+  uint32_t currentTime = getFeederMillis(feeder);
+
+  if (currentTime - metrics->lastExport < METRICS_EXPORT_INTERVAL) return;
+  metrics->lastExport = currentTime;
+
+  if (exportMetrics(feeder) != 0) {
+    // Log only the first failure to avoid flooding the log file
+    if (!metrics->isExportFailing) {
+      char logMessageBuffer[120];
+      sprintf(logMessageBuffer, "Error during metrics export: %s", strerror(errno));
+      logMessage(feeder, ERROR, logMessageBuffer);
+      metrics->isExportFailing = true;
+    }
+  }
+  else {
+    metrics->isExportFailing = false;
+  }
+}
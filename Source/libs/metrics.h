@@ -0,0 +1,85 @@
+#ifndef metrics_h
+#define metrics_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "../config.h"
+
+typedef struct feederS feederS; // Defined in context.h
+
+typedef enum {
+  METRIC_I2C_BYTES_WRITTEN, // Bytes written to the LCD over I2C
+  METRIC_LOG_LINES, // Lines written by the logger
+  METRIC_WATCHDOG_BREACHES, // Latency budgets breached
+  METRIC_COUNTERS_COUNT
+} metricCounterE;
+
+// Counters kept for every hopper, exported with a hopper label
+typedef enum {
+  METRIC_FEEDS_DONE, // Scheduled feedings completed
+  METRIC_FEEDS_MISSED, // Scheduled feedings missed during a stall or a restart or dropped by a full queue and skipped
+  METRIC_FEEDS_LATE, // Missed feedings fed late
+  METRIC_FEEDS_MERGED, // Missed feedings merged into a single catch-up feed
+  METRIC_FEEDS_FAILED, // Scheduled feedings which dispensed fewer portions than due
+  METRIC_PORTIONS_DISPENSED, // Portions dispensed by schedule and treat button
+  METRIC_DISPENSE_JOBS_COALESCED, // Dispense requests added to a waiting job
+  METRIC_DISPENSE_JOBS_CANCELLED, // Cancellations of the running and waiting dispense jobs
+  METRIC_MOTOR_JAMS, // Jams detected while rotating the motor
+  METRIC_MOTOR_FAULTS, // Moves given up because a jam could not be cleared
+  METRIC_PID_ITERATIONS, // Iterations of the motor control loop
+  METRIC_ENCODER_EDGES, // Edges seen by the encoder ISRs and the polling thread
+  METRIC_ENCODER_ILLEGAL_TRANSITIONS, // Encoder transitions which skipped a state
+  METRIC_ENCODER_SAMPLES, // Encoder reads of the polling thread
+  METRIC_ENCODER_MODE_SWITCHES, // Switches between edge interrupts and polling
+  METRIC_CONTROL_LOOP_OVERRUNS, // Control loop periods which missed their deadline
+  METRIC_FEED_SLA_BREACHES, // Scheduled feedings whose motor started later than FEEDING_SLA_START_BUDGET
+  METRIC_HOPPER_COUNTERS_COUNT
+} metricHopperCounterE;
+
+typedef enum {
+  METRIC_MOTOR_SETTLE_TIME, // Time until a move settles within tolerance [ms]
+  METRIC_MOTOR_OVERSHOOT, // Largest excursion past the target during a move [ticks]
+  METRIC_MOTOR_MOVE_DELAY, // Settle time of a move above its planned time [ms]
+  METRIC_CONTROL_LOOP_JITTER, // Wake-up delay of the control loop after its deadline [us]
+  METRIC_ENCODER_EDGE_RATE, // Average encoder edges per second during a move
+  METRIC_LOOP_ITERATION_TIME, // Main loop iteration time without sleep [us]
+  METRIC_MOTOR_PEAK_VELOCITY, // Highest estimated velocity during a move [deg/s]
+  METRIC_FEED_LATENESS, // Delay of caught up feedings [s]
+  METRIC_HISTOGRAMS_COUNT
+} metricHistogramE;
+
+#define METRIC_HISTOGRAM_MAX_BUCKETS 12
+
+typedef struct metricHistogramS {
+  const char *name; // Exported metric name
+  const char *help; // Exported metric description
+  uint8_t bucketsCount; // Number of used upper bounds
+  uint32_t upperBounds[METRIC_HISTOGRAM_MAX_BUCKETS]; // Inclusive upper bounds of the buckets
+} metricHistogramS;
+
+typedef struct metricHistogramCountsS {
+  atomic_uint_fast64_t buckets[METRIC_HISTOGRAM_MAX_BUCKETS + 1]; // Last bucket is +Inf
+  atomic_uint_fast64_t sum; // Sum of all observed values
+} metricHistogramCountsS;
+
+// Metrics of a feeder, exported to the metrics file in its directory
+typedef struct metricsS {
+  atomic_uint_fast64_t counters[METRIC_COUNTERS_COUNT];
+  atomic_uint_fast64_t hopperCounters[HOPPERS_COUNT][METRIC_HOPPER_COUNTERS_COUNT];
+  metricHistogramCountsS histograms[METRIC_HISTOGRAMS_COUNT];
+  uint32_t lastExport; // Time of the last export [ms]
+  bool isExportFailing;
+} metricsS;
+
+void metricsIncrement(feederS *feeder, metricCounterE counter);
+void metricsAdd(feederS *feeder, metricCounterE counter, uint64_t value);
+void metricsObserve(feederS *feeder, metricHistogramE histogram, uint32_t value);
+uint64_t metricsGetCounter(feederS *feeder, metricCounterE counter);
+void metricsHopperIncrement(feederS *feeder, uint8_t hopper, metricHopperCounterE counter);
+void metricsHopperAdd(feederS *feeder, uint8_t hopper, metricHopperCounterE counter, uint64_t value);
+uint64_t metricsGetHopperCounter(feederS *feeder, uint8_t hopper, metricHopperCounterE counter);
+int8_t exportMetrics(feederS *feeder);
+void handleMetrics(feederS *feeder);
+
+#endif // metrics_h
@@ -0,0 +1,173 @@
+#include "motion.h"
+#include <math.h>
+
+/*******************************************************************************
+* planMotion
+*
+* @brief Plans a velocity, acceleration and optionally jerk limited move. The
+*        profile is symmetric, the acceleration phase ramps the acceleration up
+*        and down with the given jerk. Limits which can't be reached over the
+*        distance are lowered. A jerk of 0 gives a trapezoidal profile
+*
+* @param[out] profile The planned profile
+* @param[in] distance Signed distance of the move
+* @param[in] maxVelocity Velocity limit, in distance units per second
+* @param[in] maxAcceleration Acceleration limit
+* @param[in] maxJerk Jerk limit, 0 to disable
+*******************************************************************************/
+void planMotion(motionProfileS *profile, float distance, float maxVelocity, float maxAcceleration, float maxJerk) {
+  float d = fabsf(distance);
+  float v = maxVelocity;
+  float a = maxAcceleration;
+  float tj = maxJerk > 0 ? a / maxJerk : 0;
+
+  profile->direction = distance >= 0 ? 1 : -1;
+  profile->distance = d;
+  profile->jerk = maxJerk > 0 ? maxJerk : 0;
+
+  if (d == 0) {
+    *profile = (motionProfileS){0};
+    profile->direction = 1;
+    return;
+  }
+
+  // Velocity limit is reached before the acceleration limit
+  if (maxJerk > 0 && v < a * tj) {
+    a = sqrtf(v * maxJerk);
+    tj = a / maxJerk;
+  }
+
+  // Acceleration and deceleration phases alone are longer than the distance
+  if (v * (v / a + tj) > d) {
+    v = (-a * tj + sqrtf(a * tj * a * tj + 4 * a * d)) / 2;
+
+    // Acceleration limit isn't reached either, the profile is all ramps
+    if (maxJerk > 0 && v < a * tj) {
+      tj = cbrtf(d / (2 * maxJerk));
+      a = maxJerk * tj;
+      v = maxJerk * tj * tj;
+    }
+  }
+
+  profile->velocity = v;
+  profile->acceleration = a;
+  profile->jerkTime = tj;
+  profile->accelerationTime = v / a + tj;
+  profile->cruiseTime = (d - v * profile->accelerationTime) / v;
+  if (profile->cruiseTime < 0) profile->cruiseTime = 0;
+  profile->totalTime = 2 * profile->accelerationTime + profile->cruiseTime;
+}
+
+/*******************************************************************************
+* accelerationPhasePosition
+*
+* @brief Position during the acceleration phase
+*
+* @param[in] profile The planned profile
+* @param[in] t Time since the start of the move, 0 - accelerationTime [s]
+*
+* @return The unsigned position
+*******************************************************************************/
+float accelerationPhasePosition(const motionProfileS *profile, float t) {
+  float tj = profile->jerkTime;
+  float ta = profile->accelerationTime;
+  float v = profile->velocity;
+
+  // Acceleration ramps up
+  if (t < tj) {
+    return profile->jerk * t * t * t / 6;
+  }
+
+  // Constant acceleration
+  if (t <= ta - tj) {
+    float tau = t - tj;
+    return profile->jerk * tj * tj * tj / 6 + profile->jerk * tj * tj / 2 * tau + profile->acceleration * tau * tau / 2;
+  }
+
+  // Acceleration ramps down, mirror of the ramp up
+  float mirrored = ta - t;
+  return v * t - v * ta / 2 + profile->jerk * mirrored * mirrored * mirrored / 6;
+}
+
+/*******************************************************************************
+* accelerationPhaseVelocity
+*
+* @brief Velocity during the acceleration phase
+*
+* @param[in] profile The planned profile
+* @param[in] t Time since the start of the move, 0 - accelerationTime [s]
+*
+* @return The unsigned velocity
+*******************************************************************************/
+float accelerationPhaseVelocity(const motionProfileS *profile, float t) {
+  float tj = profile->jerkTime;
+  float ta = profile->accelerationTime;
+
+  // Acceleration ramps up
+  if (t < tj) {
+    return profile->jerk * t * t / 2;
+  }
+
+  // Constant acceleration
+  if (t <= ta - tj) {
+    return profile->jerk * tj * tj / 2 + profile->acceleration * (t - tj);
+  }
+
+  // Acceleration ramps down, mirror of the ramp up
+  float mirrored = ta - t;
+  return profile->velocity - profile->jerk * mirrored * mirrored / 2;
+}
+
+/*******************************************************************************
+* motionPosition
+*
+* @brief Returns the reference position of the planned move at a given time
+*
+* @param[in] profile The planned profile
+* @param[in] t Time since the start of the move [s]
+*
+* @return The signed reference position
+*******************************************************************************/
+float motionPosition(const motionProfileS *profile, float t) {
+  float position;
+
+  if (t <= 0) {
+    position = 0;
+  } else if (t >= profile->totalTime) {
+    position = profile->distance;
+  } else if (t < profile->accelerationTime) {
+    position = accelerationPhasePosition(profile, t);
+  } else if (t <= profile->accelerationTime + profile->cruiseTime) {
+    position = profile->velocity * profile->accelerationTime / 2 + profile->velocity * (t - profile->accelerationTime);
+  } else {
+    position = profile->distance - accelerationPhasePosition(profile, profile->totalTime - t);
+  }
+
+  return profile->direction * position;
+}
+
+/*******************************************************************************
+* motionVelocity
+*
+* @brief Returns the reference velocity of the planned move at a given time
+*
+* @param[in] profile The planned profile
+* @param[in] t Time since the start of the move [s]
+*
+* @return The signed reference velocity, in distance units per second
+*******************************************************************************/
+float motionVelocity(const motionProfileS *profile, float t) {
+  float velocity;
+
+  if (t <= 0 || t >= profile->totalTime) {
+    velocity = 0;
+  } else if (t < profile->accelerationTime) {
+    velocity = accelerationPhaseVelocity(profile, t);
+  } else if (t <= profile->accelerationTime + profile->cruiseTime) {
+    velocity = profile->velocity;
+  } else {
+    velocity = accelerationPhaseVelocity(profile, profile->totalTime - t);
+  }
+
+  return profile->direction * velocity;
+}
@@ -0,0 +1,29 @@
+#ifndef motion_h
+#define motion_h
+
+#include <stdint.h>
+
+typedef struct motionLimitsS {
+  uint8_t wheelArms; // Wheel configuration the limits apply to
+  float maxVelocity; // [deg/s]
+  float maxAcceleration; // [deg/s^2]
+  float maxJerk; // [deg/s^3], 0 for a trapezoidal profile
+} motionLimitsS;
+
+typedef struct motionProfileS {
+  float distance; // Absolute distance of the move
+  int8_t direction; // 1 or -1
+  float velocity; // Reached cruise velocity
+  float acceleration; // Reached acceleration
+  float jerk; // Jerk of the acceleration ramps, 0 if not limited
+  float jerkTime; // Duration of a single acceleration ramp [s]
+  float accelerationTime; // Duration of the acceleration phase [s]
+  float cruiseTime; // Duration of the constant velocity phase [s]
+  float totalTime; // Duration of the whole move [s]
+} motionProfileS;
+
+void planMotion(motionProfileS *profile, float distance, float maxVelocity, float maxAcceleration, float maxJerk);
+float motionPosition(const motionProfileS *profile, float t);
+float motionVelocity(const motionProfileS *profile, float t);
+
+#endif // motion_h
@@ -2,189 +2,1486 @@
 #include <stdint.h>
 #include <stdio.h>
 #include <wiringPi.h>
+#include <softPwm.h>
 #include "../config.h"
 #include "tools.h"
 #include "logger.h"
+#include "metrics.h"
+#include "watchdog.h"
+#include "pid.h"
+#include "motion.h"
+#include "feeding.h"
+#include "trace.h"
+#include "encoder.h"
+#include "context.h"
+#include "clock.h"
 #include <stdbool.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <stdatomic.h>
 
-volatile int32_t encoderPosition = 0;
-uint32_t prevTime = 0;
-float prevError = 0;
-float integralError = 0;
+// Position step for every transition, indexed by (previous AB << 2) | current AB.
+// Forward sequence is 00 -> 10 -> 11 -> 01 -> 00
+#define QUADRATURE_ILLEGAL 2
+const int8_t quadratureTable[16] = {
+   0, -1,  1,  QUADRATURE_ILLEGAL,
+   1,  0,  QUADRATURE_ILLEGAL, -1,
+  -1,  QUADRATURE_ILLEGAL,  0,  1,
+   QUADRATURE_ILLEGAL,  1, -1,  0
+};
+
+const char* motorBrakeModeStrings[] = {
+  "coast",
+  "full",
+  "proportional"
+};
+
+const char* motorDirectionStrings[] = {
+  "forward",
+  "reverse"
+};
+
+// Pins of the motors on both channels of the MDD3A
+const motorPinsS motorPins[HOPPERS_MAX] = {
+  {MOTOR_M1A, MOTOR_M1B, MOTOR_ENCODER_A, MOTOR_ENCODER_B, MOTOR_INDEX_PIN, false},
+  {MOTOR_M2A, MOTOR_M2B, MOTOR2_ENCODER_A, MOTOR2_ENCODER_B, MOTOR2_INDEX_PIN, true}
+};
+
+// WiringPi ISRs take no arguments, so every motor has its own
+void (*const motorEncoderISRs[HOPPERS_MAX])(void) = {
+  encoder1ISR,
+  encoder2ISR
+};
+
+// Configuration of every motor until its configuration file is loaded
+const motorConfigS motorDefaultConfig = {
+  {
+    {4, MOTOR_PID_KP, MOTOR_PID_KI, MOTOR_PID_KD},
+    {6, MOTOR_PID_KP, MOTOR_PID_KI, MOTOR_PID_KD},
+    {8, MOTOR_PID_KP, MOTOR_PID_KI, MOTOR_PID_KD}
+  },
+  MOTOR_CONTROL_RATE,
+  MOTOR_BRAKE_DEFAULT_MODE,
+  MOTOR_ENCODER_TICKS_PER_DEGREE * 360,
+  {
+    {MOTOR_FRICTION_BREAK_AWAY, MOTOR_FRICTION_COULOMB},
+    {MOTOR_FRICTION_BREAK_AWAY, MOTOR_FRICTION_COULOMB}
+  },
+  {
+    {4, MOTION_MAX_VELOCITY_4_ARMS, MOTION_MAX_ACCELERATION_4_ARMS, MOTION_MAX_JERK_4_ARMS},
+    {6, MOTION_MAX_VELOCITY_6_ARMS, MOTION_MAX_ACCELERATION_6_ARMS, MOTION_MAX_JERK_6_ARMS},
+    {8, MOTION_MAX_VELOCITY_8_ARMS, MOTION_MAX_ACCELERATION_8_ARMS, MOTION_MAX_JERK_8_ARMS}
+  }
+};
+
+// Feeder driving the motors, the encoder ISRs count the edges of its motors
+feederS *motorsFeeder = NULL;
 
 /*******************************************************************************
 * initMotor
 *
-* @brief Initializes the motor and encoder
+* @brief Initializes the motors and encoders of all hoppers of a feeder. The
+*        first motor is driven by both hardware PWM channels, the second by
+*        software PWM. The encoder ISRs are bound to this feeder
+*
+* @param[in] feeder The feeder
 *
 * @return 0 on success, 1 on failure
 *******************************************************************************/
-uint8_t initMotor() {
+uint8_t initMotor(feederS *feeder) {
   char logMessageBuffer[120];
 
-  pinMode(MOTOR_ENCODER_A, INPUT);
-  pinMode(MOTOR_ENCODER_B, INPUT);
-  pinMode(MOTOR_M1A, PWM_OUTPUT);
-  pinMode(MOTOR_M1B, PWM_OUTPUT);
+  motorsFeeder = feeder;
 
-  if (wiringPiISR(MOTOR_ENCODER_A, INT_EDGE_BOTH, &encoderAISR) < 0) {
-    sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(MOTOR_ENCODER_A), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
-    return 1;
+  for (uint8_t hopper = 0; hopper < HOPPERS_COUNT; hopper++) {
+    motorS *motor = &feeder->motors[hopper];
+
+    motor->pins = motorPins[hopper];
+    motor->config = motorDefaultConfig;
+    motor->encoderISR = motorEncoderISRs[hopper];
+    getHopperFileName(motor->configFile, sizeof(motor->configFile), feeder->directory, MOTOR_CONFIG_FILE, hopper);
+    getHopperFileName(motor->positionFile, sizeof(motor->positionFile), feeder->directory, MOTOR_POSITION_FILE, hopper);
+
+    pinMode(motor->pins.encoderA, INPUT);
+    pinMode(motor->pins.encoderB, INPUT);
+
+    if (motor->pins.isSoftPwm) {
+      if (softPwmCreate(motor->pins.inputA, 0, MOTOR_SOFT_PWM_RANGE) != 0 ||
+          softPwmCreate(motor->pins.inputB, 0, MOTOR_SOFT_PWM_RANGE) != 0) {
+        sprintf(logMessageBuffer, "Error: Unable to start software PWM of motor %hhu: %s", hopper + 1, strerror(errno));
+        logMessage(feeder, ERROR, logMessageBuffer);
+        return 1;
+      }
+    }
+    else {
+      pinMode(motor->pins.inputA, PWM_OUTPUT);
+      pinMode(motor->pins.inputB, PWM_OUTPUT);
+
+      // Mark-space PWM at a fixed frequency, the balanced mode spreads the pulses
+      // and changes the frequency with the duty
+      pwmSetMode(PWM_MODE_MS);
+      pwmSetRange(MOTOR_PWM_RANGE);
+      pwmSetClock(MOTOR_PWM_CLOCK);
+    }
+
+    atomic_store(&motor->encoderState, readEncoderState(motor));
+
+    if (loadMotorConfig(motor) != 0) {
+      sprintf(logMessageBuffer, "Using default configuration of motor %hhu", hopper + 1);
+      logMessage(feeder, WARNING, logMessageBuffer);
+    }
+
+    if (loadWheelPosition(motor) != 0) {
+      sprintf(logMessageBuffer, "Wheel %hhu position unknown, the current position is an arm boundary", hopper + 1);
+      logMessage(feeder, WARNING, logMessageBuffer);
+    }
   }
 
-  if (wiringPiISR(MOTOR_ENCODER_B, INT_EDGE_BOTH, &encoderBISR) < 0) {
-    sprintf(logMessageBuffer, "Error: Unable to setup ISR for %s: %s", getName(MOTOR_ENCODER_B), strerror(errno));
-    logMessage(ERROR, logMessageBuffer);
-    return 1;
+  if (initEncoder(feeder) != 0) return 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+* getMotor
+*
+* @brief Returns the motor of a hopper of a feeder
+*
+* @param[in] feeder The feeder
+* @param[in] hopper Index of the hopper
+*
+* @return The motor of the hopper
+*******************************************************************************/
+motorS *getMotor(feederS *feeder, uint8_t hopper) {
+  return &feeder->motors[hopper < HOPPERS_COUNT ? hopper : 0];
+}
+
+/*******************************************************************************
+* getInterruptMotor
+*
+* @brief Returns the motor of a hopper of the feeder the ISRs are bound to
+*
+* @param[in] hopper Index of the hopper
+*
+* @return The motor of the hopper
+*******************************************************************************/
+motorS *getInterruptMotor(uint8_t hopper) {
+  return getMotor(motorsFeeder, hopper);
+}
+
+/*******************************************************************************
+* saveWheelPosition
+*
+* @brief Saves the absolute wheel position to the position file of the motor.
+*        The file is replaced at once, so a power loss while saving keeps the
+*        previous position
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t saveWheelPosition(motorS *motor) {
+  char logMessageBuffer[120];
+  char tmpFileName[sizeof(motor->positionFile) + 4];
+  sprintf(tmpFileName, "%s.tmp", motor->positionFile);
+
+  FILE *fp = fopen(tmpFileName, "w");
+  if (fp == NULL) {
+    sprintf(logMessageBuffer, "Error during wheel %hhu position saving: %s", motor->hopper + 1, strerror(errno));
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return -1;
+  }
+
+  fprintf(fp, "position: %lld\n", (long long)atomic_load(&motor->encoderPosition));
+  fprintf(fp, "ticks per revolution: %f\n", motor->config.ticksPerRevolution);
+  fclose(fp);
+
+  if (rename(tmpFileName, motor->positionFile) != 0) {
+    sprintf(logMessageBuffer, "Error during wheel %hhu position saving: %s", motor->hopper + 1, strerror(errno));
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* loadWheelPosition
+*
+* @brief Loads the absolute wheel position from the position file of the
+*        motor. A position saved with other encoder ticks per revolution is
+*        rescaled to the current ones
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t loadWheelPosition(motorS *motor) {
+  char logMessageBuffer[120];
+
+  FILE *fp = fopen(motor->positionFile, "r");
+  if (fp == NULL) {
+    sprintf(logMessageBuffer, "Error during wheel %hhu position loading: %s", motor->hopper + 1, strerror(errno));
+    logMessage(motor->feeder, WARNING, logMessageBuffer);
+    return -1;
+  }
+
+  char line[80];
+  long long position;
+  float ticksPerRevolution = motor->config.ticksPerRevolution;
+  bool isPositionLoaded = false;
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "position: %lld", &position) == 1) isPositionLoaded = true;
+    sscanf(line, "ticks per revolution: %f", &ticksPerRevolution);
+  }
+  fclose(fp);
+
+  if (!isPositionLoaded || ticksPerRevolution <= 0) {
+    sprintf(logMessageBuffer, "Wheel %hhu position file is corrupted", motor->hopper + 1);
+    logMessage(motor->feeder, WARNING, logMessageBuffer);
+    return -1;
   }
 
+  atomic_store(&motor->encoderPosition, llround(position * (double)motor->config.ticksPerRevolution / ticksPerRevolution));
+
+  sprintf(logMessageBuffer, "Loaded wheel %hhu position %lld", motor->hopper + 1, (long long)atomic_load(&motor->encoderPosition));
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
   return 0;
 }
 
+/*******************************************************************************
+* saveMotorConfig
+*
+* @brief Saves the controller gains of every wheel, rate, brake mode, encoder
+*        calibration, friction compensation and motion limits to the
+*        configuration file of the motor
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t saveMotorConfig(motorS *motor) {
+  char logMessageBuffer[120];
+  motorConfigS *config = &motor->config;
+
+  FILE *fp = fopen(motor->configFile, "w");
+  if (fp == NULL) {
+    sprintf(logMessageBuffer, "Error during motor %hhu configuration saving: %s", motor->hopper + 1, strerror(errno));
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return -1;
+  }
+
+  fprintf(fp, "rate: %hu\n", config->controlRate);
+  fprintf(fp, "ticks per revolution: %f\n", config->ticksPerRevolution);
+  fprintf(fp, "brake: %s\n", motorBrakeModeStrings[config->brakeMode]);
+
+  for (uint8_t i = 0; i < MOTOR_DIRECTIONS_COUNT; i++) {
+    motorFrictionS *friction = &config->friction[i];
+    fprintf(fp, "friction %s: %f %f\n", motorDirectionStrings[i], friction->breakAway, friction->coulomb);
+  }
+
+  for (uint8_t i = 0; i < MOTOR_WHEEL_CONFIGS; i++) {
+    motorGainsS *gains = &config->gains[i];
+    fprintf(fp, "gains %hhu: %f %f %f\n", gains->wheelArms, gains->kp, gains->ki, gains->kd);
+  }
+
+  for (uint8_t i = 0; i < MOTOR_WHEEL_CONFIGS; i++) {
+    motionLimitsS *limits = &config->limits[i];
+    fprintf(fp, "limits %hhu: %f %f %f\n", limits->wheelArms, limits->maxVelocity, limits->maxAcceleration, limits->maxJerk);
+  }
+
+  fclose(fp);
+
+  sprintf(logMessageBuffer, "Saved motor %hhu configuration. Rate %hu Hz", motor->hopper + 1, config->controlRate);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+* loadMotorConfig
+*
+* @brief Loads the controller gains, rate, brake mode, encoder calibration,
+*        friction compensation and motion limits from the configuration file
+*        of the motor. Missing entries keep their default values
+*
+* @param[in] motor The motor
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t loadMotorConfig(motorS *motor) {
+  char logMessageBuffer[120];
+  motorConfigS *config = &motor->config;
+
+  FILE *fp = fopen(motor->configFile, "r");
+  if (fp == NULL) {
+    sprintf(logMessageBuffer, "Error during motor %hhu configuration loading: %s", motor->hopper + 1, strerror(errno));
+    logMessage(motor->feeder, WARNING, logMessageBuffer);
+    return -1;
+  }
+
+  char line[80];
+  char brakeMode[16];
+  char direction[16];
+  uint8_t wheelArms;
+  float kp, ki, kd;
+  float breakAway, coulomb;
+  float maxVelocity, maxAcceleration, maxJerk;
+
+  while (fgets(line, sizeof(line), fp) != NULL) {
+    if (sscanf(line, "rate: %hu", &config->controlRate) == 1) continue;
+    if (sscanf(line, "ticks per revolution: %f", &config->ticksPerRevolution) == 1) continue;
+    if (sscanf(line, "brake: %15s", brakeMode) == 1) {
+      for (uint8_t i = 0; i < MOTOR_BRAKE_MODES_COUNT; i++) {
+        if (strcmp(brakeMode, motorBrakeModeStrings[i]) == 0) config->brakeMode = i;
+      }
+      continue;
+    }
+    if (sscanf(line, "friction %15[a-z]: %f %f", direction, &breakAway, &coulomb) == 3) {
+      for (uint8_t i = 0; i < MOTOR_DIRECTIONS_COUNT; i++) {
+        if (strcmp(direction, motorDirectionStrings[i]) == 0) {
+          config->friction[i].breakAway = breakAway;
+          config->friction[i].coulomb = coulomb;
+        }
+      }
+      continue;
+    }
+    if (sscanf(line, "gains %hhu: %f %f %f", &wheelArms, &kp, &ki, &kd) == 4) {
+      motorGainsS *gains = getMotorGains(motor, wheelArms);
+      if (gains->wheelArms == wheelArms) {
+        gains->kp = kp;
+        gains->ki = ki;
+        gains->kd = kd;
+      }
+      continue;
+    }
+    if (sscanf(line, "limits %hhu: %f %f %f", &wheelArms, &maxVelocity, &maxAcceleration, &maxJerk) == 4) {
+      setMotorLimits(motor, wheelArms, maxVelocity, maxAcceleration, maxJerk);
+    }
+  }
+
+  fclose(fp);
+
+  setMotorControlRate(motor, config->controlRate);
+
+  sprintf(logMessageBuffer, "Loaded motor %hhu configuration. Rate %hu Hz, %s braking, %.2f ticks per revolution",
+    motor->hopper + 1, config->controlRate, motorBrakeModeStrings[config->brakeMode], config->ticksPerRevolution);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  for (uint8_t i = 0; i < MOTOR_WHEEL_CONFIGS; i++) {
+    motorGainsS *gains = &config->gains[i];
+    sprintf(logMessageBuffer, "Gains for %hhu arms wheel: kp %.3f ki %.3f kd %.3f",
+      gains->wheelArms, gains->kp, gains->ki, gains->kd);
+    logMessage(motor->feeder, INFO, logMessageBuffer);
+  }
+
+  for (uint8_t i = 0; i < MOTOR_DIRECTIONS_COUNT; i++) {
+    motorFrictionS *friction = &config->friction[i];
+    sprintf(logMessageBuffer, "Friction %s: break-away %.3f coulomb %.3f",
+      motorDirectionStrings[i], friction->breakAway, friction->coulomb);
+    logMessage(motor->feeder, INFO, logMessageBuffer);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* getMotorGains
+*
+* @brief Returns the PID gains of a motor for a wheel configuration
+*
+* @param[in] motor The motor
+* @param[in] wheelArms Arms of the feeding wheel
+*
+* @return The gains of the wheel or the gains of the first wheel if the
+*         configuration is unknown
+*******************************************************************************/
+motorGainsS *getMotorGains(motorS *motor, uint8_t wheelArms) {
+  for (uint8_t i = 0; i < MOTOR_WHEEL_CONFIGS; i++) {
+    if (motor->config.gains[i].wheelArms == wheelArms) return &motor->config.gains[i];
+  }
+
+  return &motor->config.gains[0];
+}
+
+/*******************************************************************************
+* setMotorGains
+*
+* @brief Sets the PID gains of a wheel configuration used by the next moves of
+*        a motor and saves them
+*
+* @param[in] motor The motor
+* @param[in] wheelArms Arms of the feeding wheel
+* @param[in] kp Proportional gain
+* @param[in] ki Integral gain
+* @param[in] kd Derivative gain
+*******************************************************************************/
+void setMotorGains(motorS *motor, uint8_t wheelArms, float kp, float ki, float kd) {
+  motorGainsS *gains = getMotorGains(motor, wheelArms);
+  if (gains->wheelArms != wheelArms) return;
+
+  gains->kp = kp;
+  gains->ki = ki;
+  gains->kd = kd;
+
+  char logMessageBuffer[120];
+  sprintf(logMessageBuffer, "Set motor %hhu gains for %hhu arms wheel: kp %.3f ki %.3f kd %.3f",
+    motor->hopper + 1, wheelArms, kp, ki, kd);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  saveMotorConfig(motor);
+}
+
+/*******************************************************************************
+* getMotorLimits
+*
+* @brief Returns the motion limits of a motor for a wheel configuration
+*
+* @param[in] motor The motor
+* @param[in] wheelArms Arms of the feeding wheel
+*
+* @return The limits of the wheel or the limits of the first wheel if the
+*         configuration is unknown
+*******************************************************************************/
+motionLimitsS *getMotorLimits(motorS *motor, uint8_t wheelArms) {
+  for (uint8_t i = 0; i < MOTOR_WHEEL_CONFIGS; i++) {
+    if (motor->config.limits[i].wheelArms == wheelArms) return &motor->config.limits[i];
+  }
+
+  return &motor->config.limits[0];
+}
+
+/*******************************************************************************
+* setMotorLimits
+*
+* @brief Sets the motion limits of a motor for a known wheel configuration
+*
+* @param[in] motor The motor
+* @param[in] wheelArms Arms of the feeding wheel
+* @param[in] maxVelocity Velocity limit [deg/s]
+* @param[in] maxAcceleration Acceleration limit [deg/s^2]
+* @param[in] maxJerk Jerk limit [deg/s^3], 0 for a trapezoidal profile
+*******************************************************************************/
+void setMotorLimits(motorS *motor, uint8_t wheelArms, float maxVelocity, float maxAcceleration, float maxJerk) {
+  motionLimitsS *limits = getMotorLimits(motor, wheelArms);
+  if (limits->wheelArms != wheelArms) return;
+
+  limits->maxVelocity = maxVelocity;
+  limits->maxAcceleration = maxAcceleration;
+  limits->maxJerk = maxJerk;
+}
+
+/*******************************************************************************
+* getMotorControlRate
+*
+* @brief Returns the rate of the control loop of a motor
+*
+* @param[in] motor The motor
+*
+* @return Control loop rate [Hz]
+*******************************************************************************/
+uint16_t getMotorControlRate(motorS *motor) {
+  return motor->config.controlRate;
+}
+
+/*******************************************************************************
+* setMotorControlRate
+*
+* @brief Sets the rate of the control loop used by the next moves. The rate is
+*        limited to MOTOR_CONTROL_RATE_MIN - MOTOR_CONTROL_RATE_MAX
+*
+* @param[in] motor The motor
+* @param[in] rate Control loop rate [Hz]
+*******************************************************************************/
+void setMotorControlRate(motorS *motor, uint16_t rate) {
+  if (rate < MOTOR_CONTROL_RATE_MIN) rate = MOTOR_CONTROL_RATE_MIN;
+  if (rate > MOTOR_CONTROL_RATE_MAX) rate = MOTOR_CONTROL_RATE_MAX;
+
+  motor->config.controlRate = rate;
+}
+
+/*******************************************************************************
+* getMotorBrakeMode
+*
+* @brief Returns how the motor is stopped and slowed down
+*
+* @param[in] motor The motor
+*
+* @return The brake mode
+*******************************************************************************/
+motorBrakeModeE getMotorBrakeMode(motorS *motor) {
+  return motor->config.brakeMode;
+}
+
+/*******************************************************************************
+* setMotorBrakeMode
+*
+* @brief Sets the brake mode used by the next moves of a motor
+*
+* @param[in] motor The motor
+* @param[in] mode The brake mode
+*******************************************************************************/
+void setMotorBrakeMode(motorS *motor, motorBrakeModeE mode) {
+  if (mode >= MOTOR_BRAKE_MODES_COUNT) return;
+
+  motor->config.brakeMode = mode;
+}
+
+/*******************************************************************************
+* getMotorBrakeModeName
+*
+* @brief Returns the name of a brake mode as written to motor.cfg
+*
+* @param[in] mode The brake mode
+*
+* @return The name of the mode
+*******************************************************************************/
+const char *getMotorBrakeModeName(motorBrakeModeE mode) {
+  return mode < MOTOR_BRAKE_MODES_COUNT ? motorBrakeModeStrings[mode] : "unknown";
+}
+
+/*******************************************************************************
+* getEncoderTicksPerDegree
+*
+* @brief Returns the encoder ticks per degree of the wheel, calibrated or from
+*        the nominal gear ratio
+*
+* @param[in] motor The motor
+*
+* @return Encoder ticks per degree of the output shaft
+*******************************************************************************/
+float getEncoderTicksPerDegree(motorS *motor) {
+  return motor->config.ticksPerRevolution / 360;
+}
+
+/*******************************************************************************
+* setEncoderTicksPerRevolution
+*
+* @brief Sets the measured encoder ticks per revolution of the wheel used by
+*        the next moves and saves it
+*
+* @param[in] motor The motor
+* @param[in] ticks Encoder ticks per revolution of the output shaft
+*******************************************************************************/
+void setEncoderTicksPerRevolution(motorS *motor, float ticks) {
+  // The wheel angle stays the same, only the ticks it is counted in change
+  atomic_store(&motor->encoderPosition,
+    llround(atomic_load(&motor->encoderPosition) * (double)ticks / motor->config.ticksPerRevolution));
+  motor->config.ticksPerRevolution = ticks;
+
+  char logMessageBuffer[120];
+  sprintf(logMessageBuffer, "Set encoder %hhu calibration: %.2f ticks per revolution, nominal %.2f",
+    motor->hopper + 1, ticks, MOTOR_ENCODER_TICKS_PER_DEGREE * 360);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  saveMotorConfig(motor);
+  saveWheelPosition(motor);
+}
+
+/*******************************************************************************
+* getMotorFriction
+*
+* @brief Returns the friction compensation of a direction
+*
+* @param[in] motor The motor
+* @param[in] direction Direction of the output
+*
+* @return The friction compensation
+*******************************************************************************/
+motorFrictionS *getMotorFriction(motorS *motor, motorDirectionE direction) {
+  return &motor->config.friction[direction == MOTOR_REVERSE ? MOTOR_REVERSE : MOTOR_FORWARD];
+}
+
+/*******************************************************************************
+* setMotorFriction
+*
+* @brief Sets the friction compensation of a direction used by the next moves
+*        and saves it
+*
+* @param[in] motor The motor
+* @param[in] direction Direction of the output
+* @param[in] breakAway Duty at which the motor starts moving, fraction of the
+*                      PWM range
+* @param[in] coulomb Duty below which the moving motor stops, fraction of the
+*                    PWM range
+*******************************************************************************/
+void setMotorFriction(motorS *motor, motorDirectionE direction, float breakAway, float coulomb) {
+  motorFrictionS *friction = getMotorFriction(motor, direction);
+  friction->breakAway = breakAway;
+  friction->coulomb = coulomb;
+
+  char logMessageBuffer[120];
+  sprintf(logMessageBuffer, "Set motor %hhu friction %s: break-away %.3f coulomb %.3f",
+    motor->hopper + 1, motorDirectionStrings[direction == MOTOR_REVERSE ? MOTOR_REVERSE : MOTOR_FORWARD], breakAway, coulomb);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  saveMotorConfig(motor);
+}
+
+/*******************************************************************************
+* compensateFriction
+*
+* @brief Adds the friction feed-forward to the controller output. While the
+*        reference moves, the duty which overcomes friction in its direction
+*        is added, the break-away duty if the motor doesn't move yet and the
+*        Coulomb duty once it does. On the final approach to a position the
+*        same offset lifts the output out of the deadband in the direction of
+*        the output, so small corrections move the motor. The output is scaled
+*        into the duty left above the offset, so the full range stays usable
+*
+* @param[in] motor The motor
+* @param[in] output Controller output [PWM]
+* @param[in] referenceVelocity Velocity of the reference, positive forward
+*                              [ticks/s]
+* @param[in] velocity Measured velocity, signed like the encoder position
+*                     [ticks/s]
+* @param[in] isApproaching Whether or not the motor is outside of the position
+*                          tolerance of a resting reference
+*
+* @return The compensated output [PWM]
+*******************************************************************************/
+float compensateFriction(motorS *motor, float output, float referenceVelocity, float velocity, bool isApproaching) {
+  float minVelocity = MOTOR_FRICTION_MIN_VELOCITY * getEncoderTicksPerDegree(motor);
+  float direction;
+
+  if (fabsf(referenceVelocity) >= minVelocity) {
+    direction = referenceVelocity > 0 ? 1 : -1;
+  } else if (isApproaching && output != 0) {
+    direction = output > 0 ? 1 : -1;
+  } else {
+    return output;
+  }
+
+  // The encoder counts down when moving forward
+  motorFrictionS *friction = getMotorFriction(motor, direction > 0 ? MOTOR_FORWARD : MOTOR_REVERSE);
+  bool isMoving = -velocity * direction >= minVelocity;
+  float offset = (isMoving ? friction->coulomb : friction->breakAway) * MOTOR_PWM_RANGE;
+
+  return direction * offset + output * (MOTOR_PWM_RANGE - offset) / MOTOR_PWM_RANGE;
+}
+
+/*******************************************************************************
+* writeMotorInputs
+*
+* @brief Writes the duties of both driver inputs of a motor, scaled from the
+*        hardware PWM range to the software PWM range if the motor runs on
+*        software PWM
+*
+* @param[in] motor The motor
+* @param[in] dutyA Duty of the input driven to reverse, 0 - MOTOR_PWM_RANGE
+* @param[in] dutyB Duty of the input driven to go forward, 0 - MOTOR_PWM_RANGE
+*******************************************************************************/
+void writeMotorInputs(motorS *motor, int32_t dutyA, int32_t dutyB) {
+  if (motor->pins.isSoftPwm) {
+    softPwmWrite(motor->pins.inputA, (dutyA * MOTOR_SOFT_PWM_RANGE + MOTOR_PWM_RANGE / 2) / MOTOR_PWM_RANGE);
+    softPwmWrite(motor->pins.inputB, (dutyB * MOTOR_SOFT_PWM_RANGE + MOTOR_PWM_RANGE / 2) / MOTOR_PWM_RANGE);
+  }
+  else {
+    pwmWrite(motor->pins.inputA, dutyA);
+    pwmWrite(motor->pins.inputB, dutyB);
+  }
+}
+
 /*******************************************************************************
 * driveMotor
 *
 * @brief Drives the motor at a given speed and direction
 *
+* @param[in] motor The motor
 * @param[in] speed The speed to drive the motor at
 *******************************************************************************/
-void driveMotor(int32_t speed) {
+void driveMotor(motorS *motor, int32_t speed) {
   if (speed > 0) {
-    if (speed > 1024) speed = 1024;
-    pwmWrite(MOTOR_M1A, 0);
-    pwmWrite(MOTOR_M1B, speed);
+    if (speed > MOTOR_PWM_RANGE) speed = MOTOR_PWM_RANGE;
+    writeMotorInputs(motor, 0, speed);
   }
   else if (speed < 0) {
-    if (speed < -1024) speed = -1024;
-    pwmWrite(MOTOR_M1A, -speed);
-    pwmWrite(MOTOR_M1B, 0);
+    if (speed < -MOTOR_PWM_RANGE) speed = -MOTOR_PWM_RANGE;
+    writeMotorInputs(motor, -speed, 0);
   }
   else {
-    pwmWrite(MOTOR_M1A, 0);
-    pwmWrite(MOTOR_M1B, 0);
+    writeMotorInputs(motor, 0, 0);
   }
+
+  motor->output = speed;
+}
+
+/*******************************************************************************
+* brakeMotor
+*
+* @brief Brakes the motor by shorting its terminals. The driver shorts them
+*        while both inputs are high, so the strength is the fraction of the PWM
+*        period the motor is braked for. The braking torque also falls with the
+*        speed, so braking can't reverse the motor
+*
+* @param[in] motor The motor
+* @param[in] strength Braking strength, 0 - MOTOR_PWM_RANGE
+*******************************************************************************/
+void brakeMotor(motorS *motor, int32_t strength) {
+  if (strength < 0) strength = 0;
+  if (strength > MOTOR_PWM_RANGE) strength = MOTOR_PWM_RANGE;
+
+  writeMotorInputs(motor, strength, strength);
+
+  motor->output = 0;
+}
+
+/*******************************************************************************
+* stopMotor
+*
+* @brief Stops driving the motor. Depending on the brake mode the motor either
+*        coasts or is braked with full strength, which also holds the wheel
+*        against the load of the food
+*
+* @param[in] motor The motor
+*******************************************************************************/
+void stopMotor(motorS *motor) {
+  if (motor->config.brakeMode == MOTOR_BRAKE_COAST) {
+    driveMotor(motor, 0);
+  } else {
+    brakeMotor(motor, MOTOR_PWM_RANGE);
+  }
+}
+
+/*******************************************************************************
+* waitForNextPeriod
+*
+* @brief Sleeps until the next absolute deadline of the control loop and
+*        records how late the wake-up was. If the deadline was already missed
+*        the schedule is resynchronized instead of trying to catch up
+*
+* @param[in] motor The motor the control loop runs
+* @param[in,out] deadline The deadline of the current period, advanced by one
+*                         period
+* @param[in] periodNs Control loop period [ns]
+*******************************************************************************/
+void waitForNextPeriod(motorS *motor, struct timespec *deadline, uint32_t periodNs) {
+  struct timespec now;
+
+  deadline->tv_nsec += periodNs;
+  while (deadline->tv_nsec >= 1000000000) {
+    deadline->tv_nsec -= 1000000000;
+    deadline->tv_sec++;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  if (now.tv_sec > deadline->tv_sec ||
+      (now.tv_sec == deadline->tv_sec && now.tv_nsec > deadline->tv_nsec)) {
+    metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_CONTROL_LOOP_OVERRUNS);
+    *deadline = now;
+    return;
+  }
+
+  clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, deadline, NULL);
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  int64_t lateNs = (int64_t)(now.tv_sec - deadline->tv_sec) * 1000000000 + (now.tv_nsec - deadline->tv_nsec);
+  metricsObserve(motor->feeder, METRIC_CONTROL_LOOP_JITTER, lateNs > 0 ? lateNs / 1000 : 0);
+}
+
+/*******************************************************************************
+* planMotorSegment
+*
+* @brief Plans a segment of a move in encoder ticks with the limits of a wheel
+*
+* @param[in] motor The motor
+* @param[out] profile The planned profile
+* @param[in] limits Motion limits of the wheel in degrees
+* @param[in] distance Signed distance of the segment [ticks]
+*******************************************************************************/
+void planMotorSegment(motorS *motor, motionProfileS *profile, motionLimitsS *limits, int32_t distance) {
+  float ticksPerDegree = getEncoderTicksPerDegree(motor);
+
+  planMotion(profile, distance, limits->maxVelocity * ticksPerDegree,
+    limits->maxAcceleration * ticksPerDegree, limits->maxJerk * ticksPerDegree);
 }
 
 /*******************************************************************************
 * rotateMotor
 *
-* @brief Rotates the motor by a given number of degrees
+* @brief Rotates the motor by a given number of degrees in a single move
 *
+* @param[in] motor The motor
 * @param[in] degrees The number of degrees to rotate the motor by
+*
+* @return 0 on success, 1 if the move was given up, aborted or cancelled
+*******************************************************************************/
+uint8_t rotateMotor(motorS *motor, int32_t degrees) {
+  return rotateMotorInSteps(motor, degrees, degrees, 0);
+}
+
+/*******************************************************************************
+* wheelBoundary
+*
+* @brief Returns the absolute position of a step boundary. Boundaries are
+*        spaced by the step size from the absolute position 0, so with steps of
+*        one portion they are the arm boundaries of the wheel
+*
+* @param[in] motor The motor
+* @param[in] boundary Number of the boundary, 0 at the absolute position 0
+* @param[in] stepDegrees Size of a step [deg]
+*
+* @return Absolute position of the boundary, positive forward [ticks]
+*******************************************************************************/
+int64_t wheelBoundary(motorS *motor, int64_t boundary, int32_t stepDegrees) {
+  return llround(boundary * stepDegrees * (double)motor->config.ticksPerRevolution / 360);
+}
+
+/*******************************************************************************
+* stepBoundary
+*
+* @brief Returns the position of a step boundary within a move
+*
+* @param[in] motor The motor
+* @param[in] startBoundary Boundary the move starts from
+* @param[in] step Number of the boundary, 0 is the start of the move
+* @param[in] stepDegrees Size of a step [deg]
+* @param[in] moveOrigin Encoder position at the start of the move
+*
+* @return Position of the boundary relative to the start of the move, positive
+*         forward [ticks]
+*******************************************************************************/
+int32_t stepBoundary(motorS *motor, int64_t startBoundary, uint16_t step, int32_t stepDegrees, int64_t moveOrigin) {
+  return wheelBoundary(motor, startBoundary + step, stepDegrees) + moveOrigin;
+}
+
+/*******************************************************************************
+* rotateMotorInSteps
+*
+* @brief Rotates the motor by a given number of degrees, made of steps of equal
+*        size such as the portions of a feed. The PID controller runs at a
+*        fixed rate and tracks a motion profile planned with the limits of the
+*        current wheel. Without a dwell the whole move is a single profile,
+*        otherwise the motor stops and holds at every step boundary for the
+*        dwell time. The step boundaries are absolute, the move starts from the
+*        boundary closest to the wheel and ends on a boundary, so residual
+*        errors and jam back-offs of earlier moves don't add up to a drift of
+*        the arms. A move or a step ends once its profile is done and the
+*        position stays within MOTOR_POSITION_TOLERANCE for MOTOR_SETTLE_WINDOW.
+*        The completed steps are counted from the encoder position. The output
+*        is compensated for friction with the calibrated duties. The motor
+*        is stopped with the configured brake mode, in the proportional mode an
+*        output against the motion within MOTOR_BRAKE_ZONE of the target brakes
+*        the motor instead of reversing it
+*
+*        A jam is detected when the velocity stays below MOTOR_JAM_MIN_VELOCITY
+*        for MOTOR_JAM_WINDOW while the motor lags behind the reference and the
+*        output is at its limit, so a motor still breaking away from rest isn't
+*        taken for jammed. The motor then reverses, pauses and retries with a
+*        higher output limit and a longer run-up. After MOTOR_JAM_MAX_ATTEMPTS retries the move is given
+*        up. Every segment ends at most MOTOR_SEGMENT_TIMEOUT after its profile,
+*        so the duration of a move is bounded. A move also ends at once when
+*        the watchdog aborts it or a stop is requested
+*
+* @param[in] motor The motor
+* @param[in] degrees The number of degrees to rotate the motor by
+* @param[in] stepDegrees Size of a step, the same sign as degrees
+* @param[in] dwell Time to hold at every step boundary, 0 for a single move [ms]
+*
+* @return 0 on success, 1 if the move was given up, aborted or cancelled
 *******************************************************************************/
-void rotateMotor(int32_t degrees) {
+uint8_t rotateMotorInSteps(motorS *motor, int32_t degrees, int32_t stepDegrees, uint16_t dwell) {
+  if (stepDegrees == 0 || (stepDegrees > 0) != (degrees > 0)) stepDegrees = degrees;
+  uint16_t steps = stepDegrees != 0 ? degrees / stepDegrees : 1;
+  if (steps == 0) steps = 1;
+
   char logMessageBuffer[120];
-  sprintf(logMessageBuffer, "Rotating motor by %d degrees", degrees);
-  logMessage(INFO, logMessageBuffer);
-  bool blockHappened = false;
+  if (steps > 1) {
+    sprintf(logMessageBuffer, "Rotating motor %hhu by %d degrees in %hu steps", motor->hopper + 1, degrees, steps);
+  } else {
+    sprintf(logMessageBuffer, "Rotating motor %hhu by %d degrees", motor->hopper + 1, degrees);
+  }
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+  motorStateE state = MOTOR_STATE_MOVING;
+  uint8_t jams = 0;
+  bool moveAborted = false;
+  bool moveCancelled = false;
+
+  watchdogBeginMove(motor->feeder, motor->hopper);
+  watchdogSetPhase(motor->feeder, motor->hopper, WATCHDOG_PHASE_MOVING);
+  traceBeginMove(motor->feeder, motor->hopper, degrees);
 
-  encoderPosition = 0;
+  uint32_t moveStartTime = millis();
+  uint64_t moveStartEdges = metricsGetHopperCounter(motor->feeder, motor->hopper, METRIC_ENCODER_EDGES);
+  uint64_t moveStartIllegal = metricsGetHopperCounter(motor->feeder, motor->hopper, METRIC_ENCODER_ILLEGAL_TRANSITIONS);
+  uint32_t iterations = 0;
+  uint64_t startTime = 0;
 
-  int32_t targetPosition = degrees * MOTOR_ENCODER_TICKS_PER_DEGREE;
+  float ticksPerDegree = getEncoderTicksPerDegree(motor);
+  int64_t moveOrigin = atomic_load(&motor->encoderPosition);
 
-  // PID constants
-  float kp = 5; // Proportional
-  float kd = 0; // Derivative
-  float ki = 0; // Integral
+  // The encoder counts down when moving forward, the boundaries count up
+  int64_t startBoundary = stepDegrees != 0 ? llround(-moveOrigin / (stepDegrees * (double)motor->config.ticksPerRevolution / 360)) : 0;
+  int32_t targetPosition = stepDegrees != 0 && degrees % stepDegrees == 0 ?
+    stepBoundary(motor, startBoundary, steps, stepDegrees, moveOrigin) :
+    stepBoundary(motor, startBoundary, 0, stepDegrees, moveOrigin) + lroundf(degrees * ticksPerDegree);
+  int8_t direction = targetPosition >= 0 ? 1 : -1;
 
-  // PID variables
-  uint32_t prevTime = 0;
-  float prevError = 0;
-  float integralError = 0;
+  motorGainsS *gains = getMotorGains(motor, getFeedingWheelArms(motor->feeder, motor->hopper));
+  pidS pid;
+  pidInit(&pid, gains->kp, gains->ki, gains->kd, MOTOR_PID_DERIVATIVE_FILTER, MOTOR_PWM_RANGE * MOTOR_JAM_BASE_EFFORT);
 
-  // Block detection
-  uint32_t blockTicks = 0; // Number of encoder ticks without change
+  // Fixed rate timing
+  uint32_t periodNs = 1000000000 / motor->config.controlRate;
+  float deltaT = 1.0 / motor->config.controlRate;
+  uint32_t settleIterations = MOTOR_SETTLE_WINDOW * motor->config.controlRate / 1000;
 
-  // Control signal
-  float u = -1;
+  struct timespec deadline;
+  clock_gettime(CLOCK_MONOTONIC, &deadline);
+  struct timespec moveStart = deadline;
 
-  while(u != 0) {
-    // Time difference
-    uint32_t currTime = micros();
+  // Reference trajectory of the current segment, planned in ticks with the
+  // limits of the current wheel
+  motionLimitsS *limits = getMotorLimits(motor, getFeedingWheelArms(motor->feeder, motor->hopper));
+  motionProfileS profile;
+  struct timespec segmentStart = deadline;
+  int32_t segmentStartPosition = 0;
 
-    float deltaT = ((float)(currTime - prevTime)) / 1.0e6;
-    prevTime = currTime;
+  // Without a dwell the first segment goes straight to the target
+  uint16_t segmentStep = dwell > 0 ? 1 : steps; // Step boundary the motor moves to
+  uint16_t stepsCompleted = 0;
+  int32_t segmentTarget = segmentStep >= steps ? targetPosition : stepBoundary(motor, startBoundary, segmentStep, stepDegrees, moveOrigin);
+  planMotorSegment(motor, &profile, limits, segmentTarget);
+  uint32_t plannedTime = profile.totalTime * 1000 * steps / segmentStep + (steps - 1) * dwell;
 
-    // Error
-    int16_t error = encoderPosition + targetPosition;
+  // Velocity from the encoder edge timestamps
+  velocityEstimatorS velocityEstimator;
+  initVelocityEstimator(motor, &velocityEstimator);
+  float peakVelocity = 0; // [ticks/s]
 
-    // Check for block
-    if (error == prevError) {
-      blockTicks++;
+  // Jam detection
+  uint32_t jamIterations = MOTOR_JAM_WINDOW * motor->config.controlRate / 1000;
+  uint32_t stoppedTicks = 0; // Number of control periods below MOTOR_JAM_MIN_VELOCITY
+  uint32_t stalledTicks = 0; // Number of those periods the output was at its limit
+
+  // Braking near the target
+  int32_t brakeZone = MOTOR_BRAKE_ZONE * ticksPerDegree;
+  float brakeMinVelocity = MOTOR_BRAKE_MIN_VELOCITY * ticksPerDegree;
+
+  // Settling
+  uint32_t settledTicks = 0; // Number of control periods within tolerance
+  uint32_t settleStartTime = moveStartTime;
+  int32_t overshoot = 0; // Largest excursion past the target [ticks]
+
+  while (state != MOTOR_STATE_SETTLED && state != MOTOR_STATE_FAULT) {
+    // Move budget breached, the supervisor already stopped the motor
+    if (watchdogIsMoveAborted(motor->feeder, motor->hopper)) {
+      moveAborted = true;
+      break;
+    }
+
+    if (atomic_load(&motor->isStopRequested)) {
+      moveCancelled = true;
+      break;
+    }
+
+    // Time of this period's deadline within the segment
+    float t = (deadline.tv_sec - segmentStart.tv_sec) + (deadline.tv_nsec - segmentStart.tv_nsec) / 1.0e9;
+    bool isProfileDone = t >= profile.totalTime;
+    bool isSegmentTimedOut = t >= profile.totalTime + MOTOR_SEGMENT_TIMEOUT / 1000.0;
+
+    int32_t position = atomic_load(&motor->encoderPosition) - moveOrigin;
+    int32_t referencePosition = segmentStartPosition + lroundf(motionPosition(&profile, t));
+    int32_t error = position + referencePosition;
+    int32_t finalError = position + targetPosition;
+
+    // The encoder counts down when moving forward, so the rate of the error is
+    // the sum of the measured and the reference velocity
+    float velocity = updateVelocityEstimator(motor, &velocityEstimator);
+    float errorRate = velocity + motionVelocity(&profile, t);
+    if (fabsf(velocity) > peakVelocity) peakVelocity = fabsf(velocity);
+    updateEncoderMode(motor, velocity);
+
+    // A motor still breaking away from rest doesn't move either, it only
+    // stalls once the output reached its limit. Under a heavy load the
+    // break-away duty of the calibration isn't enough
+    if (fabsf(velocity) < MOTOR_JAM_MIN_VELOCITY * ticksPerDegree) {
+      stoppedTicks++;
+      stalledTicks = abs(motor->output) >= pid.outputLimit - 1 ? stalledTicks + 1 : 0;
     } else {
-      blockTicks = 0;
+      stoppedTicks = 0;
+      stalledTicks = 0;
     }
+    bool isStopped = stoppedTicks >= jamIterations;
+    bool isStalled = stalledTicks >= jamIterations;
 
-    // If block detected
-    if (blockTicks >= 150) {
-      // Stop the motor
-      driveMotor(0);
-      // Back off
-      int32_t backOffDegrees = degrees / -2;
-      rotateMotor(backOffDegrees);
-      delay(1000); // Wait for the motor to back off
-      // Continue with the original destination
-      targetPosition += backOffDegrees* MOTOR_ENCODER_TICKS_PER_DEGREE;
-      blockTicks = 0; // Reset blockTicks
-      blockHappened = true;
+    // Steps are completed once the wheel got close to their boundary, a retry
+    // after a jam doesn't take them back
+    while (stepsCompleted < steps &&
+           -position * direction >= abs(stepBoundary(motor, startBoundary, stepsCompleted + 1, stepDegrees, moveOrigin)) - MOTOR_JAM_ERROR) {
+      stepsCompleted++;
+      atomic_store(&motor->stepsCompleted, stepsCompleted);
     }
 
-    // Derivative
-    float derivative = (error - prevError) / deltaT;
+    bool isJammed = false;
+    bool isSegmentReached = false;
+
+    switch (state) {
+    case MOTOR_STATE_MOVING:
+      if (-finalError * direction > overshoot) {
+        overshoot = -finalError * direction;
+      }
 
-    // Integral
-    integralError += error * deltaT;
+      if (isProfileDone && abs(error) <= MOTOR_POSITION_TOLERANCE) {
+        if (settledTicks == 0) settleStartTime = millis();
+        if (++settledTicks >= settleIterations) isSegmentReached = true;
+      }
+      else {
+        settledTicks = 0;
 
-    // Control signal
-    u = kp * error + kd * derivative + ki * integralError;
+        // The motor lags behind the reference but doesn't move
+        if (isStalled && error * direction > MOTOR_JAM_ERROR) {
+          isJammed = true;
+        }
+        else if (isSegmentTimedOut) {
+          // Stuck close to the target, e.g. on static friction, is not worth a retry
+          if (abs(position + segmentTarget) <= MOTOR_JAM_ERROR) {
+            settleStartTime = millis();
+            isSegmentReached = true;
+          }
+          else {
+            isJammed = true;
+          }
+        }
+      }
 
-    // Drive the motor
-    driveMotor(u);
+      if (isSegmentReached) {
+        settledTicks = 0;
+        if (segmentStep >= steps) {
+          state = MOTOR_STATE_SETTLED;
+        } else {
+          // Hold at the step boundary, the reference stays on it
+          state = MOTOR_STATE_DWELLING;
+          segmentStart = deadline;
+          segmentStartPosition = segmentTarget;
+          planMotorSegment(motor, &profile, limits, 0);
+        }
+      }
+      break;
 
-    // Update previous error
-    prevError = error;
+    case MOTOR_STATE_DWELLING:
+      if (t >= dwell / 1000.0) {
+        state = MOTOR_STATE_MOVING;
+        segmentStep++;
+        segmentTarget = segmentStep >= steps ? targetPosition : stepBoundary(motor, startBoundary, segmentStep, stepDegrees, moveOrigin);
+        segmentStart = deadline;
+        planMotorSegment(motor, &profile, limits, segmentTarget - segmentStartPosition);
+        stoppedTicks = 0;
+        stalledTicks = 0;
+      }
+      break;
 
-    // Print debug info
-    delayMicroseconds(100);
+    case MOTOR_STATE_REVERSING:
+      // The reverse point doesn't have to be reached exactly, only stop once the motor stopped
+      if (isSegmentTimedOut || (isProfileDone && (abs(error) <= MOTOR_JAM_ERROR || isStopped))) {
+        state = MOTOR_STATE_PAUSING;
+        stopMotor(motor);
+        segmentStart = deadline;
+      }
+      break;
+
+    case MOTOR_STATE_PAUSING:
+      if (t >= MOTOR_JAM_PAUSE / 1000.0) {
+        // Retry with a higher output limit, plan the rest of the move from the current position
+        state = MOTOR_STATE_MOVING;
+        watchdogSetPhase(motor->feeder, motor->hopper, WATCHDOG_PHASE_MOVING);
+        pid.outputLimit = MOTOR_PWM_RANGE * fminf(1.0, MOTOR_JAM_BASE_EFFORT + jams * MOTOR_JAM_EFFORT_STEP);
+        pidReset(&pid);
+        segmentStart = deadline;
+        segmentStartPosition = -position;
+        planMotorSegment(motor, &profile, limits, segmentTarget - segmentStartPosition);
+        stoppedTicks = 0;
+        stalledTicks = 0;
+      }
+      break;
+
+    default:
+      break;
+    }
+
+    if (isJammed) {
+      jams++;
+      metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_MOTOR_JAMS);
+      stopMotor(motor);
+      settledTicks = 0;
+
+      if (jams > MOTOR_JAM_MAX_ATTEMPTS) {
+        state = MOTOR_STATE_FAULT;
+      }
+      else {
+        sprintf(logMessageBuffer, "Motor %hhu jammed at position %d, retry %hhu of %d", motor->hopper + 1, -position, jams, MOTOR_JAM_MAX_ATTEMPTS);
+        logMessage(motor->feeder, WARNING, logMessageBuffer);
+
+        // Back off further with every retry to get a longer run-up
+        state = MOTOR_STATE_REVERSING;
+        watchdogSetPhase(motor->feeder, motor->hopper, WATCHDOG_PHASE_BACKING_OFF);
+        pidReset(&pid);
+        segmentStart = deadline;
+        segmentStartPosition = -position;
+        planMotorSegment(motor, &profile, limits, -direction * jams * MOTOR_JAM_REVERSE * ticksPerDegree);
+        stoppedTicks = 0;
+        stalledTicks = 0;
+      }
+    }
+
+    // Drive the motor. Close to the target an output against the motion only
+    // has to slow the wheel down, braking does that without reversing the
+    // current through the motor
+    if (state == MOTOR_STATE_MOVING || state == MOTOR_STATE_DWELLING || state == MOTOR_STATE_REVERSING) {
+      if (startTime == 0) startTime = getFeederWallMillis(motor->feeder);
+      bool isApproaching = (isProfileDone || state == MOTOR_STATE_DWELLING) && abs(error) > MOTOR_POSITION_TOLERANCE;
+      int32_t output = compensateFriction(motor, pidUpdateWithRate(&pid, error, errorRate, deltaT),
+        state == MOTOR_STATE_DWELLING ? 0 : motionVelocity(&profile, t), velocity, isApproaching);
+
+      if (motor->config.brakeMode == MOTOR_BRAKE_PROPORTIONAL && state != MOTOR_STATE_REVERSING &&
+          abs(position + segmentTarget) <= brakeZone && output * velocity > 0 && fabsf(velocity) >= brakeMinVelocity) {
+        brakeMotor(motor, abs(output));
+      } else {
+        driveMotor(motor, output);
+      }
+    }
+
+    traceSampleS sample = {
+      .time = (deadline.tv_sec - moveStart.tv_sec) * 1000000 + (deadline.tv_nsec - moveStart.tv_nsec) / 1000,
+      .position = position,
+      .reference = referencePosition,
+      .error = error,
+      .output = motor->output,
+      .state = state,
+      .jams = jams
+    };
+    traceRecord(motor->feeder, motor->hopper, &sample);
+
+    iterations++;
+
+    if (state != MOTOR_STATE_SETTLED && state != MOTOR_STATE_FAULT) {
+      waitForNextPeriod(motor, &deadline, periodNs);
+    }
   }
 
   // Stop the motor
-  driveMotor(0);
+  stopMotor(motor);
+  motor->encoderVelocity = 0;
+  requestEncoderMode(motor, ENCODER_MODE_INTERRUPT);
+  int32_t finalPosition = atomic_load(&motor->encoderPosition) - moveOrigin;
+  atomic_store(&motor->stepsCompleted, 0);
+  saveWheelPosition(motor);
 
-  if (blockHappened) {
-    sprintf(logMessageBuffer, "Motor reached position. Motor rotated by %d degrees, but block happened", degrees);
-    logMessage(WARNING, logMessageBuffer);
+  uint32_t moveTime = millis() - moveStartTime;
+  uint32_t settleTime = settleStartTime - moveStartTime;
+  metricsHopperAdd(motor->feeder, motor->hopper, METRIC_PID_ITERATIONS, iterations);
+  if (state == MOTOR_STATE_SETTLED) {
+    metricsObserve(motor->feeder, METRIC_MOTOR_SETTLE_TIME, settleTime);
+    metricsObserve(motor->feeder, METRIC_MOTOR_OVERSHOOT, overshoot);
+    metricsObserve(motor->feeder, METRIC_MOTOR_MOVE_DELAY, settleTime > plannedTime ? settleTime - plannedTime : 0);
+  }
+  metricsObserve(motor->feeder, METRIC_MOTOR_PEAK_VELOCITY, peakVelocity / ticksPerDegree);
+  if (moveTime > 0) {
+    metricsObserve(motor->feeder, METRIC_ENCODER_EDGE_RATE,
+      (metricsGetHopperCounter(motor->feeder, motor->hopper, METRIC_ENCODER_EDGES) - moveStartEdges) * 1000 / moveTime);
+  }
+
+  watchdogEndMove(motor->feeder, motor->hopper);
+
+  traceEndMove(motor->feeder, motor->hopper, jams, state == MOTOR_STATE_FAULT, moveAborted);
+  if (TRACE_DUMP_ON_JAM && jams > 0) requestTraceDump(motor->feeder);
+
+  motor->lastMoveResult = (motorMoveResultS){
+    .degrees = degrees,
+    .settleTime = settleTime,
+    .plannedTime = plannedTime,
+    .startTime = startTime,
+    .overshoot = overshoot / ticksPerDegree,
+    .peakVelocity = peakVelocity / ticksPerDegree,
+    .steps = steps,
+    .stepsCompleted = stepsCompleted,
+    .finalError = finalPosition + targetPosition,
+    .jams = jams,
+    .isFaulted = state == MOTOR_STATE_FAULT,
+    .isAborted = moveAborted,
+    .isCancelled = moveCancelled
+  };
+
+  if (moveAborted) {
+    sprintf(logMessageBuffer, "Motor %hhu move by %d degrees aborted by watchdog at position %d", motor->hopper + 1, degrees, -finalPosition);
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  if (moveCancelled) {
+    sprintf(logMessageBuffer, "Motor %hhu move by %d degrees cancelled at position %d", motor->hopper + 1, degrees, -finalPosition);
+    logMessage(motor->feeder, WARNING, logMessageBuffer);
+    return 1;
+  }
+
+  if (state == MOTOR_STATE_FAULT) {
+    metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_MOTOR_FAULTS);
+    sprintf(logMessageBuffer, "Motor %hhu fault: jam not cleared after %d retries, stopped at %d of %d ticks",
+      motor->hopper + 1, MOTOR_JAM_MAX_ATTEMPTS, -finalPosition, targetPosition);
+    logMessage(motor->feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+
+  if (jams > 0) {
+    sprintf(logMessageBuffer, "Motor %hhu reached position. Rotated by %d degrees after %hhu jams", motor->hopper + 1, degrees, jams);
+    logMessage(motor->feeder, WARNING, logMessageBuffer);
   } else {
-  sprintf(logMessageBuffer, "Motor reached position. Rotated by %d degrees", degrees);
-  logMessage(INFO, logMessageBuffer);
+  sprintf(logMessageBuffer, "Motor %hhu reached position. Rotated by %d degrees", motor->hopper + 1, degrees);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+  }
+
+  uint64_t illegalTransitions = metricsGetHopperCounter(motor->feeder, motor->hopper, METRIC_ENCODER_ILLEGAL_TRANSITIONS) - moveStartIllegal;
+  if (illegalTransitions > 0) {
+    sprintf(logMessageBuffer, "Encoder %hhu skipped states %llu times during the move", motor->hopper + 1, (unsigned long long)illegalTransitions);
+    logMessage(motor->feeder, WARNING, logMessageBuffer);
   }
+
+  sprintf(logMessageBuffer, "Move settled in %u ms, planned %u ms, overshoot %.1f degrees, peak %.0f deg/s",
+    settleTime, plannedTime, overshoot / ticksPerDegree, peakVelocity / ticksPerDegree);
+  logMessage(motor->feeder, INFO, logMessageBuffer);
+
+  return 0;
+}
+
+
+/*******************************************************************************
+* getEncoderPosition
+*
+* @brief Returns the current encoder position of a motor
+*
+* @param[in] motor The motor
+*
+* @return The absolute encoder position in ticks
+*******************************************************************************/
+int64_t getEncoderPosition(motorS *motor) {
+  return atomic_load(&motor->encoderPosition);
 }
 
 /*******************************************************************************
-* encoderAISR
+* initVelocityEstimator
+*
+* @brief Starts a velocity estimate from the last encoder edge of a motor
 *
-* @brief ISR for the channel A of the motor encoder. Modifies the motor position
-*        value
+* @param[in] motor The motor
+* @param[out] estimator The estimator to initialize
 *******************************************************************************/
-void encoderAISR() {
-  if (digitalRead(MOTOR_ENCODER_B) != digitalRead(MOTOR_ENCODER_A)) {
-    encoderPosition++;
-  } else {
-    encoderPosition--;
+void initVelocityEstimator(motorS *motor, velocityEstimatorS *estimator) {
+  uint64_t timing = atomic_load(&motor->encoderEdgeTiming);
+  estimator->prevEdgeTime = timing >> 32;
+  estimator->prevEdgeCount = (int32_t)(uint32_t)timing;
+  estimator->velocity = 0;
+  motor->encoderVelocity = 0;
+}
+
+/*******************************************************************************
+* updateVelocityEstimator
+*
+* @brief Estimates the encoder velocity, called once per control period. At low
+*        speed at most one edge arrives per period, so the velocity is measured
+*        from the period between the last two edges. At high speed the edges
+*        since the previous update are counted and divided by the time between
+*        their timestamps, which doesn't depend on when the ISRs ran. The two
+*        estimates are blended by the number of counted edges
+*
+* @param[in] motor The motor
+* @param[in,out] estimator The estimator to update
+*
+* @return The estimated velocity [ticks/s], signed like the encoder position
+*******************************************************************************/
+float updateVelocityEstimator(motorS *motor, velocityEstimatorS *estimator) {
+  uint32_t now = micros();
+  uint64_t timing = atomic_load(&motor->encoderEdgeTiming);
+  uint32_t edgeTime = timing >> 32;
+  int32_t edgeCount = (int32_t)(uint32_t)timing;
+  int32_t edgePeriod = atomic_load(&motor->encoderEdgePeriod);
+
+  // Period measurement. The motor can't be faster than one edge per time since
+  // the last edge, so the estimate decays while no edges arrive
+  float periodVelocity = 0;
+  uint32_t sinceEdge = now - edgeTime;
+  if (edgePeriod != 0 && sinceEdge < MOTOR_VELOCITY_TIMEOUT * 1000) {
+    uint32_t period = abs(edgePeriod);
+    if (sinceEdge > period) period = sinceEdge;
+    periodVelocity = (edgePeriod > 0 ? 1.0e6 : -1.0e6) / period;
+  }
+
+  // Edge counting between the edge timestamps
+  int32_t edges = edgeCount - estimator->prevEdgeCount;
+  uint32_t edgeSpan = edgeTime - estimator->prevEdgeTime;
+  float countVelocity = edges != 0 && edgeSpan > 0 ? edges * 1.0e6 / edgeSpan : 0;
+
+  float weight = fminf(1.0, abs(edges) / (float)MOTOR_VELOCITY_BLEND_EDGES);
+  estimator->velocity = weight * countVelocity + (1 - weight) * periodVelocity;
+  if (edges != 0) {
+    estimator->prevEdgeCount = edgeCount;
+    estimator->prevEdgeTime = edgeTime;
   }
+
+  motor->encoderVelocity = estimator->velocity;
+
+  return estimator->velocity;
 }
 
 /*******************************************************************************
-* encoderBISR
+* getEncoderVelocity
+*
+* @brief Returns the last velocity estimate of the control loop of a motor
 *
-* @brief ISR for the channel B of the motor encoder. Modifies the motor position
-*        value
+* @param[in] motor The motor
+*
+* @return The encoder velocity [ticks/s]
 *******************************************************************************/
-void encoderBISR() {
-  if (digitalRead(MOTOR_ENCODER_A) == digitalRead(MOTOR_ENCODER_B)) {
-    encoderPosition++;
-  } else {
-    encoderPosition--;
+float getEncoderVelocity(motorS *motor) {
+  return motor->encoderVelocity;
+}
+
+/*******************************************************************************
+* getMotorOutput
+*
+* @brief Returns the last output written to the driver of a motor
+*
+* @param[in] motor The motor
+*
+* @return The signed PWM output
+*******************************************************************************/
+int32_t getMotorOutput(motorS *motor) {
+  return motor->output;
+}
+
+/*******************************************************************************
+* setMotorStopRequest
+*
+* @brief Requests the current and every following move of a motor to stop at
+*        once until the request is cleared. Safe to call from any thread
+*
+* @param[in] motor The motor
+* @param[in] isRequested Whether or not moves should stop
+*******************************************************************************/
+void setMotorStopRequest(motorS *motor, bool isRequested) {
+  atomic_store(&motor->isStopRequested, isRequested);
+}
+
+/*******************************************************************************
+* getMotorStepsCompleted
+*
+* @brief Returns the step boundaries the current move of a motor passed so far,
+*        e.g. the portions of a batch feed. Safe to call from any thread
+*
+* @param[in] motor The motor
+*
+* @return The completed steps of the current move, 0 if no move is running
+*******************************************************************************/
+uint16_t getMotorStepsCompleted(motorS *motor) {
+  return atomic_load(&motor->stepsCompleted);
+}
+
+/*******************************************************************************
+* getLastMoveResult
+*
+* @brief Returns the result of the last finished move of a motor
+*
+* @param[in] motor The motor
+*
+* @return Timing and accuracy of the last move
+*******************************************************************************/
+motorMoveResultS getLastMoveResult(motorS *motor) {
+  return motor->lastMoveResult;
+}
+
+/*******************************************************************************
+* readEncoderState
+*
+* @brief Reads both channels of the encoder of a motor
+*
+* @param[in] motor The motor
+*
+* @return The AB state of the encoder, channel A in bit 1 and channel B in bit 0
+*******************************************************************************/
+uint8_t readEncoderState(motorS *motor) {
+  return (digitalRead(motor->pins.encoderA) << 1) | digitalRead(motor->pins.encoderB);
+}
+
+/*******************************************************************************
+* updateEncoder
+*
+* @brief Decodes the transition from the previous to the current AB state and
+*        updates the motor position. Both ISRs read the full AB state, so the
+*        second ISR of the same edge sees no change and the decoded direction
+*        doesn't depend on which channel triggered it. The same holds for the
+*        polling thread. A skipped state is counted as two steps in the
+*        direction of the last edge while the wheel moves, a late ISR or sample
+*        at full speed doesn't lose counts
+*
+* @param[in] motor The motor
+* @param[in] state The current AB state of the encoder
+*
+* @return The decoded step, 0 if the state didn't change or skipped a state
+*         while the wheel was at rest
+*******************************************************************************/
+int8_t updateEncoder(motorS *motor, uint8_t state) {
+  uint8_t prevState = atomic_exchange(&motor->encoderState, state);
+  int8_t step = quadratureTable[(prevState << 2) | state];
+
+  if (step == QUADRATURE_ILLEGAL) {
+    metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_ENCODER_ILLEGAL_TRANSITIONS);
+
+    // A state skipped while the wheel moves is two steps in its direction
+    int32_t edgePeriod = atomic_load(&motor->encoderEdgePeriod);
+    uint32_t sinceEdge = micros() - (uint32_t)(atomic_load(&motor->encoderEdgeTiming) >> 32);
+    if (edgePeriod == 0 || sinceEdge >= MOTOR_VELOCITY_TIMEOUT * 1000) return 0;
+    step = edgePeriod > 0 ? 2 : -2;
+  }
+
+  if (step != 0) {
+    atomic_fetch_add(&motor->encoderPosition, step);
+
+    // Timestamp the edge for the velocity estimate
+    uint32_t now = micros();
+    uint64_t prevTiming = atomic_load(&motor->encoderEdgeTiming);
+    uint64_t timing;
+    do {
+      timing = (uint64_t)now << 32 | (uint32_t)((int32_t)(uint32_t)prevTiming + step);
+    } while (!atomic_compare_exchange_weak(&motor->encoderEdgeTiming, &prevTiming, timing));
+
+    uint32_t period = (now - (uint32_t)(prevTiming >> 32)) / abs(step);
+    if (period > INT32_MAX) period = INT32_MAX;
+    atomic_store(&motor->encoderEdgePeriod, (step > 0 ? 1 : -1) * (int32_t)period);
   }
-}
\ No newline at end of file
+
+  return step;
+}
+
+/*******************************************************************************
+* encoderISR
+*
+* @brief ISR for both channels of the encoder of a motor. Modifies the motor
+*        position value
+*
+* @param[in] motor The motor
+*******************************************************************************/
+void encoderISR(motorS *motor) {
+  metricsHopperIncrement(motor->feeder, motor->hopper, METRIC_ENCODER_EDGES);
+  updateEncoder(motor, readEncoderState(motor));
+}
+
+/*******************************************************************************
+* encoder1ISR
+*
+* @brief ISR for the encoder of the first motor
+*******************************************************************************/
+void encoder1ISR() {
+  encoderISR(getInterruptMotor(0));
+}
+
+/*******************************************************************************
+* encoder2ISR
+*
+* @brief ISR for the encoder of the second motor
+*******************************************************************************/
+void encoder2ISR() {
+  encoderISR(getInterruptMotor(HOPPERS_COUNT - 1));
+}
@@ -2,11 +2,169 @@
 #define interrupts_h
 
 #include <stdint.h>
+#include <time.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "motion.h"
+#include "../config.h"
 
-uint8_t initMotor();
-void driveMotor(int32_t speed);
-void rotateMotor(int32_t degrees);
-void encoderAISR();
-void encoderBISR();
+typedef struct feederS feederS; // Defined in context.h
+
+#define MOTOR_WHEEL_CONFIGS 3
+#define HOPPERS_MAX 2 // The MDD3A drives two motors
+
+#if HOPPERS_COUNT < 1 || HOPPERS_COUNT > HOPPERS_MAX
+#error "HOPPERS_COUNT must be 1 or 2"
+#endif
+
+typedef enum {
+  MOTOR_STATE_MOVING, // Tracking the profile to the target
+  MOTOR_STATE_DWELLING, // Holding at a step boundary
+  MOTOR_STATE_REVERSING, // Backing off after a jam
+  MOTOR_STATE_PAUSING, // Stopped between reversing and retrying
+  MOTOR_STATE_SETTLED, // Target reached
+  MOTOR_STATE_FAULT, // Jam not cleared, move given up
+  MOTOR_STATES_COUNT
+} motorStateE;
+
+typedef enum {
+  MOTOR_BRAKE_COAST, // Motor terminals left open when stopping
+  MOTOR_BRAKE_FULL, // Motor terminals shorted when stopping
+  MOTOR_BRAKE_PROPORTIONAL, // Shorted when stopping, proportional braking instead of reversing near the target
+  MOTOR_BRAKE_MODES_COUNT
+} motorBrakeModeE;
+
+typedef enum {
+  MOTOR_FORWARD, // Positive output, the encoder counts down
+  MOTOR_REVERSE, // Negative output
+  MOTOR_DIRECTIONS_COUNT
+} motorDirectionE;
+
+typedef struct motorFrictionS {
+  float breakAway; // Duty at which the motor starts moving, fraction of the PWM range
+  float coulomb; // Duty below which the moving motor stops, fraction of the PWM range
+} motorFrictionS;
+
+typedef struct motorGainsS {
+  uint8_t wheelArms; // Wheel configuration the gains apply to
+  float kp; // Proportional gain
+  float ki; // Integral gain
+  float kd; // Derivative gain
+} motorGainsS;
+
+typedef struct motorMoveResultS {
+  int32_t degrees; // Requested rotation
+  uint32_t settleTime; // Time until the move settled [ms]
+  uint32_t plannedTime; // Duration of the planned profile [ms]
+  uint64_t startTime; // Wall clock when the motor was first driven, 0 if it never was [ms]
+  float overshoot; // Largest excursion past the target [deg]
+  float peakVelocity; // Highest estimated velocity [deg/s]
+  uint16_t steps; // Steps the move was made of
+  uint16_t stepsCompleted; // Step boundaries the wheel passed
+  int32_t finalError; // Distance from the target at the end of the move [ticks]
+  uint8_t jams; // Number of jams detected during the move
+  bool isFaulted; // Whether or not the move was given up after MOTOR_JAM_MAX_ATTEMPTS
+  bool isAborted; // Whether or not the watchdog aborted the move
+  bool isCancelled; // Whether or not the move was stopped on request
+} motorMoveResultS;
+
+typedef struct velocityEstimatorS {
+  int32_t prevEdgeCount; // Step sum at the last edge seen by the previous update
+  uint32_t prevEdgeTime; // Time of the last edge seen by the previous update [us]
+  float velocity; // Last estimate [ticks/s]
+} velocityEstimatorS;
+
+typedef struct motorConfigS {
+  motorGainsS gains[MOTOR_WHEEL_CONFIGS]; // Gains of every feeding wheel
+  uint16_t controlRate; // Control loop rate [Hz]
+  motorBrakeModeE brakeMode; // How the motor is stopped and slowed down
+  float ticksPerRevolution; // Encoder ticks per revolution of the wheel
+  motorFrictionS friction[MOTOR_DIRECTIONS_COUNT]; // Friction compensation of both directions
+  motionLimitsS limits[MOTOR_WHEEL_CONFIGS]; // Motion limits of every feeding wheel
+} motorConfigS;
+
+typedef struct motorPinsS {
+  int8_t inputA; // Driver input driven to reverse
+  int8_t inputB; // Driver input driven to go forward
+  int8_t encoderA;
+  int8_t encoderB;
+  int8_t index; // Index sensor, -1 if not mounted
+  bool isSoftPwm; // Whether or not the inputs are driven by software PWM
+} motorPinsS;
+
+// Motor, encoder and wheel of a hopper. Every hopper has its own control loop,
+// so the state of a move is only written by the thread running it and by the
+// encoder ISRs and the polling thread of its own encoder
+typedef struct motorS {
+  feederS *feeder; // Feeder the motor belongs to
+  uint8_t hopper; // Index of the hopper the motor belongs to
+  motorPinsS pins;
+  motorConfigS config;
+  char configFile[FEEDER_FILE_NAME_LENGTH];
+  char positionFile[FEEDER_FILE_NAME_LENGTH];
+  void (*encoderISR)(void); // ISR of both encoder channels
+  // Absolute position of the wheel, kept across moves and restarts so the arms
+  // stay on their boundaries
+  atomic_llong encoderPosition;
+  atomic_uchar encoderState; // Last decoded AB state
+  // Time of the last edge [us] in the upper half and the sum of all steps up to
+  // that edge in the lower half. Packed so the control loop always reads a
+  // consistent pair, the sum is never reset together with the position
+  atomic_uint_fast64_t encoderEdgeTiming;
+  atomic_int encoderEdgePeriod; // Time between the last two edges [us], signed with the direction
+  atomic_int encoderMode; // Mode currently counting the edges, encoderModeE
+  atomic_int encoderRequestedMode;
+  atomic_llong encoderIndexPositions[ENCODER_CALIBRATION_REVOLUTIONS + 1]; // Encoder position at every index pulse
+  atomic_uint encoderIndexPulses;
+  volatile float encoderVelocity; // Last estimate of the control loop [ticks/s]
+  volatile int32_t output;
+  motorMoveResultS lastMoveResult;
+  atomic_bool isStopRequested; // Ends the current move at once, e.g. a cancelled feed
+  atomic_uint stepsCompleted; // Step boundaries passed by the current move, 0 between moves
+} motorS;
+
+uint8_t initMotor(feederS *feeder);
+motorS *getMotor(feederS *feeder, uint8_t hopper);
+motorS *getInterruptMotor(uint8_t hopper);
+int8_t saveMotorConfig(motorS *motor);
+int8_t loadMotorConfig(motorS *motor);
+int8_t saveWheelPosition(motorS *motor);
+int8_t loadWheelPosition(motorS *motor);
+motorGainsS *getMotorGains(motorS *motor, uint8_t wheelArms);
+void setMotorGains(motorS *motor, uint8_t wheelArms, float kp, float ki, float kd);
+motionLimitsS *getMotorLimits(motorS *motor, uint8_t wheelArms);
+void setMotorLimits(motorS *motor, uint8_t wheelArms, float maxVelocity, float maxAcceleration, float maxJerk);
+uint16_t getMotorControlRate(motorS *motor);
+void setMotorControlRate(motorS *motor, uint16_t rate);
+motorBrakeModeE getMotorBrakeMode(motorS *motor);
+void setMotorBrakeMode(motorS *motor, motorBrakeModeE mode);
+const char *getMotorBrakeModeName(motorBrakeModeE mode);
+float getEncoderTicksPerDegree(motorS *motor);
+void setEncoderTicksPerRevolution(motorS *motor, float ticks);
+motorFrictionS *getMotorFriction(motorS *motor, motorDirectionE direction);
+void setMotorFriction(motorS *motor, motorDirectionE direction, float breakAway, float coulomb);
+float compensateFriction(motorS *motor, float output, float referenceVelocity, float velocity, bool isApproaching);
+void waitForNextPeriod(motorS *motor, struct timespec *deadline, uint32_t periodNs);
+void driveMotor(motorS *motor, int32_t speed);
+void brakeMotor(motorS *motor, int32_t strength);
+void stopMotor(motorS *motor);
+uint8_t rotateMotor(motorS *motor, int32_t degrees);
+int64_t wheelBoundary(motorS *motor, int64_t boundary, int32_t stepDegrees);
+int32_t stepBoundary(motorS *motor, int64_t startBoundary, uint16_t step, int32_t stepDegrees, int64_t moveOrigin);
+uint8_t rotateMotorInSteps(motorS *motor, int32_t degrees, int32_t stepDegrees, uint16_t dwell);
+void planMotorSegment(motorS *motor, motionProfileS *profile, motionLimitsS *limits, int32_t distance);
+int64_t getEncoderPosition(motorS *motor);
+int32_t getMotorOutput(motorS *motor);
+void initVelocityEstimator(motorS *motor, velocityEstimatorS *estimator);
+float updateVelocityEstimator(motorS *motor, velocityEstimatorS *estimator);
+float getEncoderVelocity(motorS *motor);
+void setMotorStopRequest(motorS *motor, bool isRequested);
+uint16_t getMotorStepsCompleted(motorS *motor);
+motorMoveResultS getLastMoveResult(motorS *motor);
+uint8_t readEncoderState(motorS *motor);
+int8_t updateEncoder(motorS *motor, uint8_t state);
+void encoderISR(motorS *motor);
+void encoder1ISR();
+void encoder2ISR();
 
 #endif // interrupts_h
\ No newline at end of file
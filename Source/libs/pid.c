@@ -0,0 +1,74 @@
+#include "pid.h"
+
+/*******************************************************************************
+* pidInit
+*
+* @brief Initializes the PID controller gains and limits and resets its state
+*
+* @param[in] pid The controller to initialize
+* @param[in] kp Proportional gain
+* @param[in] ki Integral gain
+* @param[in] kd Derivative gain
+* @param[in] derivativeFilter Time constant of the derivative filter [s]
+* @param[in] outputLimit Output saturation limit
+*******************************************************************************/
+void pidInit(pidS *pid, float kp, float ki, float kd, float derivativeFilter, float outputLimit) {
+  pid->kp = kp;
+  pid->ki = ki;
+  pid->kd = kd;
+  pid->derivativeFilter = derivativeFilter;
+  pid->outputLimit = outputLimit;
+
+  pidReset(pid);
+}
+
+/*******************************************************************************
+* pidReset
+*
+* @brief Clears the integral and derivative state, keeps the gains
+*
+* @param[in] pid The controller to reset
+*******************************************************************************/
+void pidReset(pidS *pid) {
+  pid->integral = 0;
+  pid->derivative = 0;
+}
+
+/*******************************************************************************
+* pidUpdateWithRate
+*
+* @brief Calculates the controller output for the next period with a measured
+*        rate of change of the error instead of differentiating the error.
+*        The rate is low-pass filtered. The integral is frozen while the output
+*        is saturated in the direction of the error (anti-windup)
+*
+* @param[in] pid The controller to update
+* @param[in] error The current error
+* @param[in] errorRate The current rate of change of the error [1/s]
+* @param[in] deltaT Time since the previous update [s]
+*
+* @return The saturated controller output
+*******************************************************************************/
+float pidUpdateWithRate(pidS *pid, float error, float errorRate, float deltaT) {
+  if (deltaT <= 0) return 0;
+
+  // Derivative
+  float alpha = deltaT / (pid->derivativeFilter + deltaT);
+  pid->derivative += alpha * (errorRate - pid->derivative);
+
+  // Integral, only kept if it doesn't push the output further into saturation
+  float integral = pid->integral + error * deltaT;
+  float output = pid->kp * error + pid->ki * integral + pid->kd * pid->derivative;
+
+  if ((output > pid->outputLimit && error > 0) || (output < -pid->outputLimit && error < 0)) {
+    output = pid->kp * error + pid->ki * pid->integral + pid->kd * pid->derivative;
+  } else {
+    pid->integral = integral;
+  }
+
+  // Output saturation
+  if (output > pid->outputLimit) output = pid->outputLimit;
+  if (output < -pid->outputLimit) output = -pid->outputLimit;
+
+  return output;
+}
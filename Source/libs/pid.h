@@ -0,0 +1,18 @@
+#ifndef pid_h
+#define pid_h
+
+typedef struct pidS {
+  float kp; // Proportional gain
+  float ki; // Integral gain
+  float kd; // Derivative gain
+  float derivativeFilter; // Time constant of the derivative low-pass filter [s]
+  float outputLimit; // Output saturates at +/- this value
+  float integral; // Accumulated integral of the error
+  float derivative; // Filtered derivative of the error
+} pidS;
+
+void pidInit(pidS *pid, float kp, float ki, float kd, float derivativeFilter, float outputLimit);
+void pidReset(pidS *pid);
+float pidUpdateWithRate(pidS *pid, float error, float errorRate, float deltaT);
+
+#endif // pid_h
@@ -0,0 +1,410 @@
+#include "schedule.h"
+#include <stdlib.h>
+#include <string.h>
+
+/*******************************************************************************
+* compareFeedingTimes
+*
+* @brief Orders feeding times by time of the day, weekdays and dates. Feeding
+*        times equal in all of them are duplicates
+*
+* @param[in] a First feeding time
+* @param[in] b Second feeding time
+*
+* @return -1 if a comes first, 1 if b comes first, 0 if they are equal
+*******************************************************************************/
+int8_t compareFeedingTimes(const feedingTimeS *a, const feedingTimeS *b) {
+  uint16_t minuteA = a->hour * 60 + a->minute;
+  uint16_t minuteB = b->hour * 60 + b->minute;
+
+  if (minuteA != minuteB) return minuteA < minuteB ? -1 : 1;
+  if (a->weekdays != b->weekdays) return a->weekdays > b->weekdays ? -1 : 1;
+  if (a->firstDate != b->firstDate) return a->firstDate < b->firstDate ? -1 : 1;
+  if (a->lastDate != b->lastDate) return a->lastDate < b->lastDate ? -1 : 1;
+
+  return 0;
+}
+
+/*******************************************************************************
+* isFeedingTimeActive
+*
+* @brief Checks whether or not a feeding time applies to a day
+*
+* @param[in] entry The feeding time
+* @param[in] date The day as YYYYMMDD
+* @param[in] weekday Day of the week, 0 is Sunday
+*
+* @return True if the feeding time is due on that day
+*******************************************************************************/
+bool isFeedingTimeActive(const feedingTimeS *entry, uint32_t date, uint8_t weekday) {
+  return (entry->weekdays & (1 << weekday)) &&
+    (entry->firstDate == 0 || date >= entry->firstDate) &&
+    (entry->lastDate == 0 || date <= entry->lastDate);
+}
+
+/*******************************************************************************
+* feedingTimePriority
+*
+* @brief Returns how specific a feeding time is. Of feeding times due in the
+*        same minute the most specific one is fed, so a feeding time limited
+*        to some dates or weekdays overrides the portions of an everyday one
+*
+* @param[in] entry The feeding time
+*
+* @return Higher for more specific feeding times
+*******************************************************************************/
+uint8_t feedingTimePriority(const feedingTimeS *entry) {
+  uint8_t priority = 7 - __builtin_popcount(entry->weekdays);
+  if (entry->firstDate != 0 || entry->lastDate != 0) priority += 8;
+
+  return priority;
+}
+
+/*******************************************************************************
+* scheduleSize
+*
+* @brief Returns the number of feeding times in a schedule tree
+*
+* @param[in] root Root of the schedule tree
+*
+* @return The number of feeding times
+*******************************************************************************/
+uint32_t scheduleSize(const scheduleNodeS *root) {
+  return root != NULL ? root->size : 0;
+}
+
+/*******************************************************************************
+* scheduleHeight
+*
+* @brief Returns the height of a subtree, 0 for an empty one
+*
+* @param[in] node Root of the subtree
+*
+* @return The height of the subtree
+*******************************************************************************/
+uint8_t scheduleHeight(const scheduleNodeS *node) {
+  return node != NULL ? node->height : 0;
+}
+
+/*******************************************************************************
+* scheduleUpdate
+*
+* @brief Recomputes the height and the size of a node from its children
+*
+* @param[in,out] node The node to update
+*******************************************************************************/
+void scheduleUpdate(scheduleNodeS *node) {
+  uint8_t left = scheduleHeight(node->left);
+  uint8_t right = scheduleHeight(node->right);
+
+  node->height = (left > right ? left : right) + 1;
+  node->size = scheduleSize(node->left) + scheduleSize(node->right) + 1;
+}
+
+/*******************************************************************************
+* scheduleRotateRight
+*
+* @brief Rotates a subtree to the right, the left child becomes its root
+*
+* @param[in] node Root of the subtree
+*
+* @return The new root of the subtree
+*******************************************************************************/
+scheduleNodeS *scheduleRotateRight(scheduleNodeS *node) {
+  scheduleNodeS *left = node->left;
+  node->left = left->right;
+  left->right = node;
+  scheduleUpdate(node);
+  scheduleUpdate(left);
+
+  return left;
+}
+
+/*******************************************************************************
+* scheduleRotateLeft
+*
+* @brief Rotates a subtree to the left, the right child becomes its root
+*
+* @param[in] node Root of the subtree
+*
+* @return The new root of the subtree
+*******************************************************************************/
+scheduleNodeS *scheduleRotateLeft(scheduleNodeS *node) {
+  scheduleNodeS *right = node->right;
+  node->right = right->left;
+  right->left = node;
+  scheduleUpdate(node);
+  scheduleUpdate(right);
+
+  return right;
+}
+
+/*******************************************************************************
+* scheduleBalance
+*
+* @brief Restores the AVL balance of a node after one of its subtrees changed
+*
+* @param[in] node The node to balance
+*
+* @return The new root of the subtree
+*******************************************************************************/
+scheduleNodeS *scheduleBalance(scheduleNodeS *node) {
+  scheduleUpdate(node);
+  int8_t balance = scheduleHeight(node->left) - scheduleHeight(node->right);
+
+  if (balance > 1) {
+    if (scheduleHeight(node->left->left) < scheduleHeight(node->left->right)) {
+      node->left = scheduleRotateLeft(node->left);
+    }
+    return scheduleRotateRight(node);
+  }
+
+  if (balance < -1) {
+    if (scheduleHeight(node->right->right) < scheduleHeight(node->right->left)) {
+      node->right = scheduleRotateRight(node->right);
+    }
+    return scheduleRotateLeft(node);
+  }
+
+  return node;
+}
+
+/*******************************************************************************
+* scheduleInsert
+*
+* @brief Adds a feeding time to the schedule in O(log n)
+*
+* @param[in,out] root Root of the schedule tree
+* @param[in] entry The feeding time to add
+*
+* @return 0 on success, -1 if the feeding time is a duplicate or out of memory
+*******************************************************************************/
+int8_t scheduleInsert(scheduleNodeS **root, const feedingTimeS *entry) {
+  if (*root == NULL) {
+    scheduleNodeS *node = calloc(1, sizeof(scheduleNodeS));
+    if (node == NULL) return -1;
+
+    node->entry = *entry;
+    node->height = 1;
+    node->size = 1;
+    *root = node;
+    return 0;
+  }
+
+  int8_t order = compareFeedingTimes(entry, &(*root)->entry);
+  if (order == 0) return -1;
+
+  if (scheduleInsert(order < 0 ? &(*root)->left : &(*root)->right, entry) != 0) return -1;
+  *root = scheduleBalance(*root);
+
+  return 0;
+}
+
+/*******************************************************************************
+* scheduleRemove
+*
+* @brief Removes a feeding time from the schedule in O(log n)
+*
+* @param[in,out] root Root of the schedule tree
+* @param[in] entry The feeding time to remove
+*
+* @return 0 on success, -1 if the feeding time isn't in the schedule
+*******************************************************************************/
+int8_t scheduleRemove(scheduleNodeS **root, const feedingTimeS *entry) {
+  if (*root == NULL) return -1;
+
+  scheduleNodeS *node = *root;
+  int8_t order = compareFeedingTimes(entry, &node->entry);
+
+  if (order != 0) {
+    if (scheduleRemove(order < 0 ? &node->left : &node->right, entry) != 0) return -1;
+    *root = scheduleBalance(node);
+    return 0;
+  }
+
+  if (node->left == NULL || node->right == NULL) {
+    *root = node->left != NULL ? node->left : node->right;
+    free(node);
+    return 0;
+  }
+
+  // Replace by the first feeding time of the right subtree
+  scheduleNodeS *successor = node->right;
+  while (successor->left != NULL) successor = successor->left;
+  node->entry = successor->entry;
+  scheduleRemove(&node->right, &node->entry);
+  *root = scheduleBalance(node);
+
+  return 0;
+}
+
+/*******************************************************************************
+* scheduleFind
+*
+* @brief Looks a feeding time up in O(log n)
+*
+* @param[in] root Root of the schedule tree
+* @param[in] entry Feeding time with the time, weekdays and dates to look for
+*
+* @return The feeding time in the schedule or NULL if there is none
+*******************************************************************************/
+feedingTimeS *scheduleFind(scheduleNodeS *root, const feedingTimeS *entry) {
+  while (root != NULL) {
+    int8_t order = compareFeedingTimes(entry, &root->entry);
+    if (order == 0) return &root->entry;
+
+    root = order < 0 ? root->left : root->right;
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* scheduleSelect
+*
+* @brief Returns the feeding time at a position of the ordered schedule in
+*        O(log n)
+*
+* @param[in] root Root of the schedule tree
+* @param[in] index Position of the feeding time
+*
+* @return The feeding time or NULL if the index is out of the schedule
+*******************************************************************************/
+feedingTimeS *scheduleSelect(scheduleNodeS *root, uint32_t index) {
+  while (root != NULL) {
+    uint32_t leftSize = scheduleSize(root->left);
+    if (index == leftSize) return &root->entry;
+
+    if (index < leftSize) {
+      root = root->left;
+    } else {
+      index -= leftSize + 1;
+      root = root->right;
+    }
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* scheduleClear
+*
+* @brief Removes all feeding times from the schedule
+*
+* @param[in,out] root Root of the schedule tree
+*******************************************************************************/
+void scheduleClear(scheduleNodeS **root) {
+  if (*root == NULL) return;
+
+  scheduleClear(&(*root)->left);
+  scheduleClear(&(*root)->right);
+  free(*root);
+  *root = NULL;
+}
+
+/*******************************************************************************
+* scheduleCompileNode
+*
+* @brief Adds the feeding times of a subtree due on a day to the compiled day,
+*        a feeding time replaces a less specific one in the same minute
+*
+* @param[in] node Root of the subtree
+* @param[in] date The day as YYYYMMDD
+* @param[in] weekday Day of the week, 0 is Sunday
+* @param[in,out] day The compiled day
+* @param[in,out] priorities Priority of the feeding time set in every minute
+*******************************************************************************/
+void scheduleCompileNode(const scheduleNodeS *node, uint32_t date, uint8_t weekday, scheduleDayS *day,
+                         uint8_t *priorities) {
+  if (node == NULL) return;
+
+  scheduleCompileNode(node->left, date, weekday, day, priorities);
+
+  const feedingTimeS *entry = &node->entry;
+  if (isFeedingTimeActive(entry, date, weekday)) {
+    uint16_t minute = entry->hour * 60 + entry->minute;
+    uint8_t priority = feedingTimePriority(entry) + 1;
+
+    if (priority > priorities[minute]) {
+      priorities[minute] = priority;
+      day->minutes[minute / 64] |= 1ULL << (minute % 64);
+      day->portions[minute] = entry->portions;
+      day->modes[minute] = entry->mode;
+    }
+  }
+
+  scheduleCompileNode(node->right, date, weekday, day, priorities);
+}
+
+/*******************************************************************************
+* scheduleCompileDay
+*
+* @brief Compiles the feeding times due on a day into a minute bitset and a
+*        portion table. Runs in O(n) once per day and after changes of the
+*        schedule, the lookups in the compiled day don't depend on the size of
+*        the schedule
+*
+* @param[in] root Root of the schedule tree
+* @param[in] date The day as YYYYMMDD
+* @param[in] weekday Day of the week, 0 is Sunday
+* @param[out] day The compiled day
+*******************************************************************************/
+void scheduleCompileDay(const scheduleNodeS *root, uint32_t date, uint8_t weekday, scheduleDayS *day) {
+  uint8_t priorities[SCHEDULE_DAY_MINUTES] = {0};
+
+  memset(day->minutes, 0, sizeof(day->minutes));
+  day->date = date;
+  scheduleCompileNode(root, date, weekday, day, priorities);
+}
+
+/*******************************************************************************
+* scheduleNextMinute
+*
+* @brief Finds the first feeding of a compiled day from a minute on
+*
+* @param[in] day The compiled day
+* @param[in] from First minute of the day to look at
+*
+* @return The minute of the day of the feeding or -1 if there is none
+*******************************************************************************/
+int16_t scheduleNextMinute(const scheduleDayS *day, uint16_t from) {
+  if (from >= SCHEDULE_DAY_MINUTES) return -1;
+
+  uint16_t word = from / 64;
+  uint64_t bits = day->minutes[word] & (~0ULL << (from % 64));
+
+  while (bits == 0) {
+    if (++word >= SCHEDULE_DAY_WORDS) return -1;
+    bits = day->minutes[word];
+  }
+
+  return word * 64 + __builtin_ctzll(bits);
+}
+
+/*******************************************************************************
+* scheduleCountMinutes
+*
+* @brief Counts the feedings of a compiled day within a range of minutes
+*
+* @param[in] day The compiled day
+* @param[in] from First minute of the range
+* @param[in] to Minute after the range
+*
+* @return The number of feedings
+*******************************************************************************/
+uint16_t scheduleCountMinutes(const scheduleDayS *day, uint16_t from, uint16_t to) {
+  uint16_t count = 0;
+
+  if (to > SCHEDULE_DAY_MINUTES) to = SCHEDULE_DAY_MINUTES;
+  if (from >= to) return 0;
+
+  for (uint16_t word = from / 64; word <= (to - 1) / 64; word++) {
+    uint64_t bits = day->minutes[word];
+    if (word == from / 64) bits &= ~0ULL << (from % 64);
+    if (word == (to - 1) / 64 && to % 64 != 0) bits &= (1ULL << (to % 64)) - 1;
+
+    count += __builtin_popcountll(bits);
+  }
+
+  return count;
+}
@@ -0,0 +1,60 @@
+#ifndef schedule_h
+#define schedule_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SCHEDULE_DAY_MINUTES 1440
+#define SCHEDULE_DAY_WORDS ((SCHEDULE_DAY_MINUTES + 63) / 64)
+#define SCHEDULE_ALL_DAYS 0x7F
+
+typedef enum {
+  FEED_MODE_SEPARATE, // Every portion is a separate move
+  FEED_MODE_BATCH, // All portions in a single move
+  FEED_MODE_DWELL, // All portions in a single move, holding at every arm
+  FEED_MODES_COUNT
+} feedModeE;
+
+typedef struct feedingTimeS {
+  uint8_t hour; // Hour of the feeding time
+  uint8_t minute; // Minute of the feeding time
+  uint8_t portions; // Number of portions to feed in the feed
+  feedModeE mode; // How the portions are dispensed
+  uint8_t weekdays; // Days of the week the feeding time applies to, bit 0 is Sunday like tm_wday
+  uint32_t firstDate; // First day the feeding time applies to as YYYYMMDD, 0 for no limit
+  uint32_t lastDate; // Last day the feeding time applies to as YYYYMMDD, 0 for no limit
+} feedingTimeS;
+
+// Node of the AVL tree holding the schedule, ordered by time of the day, then
+// by weekdays and dates. Every node knows the size of its subtree, so the n-th
+// feeding time is found in O(log n) like an insert or a removal
+typedef struct scheduleNodeS {
+  feedingTimeS entry;
+  struct scheduleNodeS *left;
+  struct scheduleNodeS *right;
+  uint8_t height;
+  uint32_t size;
+} scheduleNodeS;
+
+// Feeding times of a single day compiled into a bitset with a bit for every
+// minute of the day and the portions and mode of the set minutes
+typedef struct scheduleDayS {
+  uint32_t date; // Compiled day as YYYYMMDD, 0 if not compiled
+  uint64_t minutes[SCHEDULE_DAY_WORDS];
+  uint8_t portions[SCHEDULE_DAY_MINUTES];
+  uint8_t modes[SCHEDULE_DAY_MINUTES];
+} scheduleDayS;
+
+int8_t compareFeedingTimes(const feedingTimeS *a, const feedingTimeS *b);
+bool isFeedingTimeActive(const feedingTimeS *entry, uint32_t date, uint8_t weekday);
+uint32_t scheduleSize(const scheduleNodeS *root);
+int8_t scheduleInsert(scheduleNodeS **root, const feedingTimeS *entry);
+int8_t scheduleRemove(scheduleNodeS **root, const feedingTimeS *entry);
+feedingTimeS *scheduleFind(scheduleNodeS *root, const feedingTimeS *entry);
+feedingTimeS *scheduleSelect(scheduleNodeS *root, uint32_t index);
+void scheduleClear(scheduleNodeS **root);
+void scheduleCompileDay(const scheduleNodeS *root, uint32_t date, uint8_t weekday, scheduleDayS *day);
+int16_t scheduleNextMinute(const scheduleDayS *day, uint16_t from);
+uint16_t scheduleCountMinutes(const scheduleDayS *day, uint16_t from, uint16_t to);
+
+#endif // schedule_h
@@ -0,0 +1,203 @@
+#include "sla.h"
+#include <string.h>
+#include "logger.h"
+#include "clock.h"
+#include "metrics.h"
+#include "context.h"
+
+// Inclusive upper bounds of the latency buckets [ms]
+const uint32_t slaUpperBounds[SLA_BUCKETS] = {50, 100, 250, 500, 1000, 2000, 5000, 10000, 30000, 60000};
+
+const char* slaStageNames[] = {
+  "feeder_feed_dispatch_latency_ms",
+  "feeder_feed_start_latency_ms",
+  "feeder_feed_completion_latency_ms"
+};
+
+const char* slaStageHelps[] = {
+  "Delay from the due time of a feeding until it is queued in milliseconds",
+  "Delay from the due time of a feeding until the motor starts in milliseconds",
+  "Delay from the due time of a feeding until its last portion is dispensed in milliseconds"
+};
+
+/*******************************************************************************
+* getSlaEntry
+*
+* @brief Returns the latencies of a feeding time of a hopper. A feeding time
+*        seen for the first time takes a free slot or the one fed least
+*        recently. Called with the mutex held
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] minute Minute of the day of the feeding time
+*
+* @return The latencies of the feeding time
+*******************************************************************************/
+slaEntryS *getSlaEntry(feederS *feeder, uint8_t hopper, uint16_t minute) {
+  slaEntryS *entries = feeder->sla.entries[hopper];
+  slaEntryS *oldest = &entries[0];
+
+  for (uint8_t i = 0; i < FEEDING_SLA_ENTRIES; i++) {
+    if (entries[i].count > 0 && entries[i].minute == minute) return &entries[i];
+    if (entries[i].count == 0) {
+      oldest = &entries[i];
+      break;
+    }
+    if (entries[i].lastScheduled < oldest->lastScheduled) oldest = &entries[i];
+  }
+
+  memset(oldest, 0, sizeof(slaEntryS));
+  oldest->minute = minute;
+
+  return oldest;
+}
+
+/*******************************************************************************
+* observeSlaLatency
+*
+* @brief Records a latency in the histogram of a stage
+*
+* @param[in] latency The histogram
+* @param[in] value The latency [ms]
+*******************************************************************************/
+void observeSlaLatency(slaLatencyS *latency, uint32_t value) {
+  uint8_t bucket = 0;
+
+  while (bucket < SLA_BUCKETS && value > slaUpperBounds[bucket]) {
+    bucket++;
+  }
+
+  latency->buckets[bucket]++;
+  latency->sum += value;
+  if (value > latency->max) latency->max = value;
+}
+
+/*******************************************************************************
+* getSlaPercentile
+*
+* @brief Returns a percentile of a latency histogram as the upper bound of the
+*        bucket it falls in, never above the largest latency
+*
+* @param[in] latency The histogram
+* @param[in] count Latencies in the histogram
+* @param[in] percentile The percentile, 1 - 100
+*
+* @return The percentile [ms]
+*******************************************************************************/
+uint32_t getSlaPercentile(const slaLatencyS *latency, uint32_t count, uint8_t percentile) {
+  uint64_t rank = ((uint64_t)count * percentile + 99) / 100;
+  uint64_t cumulative = 0;
+
+  for (uint8_t bucket = 0; bucket < SLA_BUCKETS; bucket++) {
+    cumulative += latency->buckets[bucket];
+    if (cumulative >= rank) return slaUpperBounds[bucket] < latency->max ? slaUpperBounds[bucket] : latency->max;
+  }
+
+  return latency->max;
+}
+
+/*******************************************************************************
+* getLatency
+*
+* @brief Returns the time from the due time of a feeding until a wall clock
+*
+* @param[in] timing Times of the feeding
+* @param[in] time Wall clock [ms]
+*
+* @return The latency [ms], 0 if the wall clock was set back in between
+*******************************************************************************/
+uint32_t getLatency(const feedTimingS *timing, uint64_t time) {
+  uint64_t scheduled = (uint64_t)timing->scheduled * 1000;
+
+  if (time < scheduled) return 0;
+  return time - scheduled > UINT32_MAX ? UINT32_MAX : time - scheduled;
+}
+
+/*******************************************************************************
+* recordFeedingSla
+*
+* @brief Records the latencies of a finished scheduled feeding with the ones
+*        of its feeding time and logs them with the p50, p99 and max start
+*        latency of the feeding time. A feeding whose motor started later than
+*        FEEDING_SLA_START_BUDGET is logged as a warning
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] timing Times of the feeding
+*******************************************************************************/
+void recordFeedingSla(feederS *feeder, uint8_t hopper, const feedTimingS *timing) {
+  char logMessageBuffer[120];
+  uint32_t latencies[SLA_STAGES_COUNT] = {
+    getLatency(timing, timing->dispatched),
+    getLatency(timing, timing->started),
+    getLatency(timing, timing->completed)
+  };
+  struct tm timeInfo;
+  getFeederLocalTime(feeder, timing->scheduled, &timeInfo);
+  bool isBreached = latencies[SLA_START] > FEEDING_SLA_START_BUDGET;
+
+  pthread_mutex_lock(&feeder->sla.mutex);
+
+  slaEntryS *entry = getSlaEntry(feeder, hopper, timeInfo.tm_hour * 60 + timeInfo.tm_min);
+  entry->count++;
+  entry->lastScheduled = timing->scheduled;
+  if (isBreached) entry->breaches++;
+  for (uint8_t i = 0; i < SLA_STAGES_COUNT; i++) {
+    observeSlaLatency(&entry->latencies[i], latencies[i]);
+  }
+
+  slaLatencyS start = entry->latencies[SLA_START];
+  uint32_t count = entry->count;
+
+  pthread_mutex_unlock(&feeder->sla.mutex);
+
+  if (isBreached) metricsHopperIncrement(feeder, hopper, METRIC_FEED_SLA_BREACHES);
+
+  snprintf(logMessageBuffer, sizeof(logMessageBuffer), "Feeding %02d:%02d of hopper %hhu started +%u ms "
+    "(queued +%u, done +%u), p50 %u p99 %u max %u ms of %u", timeInfo.tm_hour, timeInfo.tm_min, hopper + 1,
+    latencies[SLA_START], latencies[SLA_DISPATCH], latencies[SLA_COMPLETION],
+    getSlaPercentile(&start, count, 50), getSlaPercentile(&start, count, 99), start.max, count);
+  logMessage(feeder, isBreached ? WARNING : INFO, logMessageBuffer);
+}
+
+/*******************************************************************************
+* exportFeedingSla
+*
+* @brief Writes the latencies of every feeding time as Prometheus summaries
+*        with a hopper and a time label, the p50, the p99 and the max as
+*        quantile 1
+*
+* @param[in] feeder The feeder
+* @param[in] fp The metrics file
+*******************************************************************************/
+void exportFeedingSla(feederS *feeder, FILE *fp) {
+  static const uint8_t percentiles[] = {50, 99};
+
+  pthread_mutex_lock(&feeder->sla.mutex);
+
+  for (uint8_t stage = 0; stage < SLA_STAGES_COUNT; stage++) {
+    fprintf(fp, "# HELP %s %s\n", slaStageNames[stage], slaStageHelps[stage]);
+    fprintf(fp, "# TYPE %s summary\n", slaStageNames[stage]);
+
+    for (uint8_t hopper = 0; hopper < HOPPERS_COUNT; hopper++) {
+      for (uint8_t i = 0; i < FEEDING_SLA_ENTRIES; i++) {
+        slaEntryS *entry = &feeder->sla.entries[hopper][i];
+        if (entry->count == 0) continue;
+
+        const slaLatencyS *latency = &entry->latencies[stage];
+        char labels[32];
+        sprintf(labels, "hopper=\"%hhu\",time=\"%02u:%02u\"", hopper + 1, entry->minute / 60, entry->minute % 60);
+
+        for (uint8_t j = 0; j < sizeof(percentiles); j++) {
+          fprintf(fp, "%s{%s,quantile=\"0.%u\"} %u\n", slaStageNames[stage], labels, percentiles[j],
+            getSlaPercentile(latency, entry->count, percentiles[j]));
+        }
+        fprintf(fp, "%s{%s,quantile=\"1\"} %u\n", slaStageNames[stage], labels, latency->max);
+        fprintf(fp, "%s_sum{%s} %llu\n", slaStageNames[stage], labels, (unsigned long long)latency->sum);
+        fprintf(fp, "%s_count{%s} %u\n", slaStageNames[stage], labels, entry->count);
+      }
+    }
+  }
+
+  pthread_mutex_unlock(&feeder->sla.mutex);
+}
@@ -0,0 +1,55 @@
+#ifndef sla_h
+#define sla_h
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include "../config.h"
+
+typedef struct feederS feederS; // Defined in context.h
+
+#define SLA_BUCKETS 10
+
+typedef enum {
+  SLA_DISPATCH, // From the due time until the feeding is queued
+  SLA_START, // From the due time until the motor starts
+  SLA_COMPLETION, // From the due time until the last portion is dispensed
+  SLA_STAGES_COUNT
+} slaStageE;
+
+// Times a scheduled feeding went through, from the schedule to the motor
+typedef struct feedTimingS {
+  time_t scheduled; // Time the feeding was due, 0 if the job isn't a scheduled feeding
+  uint64_t dispatched; // Wall clock when the feeding was queued [ms]
+  uint64_t started; // Wall clock when the motor was first driven [ms]
+  uint64_t completed; // Wall clock when the job finished [ms]
+} feedTimingS;
+
+typedef struct slaLatencyS {
+  uint32_t buckets[SLA_BUCKETS + 1]; // Last bucket is +Inf
+  uint64_t sum; // [ms]
+  uint32_t max; // [ms]
+} slaLatencyS;
+
+// Latencies of the feedings of a feeding time
+typedef struct slaEntryS {
+  uint16_t minute; // Minute of the day of the feeding time
+  uint32_t count; // Measured feedings, 0 for a free slot
+  uint32_t breaches; // Feedings which started later than FEEDING_SLA_START_BUDGET
+  time_t lastScheduled; // Time the last measured feeding was due
+  slaLatencyS latencies[SLA_STAGES_COUNT];
+} slaEntryS;
+
+// Latencies of the feeding times of every hopper, recorded by the dispenser
+// workers and exported by the main loop
+typedef struct slaS {
+  pthread_mutex_t mutex;
+  slaEntryS entries[HOPPERS_COUNT][FEEDING_SLA_ENTRIES];
+} slaS;
+
+void recordFeedingSla(feederS *feeder, uint8_t hopper, const feedTimingS *timing);
+uint32_t getSlaPercentile(const slaLatencyS *latency, uint32_t count, uint8_t percentile);
+void exportFeedingSla(feederS *feeder, FILE *fp);
+
+#endif // sla_h
@@ -0,0 +1,32 @@
+#include "tools.h"
+#include <stdio.h>
+
+/*******************************************************************************
+* getHopperFileName
+*
+* @brief Returns the name of a file kept for every hopper in the directory of a
+*        feeder. The first hopper uses the name as it is, so a single hopper
+*        feeder keeps its files, the others get their number before the
+*        extension, e.g. motor2.cfg. Files of the whole feeder use the first
+*        hopper
+*
+* @param[out] buffer The file name of the hopper
+* @param[in] size Size of the buffer
+* @param[in] directory Directory of the feeder, empty for the working directory
+* @param[in] fileName Name of the file of the first hopper
+* @param[in] hopper Index of the hopper
+*******************************************************************************/
+void getHopperFileName(char *buffer, size_t size, const char *directory, const char *fileName, uint8_t hopper) {
+  const char *separator = directory[0] != '\0' ? "/" : "";
+
+  if (hopper == 0) {
+    snprintf(buffer, size, "%s%s%s", directory, separator, fileName);
+    return;
+  }
+
+  const char *extension = strrchr(fileName, '.');
+  int length = extension != NULL ? extension - fileName : (int)strlen(fileName);
+
+  snprintf(buffer, size, "%s%s%.*s%hhu%s", directory, separator, length, fileName, hopper + 1,
+    extension != NULL ? extension : "");
+}
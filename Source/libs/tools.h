@@ -2,8 +2,11 @@
 #define tools_h
 
 #include <string.h>
+#include <stdint.h>
 
 /* Macros */
 #define getName(var) #var
 
-#endif // tools_h
\ No newline at end of file
+void getHopperFileName(char *buffer, size_t size, const char *directory, const char *fileName, uint8_t hopper);
+
+#endif // tools_h
@@ -0,0 +1,245 @@
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <stdatomic.h>
+#include "../config.h"
+#include "logger.h"
+#include "tools.h"
+#include "context.h"
+
+// SIGUSR1 received so far, every feeder dumps its trace once per signal
+volatile sig_atomic_t traceSignals = 0;
+
+/*******************************************************************************
+* traceSignalHandler
+*
+* @brief Requests a trace dump of every feeder on SIGUSR1
+*
+* @param[in] signal The received signal
+*******************************************************************************/
+void traceSignalHandler(int signal) {
+  traceSignals++;
+}
+
+/*******************************************************************************
+* initTrace
+*
+* @brief Allocates the rings of all hoppers of a feeder and installs the
+*        SIGUSR1 handler which requests a trace dump. The rings are on the heap,
+*        a feeder without tracing doesn't hold them
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void initTrace(feederS *feeder) {
+  traceS *trace = &feeder->trace;
+
+  trace->lastSignal = traceSignals;
+  if (TRACE_ENABLED && trace->rings == NULL) {
+    trace->rings = calloc(HOPPERS_COUNT, sizeof(traceRingS));
+    if (trace->rings == NULL) {
+      logMessage(feeder, ERROR, "Error: Unable to allocate the motor trace, tracing disabled");
+    }
+  }
+
+  struct sigaction action = {0};
+  action.sa_handler = traceSignalHandler;
+  sigemptyset(&action.sa_mask);
+  action.sa_flags = SA_RESTART;
+  sigaction(SIGUSR1, &action, NULL);
+}
+
+/*******************************************************************************
+* traceBeginMove
+*
+* @brief Starts recording the samples of a move of a hopper
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] degrees Requested rotation of the move
+*******************************************************************************/
+void traceBeginMove(feederS *feeder, uint8_t hopper, int32_t degrees) {
+  if (feeder->trace.rings == NULL) return;
+  traceRingS *ring = &feeder->trace.rings[hopper];
+
+  ring->isRecording = true;
+  ring->currentMove = (traceMoveS){
+    .firstSample = atomic_load_explicit(&ring->sampleHead, memory_order_relaxed),
+    .degrees = degrees,
+    .hopper = hopper
+  };
+}
+
+/*******************************************************************************
+* traceRecord
+*
+* @brief Records a sample of the current move of a hopper. Doesn't block and
+*        doesn't allocate, the oldest samples are overwritten
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] sample The sample to record
+*******************************************************************************/
+void traceRecord(feederS *feeder, uint8_t hopper, const traceSampleS *sample) {
+  if (feeder->trace.rings == NULL) return;
+  traceRingS *ring = &feeder->trace.rings[hopper];
+  if (!ring->isRecording) return;
+
+  uint32_t head = atomic_load_explicit(&ring->sampleHead, memory_order_relaxed);
+  ring->samples[head % TRACE_SAMPLES] = *sample;
+  atomic_store_explicit(&ring->sampleHead, head + 1, memory_order_release);
+}
+
+/*******************************************************************************
+* traceEndMove
+*
+* @brief Finishes recording of the current move of a hopper
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] jams Jams detected during the move
+* @param[in] isFaulted Whether or not the move was given up
+* @param[in] isAborted Whether or not the watchdog aborted the move
+*******************************************************************************/
+void traceEndMove(feederS *feeder, uint8_t hopper, uint8_t jams, bool isFaulted, bool isAborted) {
+  if (feeder->trace.rings == NULL) return;
+  traceRingS *ring = &feeder->trace.rings[hopper];
+  if (!ring->isRecording) return;
+  ring->isRecording = false;
+
+  uint32_t moveHead = atomic_load_explicit(&ring->moveHead, memory_order_relaxed);
+  ring->currentMove.samples = atomic_load_explicit(&ring->sampleHead, memory_order_relaxed) - ring->currentMove.firstSample;
+  ring->currentMove.jams = jams;
+  ring->currentMove.isFaulted = isFaulted;
+  ring->currentMove.isAborted = isAborted;
+  ring->moves[moveHead % TRACE_MOVES] = ring->currentMove;
+  atomic_store_explicit(&ring->moveHead, moveHead + 1, memory_order_release);
+}
+
+/*******************************************************************************
+* traceDump
+*
+* @brief Writes the finished moves still held in the rings of all hoppers of a
+*        feeder to a binary file, hopper by hopper. Samples overwritten by a
+*        move recorded during the dump are dropped. The file is replaced
+*        atomically
+*
+* @param[in] feeder The feeder
+* @param[in] fileName Name of the trace file
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t traceDump(feederS *feeder, const char *fileName) {
+  if (feeder->trace.rings == NULL) return -1;
+
+  traceSampleS *samples = malloc(TRACE_SAMPLES * sizeof(traceSampleS));
+  if (samples == NULL) return -1;
+
+  char tmpFileName[strlen(fileName) + 5];
+  sprintf(tmpFileName, "%s.tmp", fileName);
+
+  FILE *fp = fopen(tmpFileName, "wb");
+  if (fp == NULL) {
+    free(samples);
+    return -1;
+  }
+
+  traceFileHeaderS header = {TRACE_MAGIC, TRACE_VERSION, sizeof(traceSampleS), 0};
+  fwrite(&header, sizeof(header), 1, fp);
+
+  for (uint8_t hopper = 0; hopper < HOPPERS_COUNT; hopper++) {
+    traceRingS *ring = &feeder->trace.rings[hopper];
+    uint32_t moveHead = atomic_load_explicit(&ring->moveHead, memory_order_acquire);
+    uint32_t moves = moveHead < TRACE_MOVES ? moveHead : TRACE_MOVES;
+
+    for (uint32_t i = moveHead - moves; i != moveHead; i++) {
+      traceMoveS move = ring->moves[i % TRACE_MOVES];
+
+      // Start at the oldest sample still in the ring
+      uint32_t sampleHead = atomic_load_explicit(&ring->sampleHead, memory_order_acquire);
+      uint32_t end = move.firstSample + move.samples;
+      if (sampleHead - move.firstSample > TRACE_SAMPLES) {
+        if (sampleHead - end >= TRACE_SAMPLES) continue;
+        move.firstSample = sampleHead - TRACE_SAMPLES;
+        move.samples = end - move.firstSample;
+      }
+
+      for (uint32_t sample = 0; sample < move.samples; sample++) {
+        samples[sample] = ring->samples[(move.firstSample + sample) % TRACE_SAMPLES];
+      }
+
+      // Drop samples which were overwritten while they were copied
+      sampleHead = atomic_load_explicit(&ring->sampleHead, memory_order_acquire);
+      uint32_t skipped = 0;
+      if (sampleHead - move.firstSample > TRACE_SAMPLES) {
+        skipped = sampleHead - TRACE_SAMPLES - move.firstSample;
+        if (skipped > move.samples) skipped = move.samples;
+      }
+
+      move.firstSample += skipped;
+      move.samples -= skipped;
+      if (move.samples == 0) continue;
+
+      fwrite(&move, sizeof(move), 1, fp);
+      fwrite(&samples[skipped], sizeof(traceSampleS), move.samples, fp);
+      header.moves++;
+    }
+  }
+
+  // Number of moves is known only at the end
+  fseek(fp, 0, SEEK_SET);
+  fwrite(&header, sizeof(header), 1, fp);
+  free(samples);
+
+  if (fclose(fp) != 0) {
+    return -1;
+  }
+
+  if (rename(tmpFileName, fileName) != 0) {
+    return -1;
+  }
+
+  char logMessageBuffer[120];
+  sprintf(logMessageBuffer, "Dumped %u motor moves to %s", header.moves, fileName);
+  logMessage(feeder, INFO, logMessageBuffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+* requestTraceDump
+*
+* @brief Requests a trace dump of a feeder from its main loop, e.g. after a jam
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void requestTraceDump(feederS *feeder) {
+  atomic_store(&feeder->trace.isDumpRequested, true);
+}
+
+/*******************************************************************************
+* handleTrace
+*
+* @brief Dumps the trace file of a feeder when requested by SIGUSR1 or after a
+*        jam
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void handleTrace(feederS *feeder) {
+  traceS *trace = &feeder->trace;
+  unsigned int signals = traceSignals;
+
+  if (signals == trace->lastSignal && !atomic_exchange(&trace->isDumpRequested, false)) return;
+  trace->lastSignal = signals;
+
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+  getHopperFileName(fileName, sizeof(fileName), feeder->directory, TRACE_FILE, 0);
+
+  if (traceDump(feeder, fileName) != 0) {
+    char logMessageBuffer[120];
+    sprintf(logMessageBuffer, "Error during motor trace dump: %s", strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef trace_h
+#define trace_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "../config.h"
+
+typedef struct feederS feederS; // Defined in context.h
+
+#define TRACE_MAGIC 0x43525446 // "FTRC" in a little endian file
+#define TRACE_VERSION 1
+
+// Samples are written to the file as they are kept in memory, the decoder has
+// to run on a machine with the same endianness as the feeder
+typedef struct traceSampleS {
+  uint32_t time; // Time since the start of the move [us]
+  int32_t position; // Encoder position [ticks]
+  int32_t reference; // Reference position [ticks]
+  int32_t error; // Control error [ticks]
+  int16_t output; // PWM command
+  uint8_t state; // Motor state, motorStateE
+  uint8_t jams; // Jams detected so far in the move
+} traceSampleS;
+
+typedef struct traceMoveS {
+  uint32_t firstSample; // Index of the first sample of the move
+  uint32_t samples; // Number of samples of the move
+  int32_t degrees; // Requested rotation
+  uint8_t jams; // Jams detected during the move
+  uint8_t isFaulted; // Whether or not the move was given up
+  uint8_t isAborted; // Whether or not the watchdog aborted the move
+  uint8_t hopper; // Hopper of the motor which moved
+} traceMoveS;
+
+typedef struct traceFileHeaderS {
+  uint32_t magic; // TRACE_MAGIC
+  uint16_t version; // TRACE_VERSION
+  uint16_t sampleSize; // Size of traceSampleS
+  uint32_t moves; // Number of moves in the file, each a traceMoveS followed by its samples
+} traceFileHeaderS;
+
+// Samples of the last moves of a hopper. There is a single writer, the control
+// loop of the hopper, so recording is one store of the sample and one release
+// of the head
+typedef struct traceRingS {
+  traceSampleS samples[TRACE_SAMPLES];
+  atomic_uint sampleHead; // Number of samples ever recorded
+  traceMoveS moves[TRACE_MOVES];
+  atomic_uint moveHead; // Number of moves ever finished
+  traceMoveS currentMove;
+  bool isRecording;
+} traceRingS;
+
+typedef struct traceS {
+  traceRingS *rings; // Ring of every hopper, NULL while tracing is disabled
+  atomic_bool isDumpRequested;
+  unsigned int lastSignal; // SIGUSR1 count at the last dump of the feeder
+} traceS;
+
+void initTrace(feederS *feeder);
+void traceBeginMove(feederS *feeder, uint8_t hopper, int32_t degrees);
+void traceRecord(feederS *feeder, uint8_t hopper, const traceSampleS *sample);
+void traceEndMove(feederS *feeder, uint8_t hopper, uint8_t jams, bool isFaulted, bool isAborted);
+int8_t traceDump(feederS *feeder, const char *fileName);
+void requestTraceDump(feederS *feeder);
+void handleTrace(feederS *feeder);
+
+#endif // trace_h
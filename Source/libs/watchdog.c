@@ -0,0 +1,329 @@
+#include "watchdog.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <stddef.h>
+#include <wiringPi.h>
+#include "../config.h"
+#include "logger.h"
+#include "metrics.h"
+#include "motor.h"
+#include "context.h"
+
+const char* watchdogPhaseStrings[] = {
+  "IDLE",
+  "MOVING",
+  "BACKING_OFF"
+};
+
+/*******************************************************************************
+* sdNotify
+*
+* @brief Sends a state notification to systemd over the socket from the
+*        NOTIFY_SOCKET environment variable
+*
+* @param[in] state The state string to send, e.g. "WATCHDOG=1"
+*
+* @return 0 on success, -1 on failure or when not running under systemd
+*******************************************************************************/
+int8_t sdNotify(const char *state) {
+  const char *socketPath = getenv("NOTIFY_SOCKET");
+  if (socketPath == NULL || (socketPath[0] != '/' && socketPath[0] != '@')) return -1;
+
+  struct sockaddr_un address = {0};
+  address.sun_family = AF_UNIX;
+  strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+
+  // Abstract namespace sockets start with a null byte instead of '@'
+  if (address.sun_path[0] == '@') address.sun_path[0] = '\0';
+
+  int fd = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return -1;
+
+  socklen_t addressLength = offsetof(struct sockaddr_un, sun_path) + strlen(socketPath);
+  ssize_t sent = sendto(fd, state, strlen(state), MSG_NOSIGNAL, (struct sockaddr *)&address, addressLength);
+  close(fd);
+
+  return sent < 0 ? -1 : 0;
+}
+
+/*******************************************************************************
+* initWatchdog
+*
+* @brief Opens the systemd and hardware watchdogs and starts the supervisor
+*        thread of a feeder which feeds them only while its latency budgets are
+*        met
+*
+* @param[in] feeder The feeder
+*
+* @return 0 on success, 1 on failure
+*******************************************************************************/
+uint8_t initWatchdog(feederS *feeder) {
+  char logMessageBuffer[120];
+  watchdogS *watchdog = &feeder->watchdog;
+
+  watchdog->deviceFd = -1;
+
+  // systemd expects a notification at least every WATCHDOG_USEC, feed it twice as often
+  const char *watchdogUsec = getenv("WATCHDOG_USEC");
+  if (watchdogUsec != NULL) {
+    watchdog->systemdInterval = strtoul(watchdogUsec, NULL, 10) / 2000;
+  }
+
+  if (WATCHDOG_HARDWARE_DEVICE[0] != '\0') {
+    watchdog->deviceFd = open(WATCHDOG_HARDWARE_DEVICE, O_WRONLY | O_CLOEXEC);
+    if (watchdog->deviceFd < 0) {
+      sprintf(logMessageBuffer, "Unable to open hardware watchdog %s: %s", WATCHDOG_HARDWARE_DEVICE, strerror(errno));
+      logMessage(feeder, WARNING, logMessageBuffer);
+    }
+  }
+
+  atomic_store(&watchdog->lastKick, millis());
+
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, watchdogSupervisor, feeder) != 0) {
+    sprintf(logMessageBuffer, "Error: Unable to start watchdog supervisor: %s", strerror(errno));
+    logMessage(feeder, ERROR, logMessageBuffer);
+    return 1;
+  }
+  pthread_detach(thread);
+
+  sdNotify("READY=1");
+
+  sprintf(logMessageBuffer, "Watchdog started. Loop budget %d ms, move budget %d ms, systemd interval %u ms",
+    WATCHDOG_LOOP_BUDGET, WATCHDOG_MOVE_BUDGET, watchdog->systemdInterval);
+  logMessage(feeder, INFO, logMessageBuffer);
+
+  return 0;
+}
+
+/*******************************************************************************
+* watchdogKick
+*
+* @brief Marks the start of a main loop iteration of a feeder. From the first
+*        kick on the loop budget is checked all the time
+*
+* @param[in] feeder The feeder
+*******************************************************************************/
+void watchdogKick(feederS *feeder) {
+  atomic_store(&feeder->watchdog.lastKick, millis());
+  atomic_store(&feeder->watchdog.isLoopRunning, true);
+}
+
+/*******************************************************************************
+* watchdogBeginMove
+*
+* @brief Starts the move budget of a hopper. Nested moves share the budget of
+*        the outermost move
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*******************************************************************************/
+void watchdogBeginMove(feederS *feeder, uint8_t hopper) {
+  watchdogMoveS *move = &feeder->watchdog.moves[hopper];
+
+  if (atomic_fetch_add(&move->depth, 1) == 0) {
+    atomic_store(&move->start, millis());
+    atomic_store(&move->isAborted, false);
+  }
+}
+
+/*******************************************************************************
+* watchdogEndMove
+*
+* @brief Ends the move budget of a hopper. Before the main loop started the
+*        moves run on the main thread, so finishing a move counts as loop
+*        progress
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*******************************************************************************/
+void watchdogEndMove(feederS *feeder, uint8_t hopper) {
+  watchdogMoveS *move = &feeder->watchdog.moves[hopper];
+
+  if (atomic_fetch_sub(&move->depth, 1) == 1) {
+    atomic_store(&move->phase, WATCHDOG_PHASE_IDLE);
+    if (!atomic_load(&feeder->watchdog.isLoopRunning)) atomic_store(&feeder->watchdog.lastKick, millis());
+  }
+}
+
+/*******************************************************************************
+* watchdogSetPhase
+*
+* @brief Sets the motor phase of a hopper recorded in the breach snapshot
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] phase The current motor phase
+*******************************************************************************/
+void watchdogSetPhase(feederS *feeder, uint8_t hopper, watchdogPhaseE phase) {
+  atomic_store(&feeder->watchdog.moves[hopper].phase, phase);
+}
+
+/*******************************************************************************
+* watchdogIsMoveAborted
+*
+* @brief Checks if the supervisor requested the current move of a hopper to be
+*        aborted
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+*
+* @return True if the move budget was breached, false otherwise
+*******************************************************************************/
+bool watchdogIsMoveAborted(feederS *feeder, uint8_t hopper) {
+  return atomic_load(&feeder->watchdog.moves[hopper].isAborted);
+}
+
+/*******************************************************************************
+* logWatchdogSnapshot
+*
+* @brief Records the diagnostic snapshot of a breached budget
+*
+* @param[in] feeder The feeder
+* @param[in] budgetName Name of the breached budget
+* @param[in] snapshot The snapshot to record
+*******************************************************************************/
+void logWatchdogSnapshot(feederS *feeder, const char *budgetName, watchdogSnapshotS *snapshot) {
+  char logMessageBuffer[120];
+  sprintf(logMessageBuffer, "Watchdog: %s budget breached after %u ms. Motor %hhu %s, encoder %lld, %.0f deg/s, PWM %d",
+    budgetName, snapshot->elapsed, snapshot->hopper + 1, watchdogPhaseStrings[snapshot->phase],
+    (long long)snapshot->encoderPosition, snapshot->velocity, snapshot->motorOutput);
+  logMessage(feeder, ERROR, logMessageBuffer);
+}
+
+/*******************************************************************************
+* takeWatchdogSnapshot
+*
+* @brief Records the motor state of a hopper at the moment of a breach
+*
+* @param[in] feeder The feeder
+* @param[in] hopper The hopper
+* @param[in] elapsed Time spent in the breached budget [ms]
+*
+* @return The snapshot
+*******************************************************************************/
+watchdogSnapshotS takeWatchdogSnapshot(feederS *feeder, uint8_t hopper, uint32_t elapsed) {
+  motorS *motor = getMotor(feeder, hopper);
+
+  return (watchdogSnapshotS){
+    .hopper = hopper,
+    .phase = atomic_load(&feeder->watchdog.moves[hopper].phase),
+    .elapsed = elapsed,
+    .encoderPosition = getEncoderPosition(motor),
+    .motorOutput = getMotorOutput(motor),
+    .velocity = getEncoderVelocity(motor) / getEncoderTicksPerDegree(motor)
+  };
+}
+
+/*******************************************************************************
+* watchdogSupervisor
+*
+* @brief Supervisor thread. Checks the latency budgets and feeds the systemd and
+*        hardware watchdogs only while they are met. Every moving hopper has
+*        its own move budget. The moves run in the dispenser workers, so the
+*        loop budget is checked on every pass once the main loop started, and
+*        before that, e.g. in the maintenance modes, while no hopper moves.
+*        A breached move is aborted and its motor stopped, the other hoppers
+*        keep moving. If the breach is not recovered within
+*        WATCHDOG_ESCALATION_TIME the watchdogs are starved so the feeder gets
+*        restarted
+*
+* @param[in] arg The feeder
+*
+* @return Never returns
+*******************************************************************************/
+void *watchdogSupervisor(void *arg) {
+  feederS *feeder = arg;
+  watchdogS *watchdog = &feeder->watchdog;
+  uint32_t lastSystemdNotify = 0;
+  uint32_t breachStart = 0;
+  bool isBreached = false;
+  bool isLoopBreached = false;
+  bool isEscalated = false;
+
+  while (1) {
+    delay(WATCHDOG_CHECK_INTERVAL);
+
+    uint32_t currentTime = millis();
+    bool isMoving = false;
+    bool isBudgetMet = true;
+
+    for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+      watchdogMoveS *move = &watchdog->moves[i];
+      if (atomic_load(&move->depth) == 0) continue;
+
+      isMoving = true;
+      uint32_t elapsed = currentTime - atomic_load(&move->start);
+      if (elapsed <= WATCHDOG_MOVE_BUDGET) continue;
+
+      isBudgetMet = false;
+      if (atomic_load(&move->isAborted)) continue;
+
+      metricsIncrement(feeder, METRIC_WATCHDOG_BREACHES);
+      watchdogSnapshotS snapshot = takeWatchdogSnapshot(feeder, i, elapsed);
+      logWatchdogSnapshot(feeder, "move", &snapshot);
+
+      // The control loop stops the motor as soon as it sees the flag, stop
+      // it here as well in case the loop itself is stuck
+      atomic_store(&move->isAborted, true);
+      driveMotor(getMotor(feeder, i), 0);
+    }
+
+    if (atomic_load(&watchdog->isLoopRunning) || !isMoving) {
+      uint32_t elapsed = currentTime - atomic_load(&watchdog->lastKick);
+
+      if (elapsed > WATCHDOG_LOOP_BUDGET) {
+        isBudgetMet = false;
+        if (!isLoopBreached) {
+          isLoopBreached = true;
+          metricsIncrement(feeder, METRIC_WATCHDOG_BREACHES);
+          watchdogSnapshotS snapshot = takeWatchdogSnapshot(feeder, 0, elapsed);
+          logWatchdogSnapshot(feeder, "loop", &snapshot);
+        }
+      } else {
+        isLoopBreached = false;
+      }
+    }
+
+    if (isBudgetMet) {
+      if (isBreached) {
+        char logMessageBuffer[120];
+        sprintf(logMessageBuffer, "Watchdog: recovered after %u ms", currentTime - breachStart);
+        logMessage(feeder, INFO, logMessageBuffer);
+      }
+      isBreached = false;
+      isEscalated = false;
+
+      if (watchdog->systemdInterval > 0 && currentTime - lastSystemdNotify >= watchdog->systemdInterval) {
+        sdNotify("WATCHDOG=1");
+        lastSystemdNotify = currentTime;
+      }
+
+      if (watchdog->deviceFd >= 0) {
+        write(watchdog->deviceFd, "\0", 1);
+      }
+
+      continue;
+    }
+
+    if (!isBreached) {
+      isBreached = true;
+      breachStart = currentTime;
+    }
+    else if (!isEscalated && currentTime - breachStart > WATCHDOG_ESCALATION_TIME) {
+      isEscalated = true;
+      logMessage(feeder, ERROR, "Watchdog: breach not recovered, requesting restart");
+      sdNotify("WATCHDOG=trigger");
+      // The hardware watchdog is no longer fed and resets the board on its own
+    }
+  }
+
+  return NULL;
+}
@@ -0,0 +1,51 @@
+#ifndef watchdog_h
+#define watchdog_h
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include "../config.h"
+
+typedef struct feederS feederS; // Defined in context.h
+
+typedef enum {
+  WATCHDOG_PHASE_IDLE,
+  WATCHDOG_PHASE_MOVING,
+  WATCHDOG_PHASE_BACKING_OFF,
+  WATCHDOG_PHASES_COUNT
+} watchdogPhaseE;
+
+typedef struct watchdogSnapshotS {
+  uint8_t hopper; // Hopper of the motor in the snapshot
+  watchdogPhaseE phase; // Motor phase at the moment of the breach
+  uint32_t elapsed; // Time spent in the breached budget [ms]
+  int64_t encoderPosition; // Encoder position at the moment of the breach
+  int32_t motorOutput; // PWM output at the moment of the breach
+  float velocity; // Estimated wheel velocity at the moment of the breach [deg/s]
+} watchdogSnapshotS;
+
+// Move budget of a hopper, every motor runs its moves on its own
+typedef struct watchdogMoveS {
+  atomic_uint start; // Start of the outermost move [ms]
+  atomic_uint depth; // Nesting of moves, back-off moves run inside a move
+  atomic_int phase;
+  atomic_bool isAborted;
+} watchdogMoveS;
+
+typedef struct watchdogS {
+  atomic_uint lastKick; // Last main loop iteration [ms]
+  atomic_bool isLoopRunning; // Whether or not the main loop kicks the watchdog
+  watchdogMoveS moves[HOPPERS_COUNT];
+  uint32_t systemdInterval; // Interval of systemd notifications [ms], 0 if disabled
+  int deviceFd; // File descriptor of the hardware watchdog, -1 if disabled
+} watchdogS;
+
+uint8_t initWatchdog(feederS *feeder);
+void watchdogKick(feederS *feeder);
+void watchdogBeginMove(feederS *feeder, uint8_t hopper);
+void watchdogEndMove(feederS *feeder, uint8_t hopper);
+void watchdogSetPhase(feederS *feeder, uint8_t hopper, watchdogPhaseE phase);
+bool watchdogIsMoveAborted(feederS *feeder, uint8_t hopper);
+void *watchdogSupervisor(void *arg);
+
+#endif // watchdog_h
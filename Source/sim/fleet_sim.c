@@ -0,0 +1,815 @@
+// Fleet simulation of many feeders in a single process. Every feeder runs the
+// scheduler, the journal, the dispense queue, the LCD state machine, the
+// logger and the metrics on its own virtual clock, driven by a generated
+// schedule, button presses and restarts, while a thread pool steps the feeders
+// through the simulated days. The motors are a timing model of the feed modes.
+// Reports the throughput in simulated feeder-days per second, the memory per
+// feeder and every feed which was missed, fed twice or fed with the wrong
+// portions
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/stat.h>
+#include "../config.h"
+#include "../libs/logger.h"
+#include "../libs/lcd.h"
+#include "../libs/lcd_utils.h"
+#include "../libs/buttons.h"
+#include "../libs/feeding.h"
+#include "../libs/dispenser.h"
+#include "../libs/metrics.h"
+#include "../libs/tools.h"
+#include "../libs/clock.h"
+#include "../libs/context.h"
+
+#define FLEET_FEEDERS 1000
+#define FLEET_DAYS 3
+#define FLEET_THREADS 4
+#define FLEET_STEP 10 // Virtual time of a loop iteration [s]
+#define FLEET_METRICS_INTERVAL 3600 // Virtual time between metrics exports, 0 for every iteration like the feeder [s]
+#define FLEET_RESTART_RATE 0.2 // Probability of a restart of a feeder per day
+#define FLEET_RESTART_DOWNTIME 120 // Longest time a restarted feeder is off [s]
+#define FLEET_DIRECTORY "fleet"
+#define FLEET_START_YEAR 2024 // The simulation starts at midnight of this date, a Monday
+#define FLEET_START_MONTH 6
+#define FLEET_START_DAY 3
+#define FLEET_WHEEL_ARMS 6
+#define FLEET_MAX_ENTRIES 4 // Feeding times per hopper
+#define FLEET_MAX_PENDING 16 // Feedings due and not dispensed yet per hopper
+#define FLEET_MAX_EVENTS 32 // Button presses and restarts per day
+#define FLEET_BROWSE_PRESSES 7
+
+// Time a portion takes in every feed mode [ms]
+const uint32_t fleetPortionTimes[FEED_MODES_COUNT] = {1200, 160, 480};
+
+// Presses of a user browsing the schedule and going back to the idle screen
+const lcdButtonsE fleetBrowsePresses[FLEET_BROWSE_PRESSES] = {UP, RIGHT, DOWN, DOWN, UP, LEFT, LEFT};
+
+const char* fleetModeStrings[FEED_MODES_COUNT] = {
+  "separate",
+  "batch",
+  "dwell"
+};
+
+typedef enum {
+  FLEET_EVENT_TREAT, // Feed button press
+  FLEET_EVENT_BROWSE, // Arrow button press of a browsing session
+  FLEET_EVENT_RESTART // Restart of the feeder
+} fleetEventE;
+
+typedef struct fleetEventS {
+  time_t time;
+  fleetEventE type;
+  uint8_t press; // Press of a browsing session
+} fleetEventS;
+
+typedef struct fleetFeedS {
+  time_t due; // Time the feeding is due
+  uint8_t portions;
+} fleetFeedS;
+
+typedef struct fleetStatsS {
+  uint64_t expected; // Feedings due
+  uint64_t onTime; // Feedings dispensed within a loop iteration
+  uint64_t late; // Feedings dispensed later, e.g. caught up after a restart
+  uint64_t missed; // Feedings never dispensed
+  uint64_t duplicated; // Scheduled jobs without a feeding due
+  uint64_t interrupted; // Feedings queued and lost by a restart
+  uint64_t portionMismatches; // Jobs with other portions than their feedings
+  uint64_t treats; // Feed button presses
+  uint64_t dispensedPortions;
+  uint64_t cancelledJobs;
+  uint64_t interruptedJobs; // Jobs running during a restart
+  uint64_t restarts;
+  uint64_t scheduleChanges; // Hoppers whose schedule differs from the generated one
+} fleetStatsS;
+
+// Simulated feeder with the schedule it was given and the feedings it owes
+typedef struct fleetFeederS {
+  feederS feeder;
+  unsigned int seed;
+  feedingTimeS entries[HOPPERS_COUNT][FLEET_MAX_ENTRIES];
+  uint8_t entriesCount[HOPPERS_COUNT];
+  fleetFeedS pending[HOPPERS_COUNT][FLEET_MAX_PENDING];
+  uint8_t pendingCount[HOPPERS_COUNT];
+  fleetEventS events[FLEET_MAX_EVENTS];
+  uint8_t eventsCount;
+  bool isBrowsing;
+  bool isJobRunning[HOPPERS_COUNT];
+  dispenseJobS jobs[HOPPERS_COUNT];
+  uint32_t jobTimes[HOPPERS_COUNT]; // Time the running job dispenses [ms]
+  time_t lastMetricsTime;
+  fleetStatsS stats;
+} fleetFeederS;
+
+typedef struct fleetS {
+  fleetFeederS *feeders;
+  uint32_t feedersCount;
+  uint16_t days;
+  uint16_t threads;
+  uint32_t step; // [s]
+  uint32_t metricsInterval; // [s]
+  float restartRate;
+  const char *directory;
+  time_t startTime;
+  atomic_uint nextFeeder; // Next feeder taken by a worker of the pool
+} fleetS;
+
+fleetS fleet;
+
+/*******************************************************************************
+* getResidentMemory
+*
+* @brief Returns the resident memory of the process
+*
+* @return Resident memory [B], 0 if it can't be read
+*******************************************************************************/
+uint64_t getResidentMemory() {
+  unsigned long long size, resident;
+
+  FILE *fp = fopen("/proc/self/statm", "r");
+  if (fp == NULL) return 0;
+
+  if (fscanf(fp, "%llu %llu", &size, &resident) != 2) resident = 0;
+  fclose(fp);
+
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+/*******************************************************************************
+* getFleetTime
+*
+* @brief Returns a local time of a day of the simulation
+*
+* @param[in] day Day from the start of the simulation
+* @param[in] minute Minute of the day
+*
+* @return The time
+*******************************************************************************/
+time_t getFleetTime(uint16_t day, uint16_t minute) {
+  struct tm timeInfo = {
+    .tm_year = FLEET_START_YEAR - 1900,
+    .tm_mon = FLEET_START_MONTH - 1,
+    .tm_mday = FLEET_START_DAY + day,
+    .tm_hour = minute / 60,
+    .tm_min = minute % 60,
+    .tm_isdst = -1
+  };
+
+  return mktime(&timeInfo);
+}
+
+/*******************************************************************************
+* writeFleetSchedule
+*
+* @brief Generates the schedule of a hopper, 2 - 4 feeding times between 6:00
+*        and 22:00 with 1 - 4 portions in any feed mode, some of them only on
+*        the weekend or from the second day, and writes its feeding.cfg file
+*
+* @param[in] fleetFeeder The simulated feeder
+* @param[in] hopper The hopper
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t writeFleetSchedule(fleetFeederS *fleetFeeder, uint8_t hopper) {
+  char fileName[FEEDER_FILE_NAME_LENGTH];
+  struct tm secondDay;
+  time_t secondDayTime = getFleetTime(1, 0);
+  localtime_r(&secondDayTime, &secondDay);
+
+  uint8_t count = 2 + rand_r(&fleetFeeder->seed) % (FLEET_MAX_ENTRIES - 1);
+  fleetFeeder->entriesCount[hopper] = 0;
+
+  while (fleetFeeder->entriesCount[hopper] < count) {
+    uint16_t minute = 6 * 60 + rand_r(&fleetFeeder->seed) % (16 * 60);
+    feedingTimeS entry = {
+      .hour = minute / 60,
+      .minute = minute % 60,
+      .portions = 1 + rand_r(&fleetFeeder->seed) % 4,
+      .mode = rand_r(&fleetFeeder->seed) % FEED_MODES_COUNT,
+      .weekdays = SCHEDULE_ALL_DAYS
+    };
+    if (rand_r(&fleetFeeder->seed) % 4 == 0) entry.weekdays = (1 << 6) | (1 << 0);
+    if (rand_r(&fleetFeeder->seed) % 6 == 0) {
+      entry.firstDate = (secondDay.tm_year + 1900) * 10000 + (secondDay.tm_mon + 1) * 100 + secondDay.tm_mday;
+    }
+
+    bool isDuplicate = false;
+    for (uint8_t i = 0; i < fleetFeeder->entriesCount[hopper]; i++) {
+      feedingTimeS *other = &fleetFeeder->entries[hopper][i];
+      if (other->hour == entry.hour && other->minute == entry.minute) isDuplicate = true;
+    }
+    if (!isDuplicate) fleetFeeder->entries[hopper][fleetFeeder->entriesCount[hopper]++] = entry;
+  }
+
+  getHopperFileName(fileName, sizeof(fileName), fleetFeeder->feeder.directory, FEEDING_SCHEDULE_FILE, hopper);
+  FILE *fp = fopen(fileName, "w");
+  if (fp == NULL) return -1;
+
+  fprintf(fp, "arms: %d\n", FLEET_WHEEL_ARMS);
+  for (uint8_t i = 0; i < count; i++) {
+    feedingTimeS *entry = &fleetFeeder->entries[hopper][i];
+    fprintf(fp, "%hhu:%hhu - %hhu %s", entry->hour, entry->minute, entry->portions, fleetModeStrings[entry->mode]);
+    if (entry->weekdays != SCHEDULE_ALL_DAYS) fprintf(fp, " days -----SS");
+    if (entry->firstDate != 0) {
+      fprintf(fp, " from %04u-%02u-%02u", entry->firstDate / 10000, entry->firstDate / 100 % 100, entry->firstDate % 100);
+    }
+    fprintf(fp, "\n");
+  }
+
+  fclose(fp);
+
+  return 0;
+}
+
+/*******************************************************************************
+* startFleetFeeder
+*
+* @brief Starts a simulated feeder like feeder.c does after a boot, without the
+*        motors, buttons and workers the harness stands in for
+*
+* @param[in] fleetFeeder The simulated feeder
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t startFleetFeeder(fleetFeederS *fleetFeeder) {
+  feederS *feeder = &fleetFeeder->feeder;
+
+  if (initLogger(feeder) != 0) return -1;
+  feeder->logger.isEchoed = false;
+
+  lcd_init_i2c(feeder, LCD_ADDRESS, 16, 2, LCD_5x8DOTS);
+  lcd_blinkOff_i2c(feeder);
+  lcd_cursorOff_i2c(feeder);
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    if (loadFeedingSchedule(feeder, i) != 0) return -1;
+    loadLastFeeding(feeder, i);
+    fleetFeeder->isJobRunning[i] = false;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* setupFleetFeeder
+*
+* @brief Creates the directory and the schedules of a simulated feeder and
+*        starts it on a virtual clock at the start of the simulation
+*
+* @param[in] index Index of the feeder
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t setupFleetFeeder(uint32_t index) {
+  fleetFeederS *fleetFeeder = &fleet.feeders[index];
+  feederS *feeder = &fleetFeeder->feeder;
+  char directory[FEEDER_FILE_NAME_LENGTH];
+
+  snprintf(directory, sizeof(directory), "%s/%05u", fleet.directory, index);
+  if (mkdir(directory, 0755) != 0 && errno != EEXIST) return -1;
+
+  initFeederContext(feeder, directory);
+  setVirtualClock(feeder, fleet.startTime);
+  fleetFeeder->seed = index * 2654435761u + 1;
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    char fileName[FEEDER_FILE_NAME_LENGTH];
+    getHopperFileName(fileName, sizeof(fileName), directory, FEEDING_JOURNAL_FILE, i);
+    remove(fileName);
+
+    if (writeFleetSchedule(fleetFeeder, i) != 0) return -1;
+  }
+
+  return startFleetFeeder(fleetFeeder);
+}
+
+/*******************************************************************************
+* compareFleetEvents
+*
+* @brief Orders the events of a day by their time for qsort
+*
+* @param[in] a The first event
+* @param[in] b The second event
+*
+* @return Negative, zero or positive like strcmp
+*******************************************************************************/
+int compareFleetEvents(const void *a, const void *b) {
+  const fleetEventS *eventA = a, *eventB = b;
+
+  if (eventA->time != eventB->time) return eventA->time < eventB->time ? -1 : 1;
+  return eventA->press - eventB->press;
+}
+
+/*******************************************************************************
+* planFleetDay
+*
+* @brief Adds the feedings due on a day to the feedings a simulated feeder
+*        owes and plans its button presses and restart of the day: treats,
+*        sometimes pressed several times at once, browsing sessions of the
+*        schedule and, from the second day on, a restart at a random time
+*
+* @param[in] fleetFeeder The simulated feeder
+* @param[in] day Day from the start of the simulation
+*******************************************************************************/
+void planFleetDay(fleetFeederS *fleetFeeder, uint16_t day) {
+  time_t dayStart = getFleetTime(day, 0);
+  struct tm timeInfo;
+  localtime_r(&dayStart, &timeInfo);
+  uint32_t date = (timeInfo.tm_year + 1900) * 10000 + (timeInfo.tm_mon + 1) * 100 + timeInfo.tm_mday;
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    for (uint8_t j = 0; j < fleetFeeder->entriesCount[i]; j++) {
+      feedingTimeS *entry = &fleetFeeder->entries[i][j];
+      if (!(entry->weekdays & (1 << timeInfo.tm_wday)) || date < entry->firstDate) continue;
+      if (fleetFeeder->pendingCount[i] >= FLEET_MAX_PENDING) continue;
+
+      // Pending feedings are kept in the order they are due
+      fleetFeedS feed = {getFleetTime(day, entry->hour * 60 + entry->minute), entry->portions};
+      uint8_t k = fleetFeeder->pendingCount[i]++;
+      while (k > 0 && fleetFeeder->pending[i][k - 1].due > feed.due) {
+        fleetFeeder->pending[i][k] = fleetFeeder->pending[i][k - 1];
+        k--;
+      }
+      fleetFeeder->pending[i][k] = feed;
+      fleetFeeder->stats.expected++;
+    }
+  }
+
+  fleetFeeder->eventsCount = 0;
+  fleetEventS *events = fleetFeeder->events;
+  uint8_t *count = &fleetFeeder->eventsCount;
+
+  uint8_t treats = rand_r(&fleetFeeder->seed) % 4;
+  for (uint8_t i = 0; i < treats; i++) {
+    time_t time = dayStart + 7 * 3600 + rand_r(&fleetFeeder->seed) % (15 * 3600);
+    uint8_t presses = rand_r(&fleetFeeder->seed) % 5 == 0 ? 3 : 1;
+    for (uint8_t j = 0; j < presses; j++) {
+      events[(*count)++] = (fleetEventS){time, FLEET_EVENT_TREAT, 0};
+    }
+  }
+
+  uint8_t sessions = rand_r(&fleetFeeder->seed) % 3;
+  for (uint8_t i = 0; i < sessions; i++) {
+    time_t time = dayStart + 7 * 3600 + rand_r(&fleetFeeder->seed) % (15 * 3600);
+    for (uint8_t j = 0; j < FLEET_BROWSE_PRESSES; j++) {
+      events[(*count)++] = (fleetEventS){time + j * fleet.step, FLEET_EVENT_BROWSE, j};
+    }
+  }
+
+  // The journal is empty before the first feeding, so restarts begin on the
+  // second day like on a feeder which ran for a while
+  if (day > 0 && rand_r(&fleetFeeder->seed) < fleet.restartRate * RAND_MAX) {
+    time_t time = dayStart + rand_r(&fleetFeeder->seed) % 86400;
+    events[(*count)++] = (fleetEventS){time, FLEET_EVENT_RESTART, 0};
+  }
+
+  qsort(events, *count, sizeof(fleetEventS), compareFleetEvents);
+}
+
+/*******************************************************************************
+* matchFleetJob
+*
+* @brief Matches a scheduled or caught up dispense job with the feedings due,
+*        the oldest first until its portions are covered. A job requested
+*        several times before it ran covers several feedings
+*
+* @param[in] fleetFeeder The simulated feeder
+* @param[in] job The dispense job
+* @param[in] isInterrupted Whether or not the job was lost by a restart
+*******************************************************************************/
+void matchFleetJob(fleetFeederS *fleetFeeder, const dispenseJobS *job, bool isInterrupted) {
+  if (job->source == DISPENSE_SOURCE_TREAT) return;
+
+  fleetStatsS *stats = &fleetFeeder->stats;
+  uint8_t hopper = job->hopper;
+  time_t now = getFeederTime(&fleetFeeder->feeder);
+  uint16_t portions = 0;
+  uint8_t matched = 0;
+
+  while (fleetFeeder->pendingCount[hopper] > matched && fleetFeeder->pending[hopper][matched].due <= now &&
+         portions < job->portions) {
+    fleetFeedS *feed = &fleetFeeder->pending[hopper][matched++];
+
+    if (isInterrupted) stats->interrupted++;
+    else if (now - feed->due < fleet.step) stats->onTime++;
+    else stats->late++;
+
+    portions += feed->portions;
+  }
+
+  fleetFeeder->pendingCount[hopper] -= matched;
+  memmove(fleetFeeder->pending[hopper], &fleetFeeder->pending[hopper][matched],
+    fleetFeeder->pendingCount[hopper] * sizeof(fleetFeedS));
+
+  if (matched == 0) stats->duplicated++;
+  else if (portions != job->portions) stats->portionMismatches++;
+}
+
+/*******************************************************************************
+* runFleetMotor
+*
+* @brief Dispenses the jobs of a hopper for the time of a loop iteration, every
+*        portion takes the time of its feed mode. Updates the progress shown
+*        on the LCD and honours cancellations like the dispenser worker
+*
+* @param[in] fleetFeeder The simulated feeder
+* @param[in] hopper The hopper
+* @param[in] budget Time to dispense for [ms]
+*******************************************************************************/
+void runFleetMotor(fleetFeederS *fleetFeeder, uint8_t hopper, uint32_t budget) {
+  feederS *feeder = &fleetFeeder->feeder;
+  dispenserS *dispenser = &feeder->dispensers[hopper];
+  dispenseJobS *job = &fleetFeeder->jobs[hopper];
+
+  while (budget > 0) {
+    if (!fleetFeeder->isJobRunning[hopper]) {
+      if (!takeDispenseJob(feeder, hopper, job)) return;
+
+      fleetFeeder->isJobRunning[hopper] = true;
+      fleetFeeder->jobTimes[hopper] = 0;
+      recordDispenseStart(feeder, hopper, getFeederWallMillis(feeder)); // The modelled motor starts right away
+      matchFleetJob(fleetFeeder, job, false);
+    }
+
+    uint32_t portionTime = fleetPortionTimes[job->mode];
+    uint32_t left = job->portions * portionTime - fleetFeeder->jobTimes[hopper];
+    uint32_t spent = left < budget ? left : budget;
+    fleetFeeder->jobTimes[hopper] += spent;
+    budget -= spent;
+
+    uint8_t dispensed = fleetFeeder->jobTimes[hopper] / portionTime;
+    atomic_store(&dispenser->dispensedPortions, dispensed);
+
+    bool isCancelled = atomic_load(&dispenser->isCancelled);
+    if (!isCancelled && dispensed < job->portions) continue;
+
+    if (isCancelled) {
+      fleetFeeder->stats.cancelledJobs++;
+      logDispenseStop(feeder, job, dispensed);
+    }
+    metricsHopperAdd(feeder, hopper, METRIC_PORTIONS_DISPENSED, dispensed);
+    fleetFeeder->stats.dispensedPortions += dispensed;
+
+    endDispenseJob(feeder, hopper, dispensed);
+    fleetFeeder->isJobRunning[hopper] = false;
+  }
+}
+
+/*******************************************************************************
+* restartFleetFeeder
+*
+* @brief Restarts a simulated feeder. The queued jobs are lost, the feeder is
+*        off for up to FLEET_RESTART_DOWNTIME and starts again from its files.
+*        The downtime is a whole number of loop iterations, so the iterations
+*        stay aligned with the due times and the feeding latencies aren't
+*        skewed by the step
+*
+* @param[in] fleetFeeder The simulated feeder
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t restartFleetFeeder(fleetFeederS *fleetFeeder) {
+  feederS *feeder = &fleetFeeder->feeder;
+  char directory[FEEDER_FILE_NAME_LENGTH];
+  dispenseJobS job;
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    // Jobs cut by the restart never complete, they are ended as cancelled
+    if (fleetFeeder->isJobRunning[i]) fleetFeeder->stats.interruptedJobs++;
+    atomic_store(&feeder->dispensers[i].isCancelled, true);
+    endDispenseJob(feeder, i, 0);
+
+    while (takeDispenseJob(feeder, i, &job)) {
+      matchFleetJob(fleetFeeder, &job, true);
+      atomic_store(&feeder->dispensers[i].isCancelled, true);
+      endDispenseJob(feeder, i, 0);
+    }
+
+    scheduleClear(&feeder->feedingHoppers[i].schedule.feedingTimes);
+  }
+
+  feederClockS clock = feeder->clock;
+  strcpy(directory, feeder->directory);
+  initFeederContext(feeder, directory);
+  feeder->clock = clock;
+  uint32_t downtimeSteps = FLEET_RESTART_DOWNTIME / fleet.step > 0 ? FLEET_RESTART_DOWNTIME / fleet.step : 1;
+  advanceVirtualClock(feeder, (1 + rand_r(&fleetFeeder->seed) % downtimeSteps) * fleet.step * 1000);
+  updateFeederClock(feeder);
+
+  fleetFeeder->stats.restarts++;
+
+  return startFleetFeeder(fleetFeeder);
+}
+
+/*******************************************************************************
+* handleFleetEvent
+*
+* @brief Presses a button of a simulated feeder or restarts it. A browsing
+*        session only starts on the idle screen, so its left presses never
+*        cancel a feed
+*
+* @param[in] fleetFeeder The simulated feeder
+* @param[in] event The event
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t handleFleetEvent(fleetFeederS *fleetFeeder, const fleetEventS *event) {
+  feederS *feeder = &fleetFeeder->feeder;
+
+  switch (event->type) {
+    case FLEET_EVENT_TREAT:
+      fleetFeeder->stats.treats++;
+      handleButtonPress(feeder, BUTTON_FEED);
+      break;
+    case FLEET_EVENT_BROWSE:
+      if (event->press == 0) fleetFeeder->isBrowsing = feeder->lcdState.state == LCD_IDLE;
+      if (fleetFeeder->isBrowsing) processButtonPress(feeder, fleetBrowsePresses[event->press]);
+      break;
+    case FLEET_EVENT_RESTART:
+      return restartFleetFeeder(fleetFeeder);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* runFleetDay
+*
+* @brief Runs the loop of a simulated feeder through a day, an iteration every
+*        step of the virtual clock. The metrics are exported every metrics
+*        interval only, rewriting the file every 15 s of virtual time dominates
+*        the run otherwise. Feedings still owed past the catch-up window are
+*        missed
+*
+* @param[in] fleetFeeder The simulated feeder
+* @param[in] day Day from the start of the simulation
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t runFleetDay(fleetFeederS *fleetFeeder, uint16_t day) {
+  feederS *feeder = &fleetFeeder->feeder;
+  time_t dayEnd = getFleetTime(day + 1, 0);
+  uint8_t nextEvent = 0;
+
+  planFleetDay(fleetFeeder, day);
+
+  while (1) {
+    updateFeederClock(feeder);
+    time_t now = getFeederTime(feeder);
+    if (now >= dayEnd) break;
+
+    while (nextEvent < fleetFeeder->eventsCount && fleetFeeder->events[nextEvent].time <= now) {
+      if (handleFleetEvent(fleetFeeder, &fleetFeeder->events[nextEvent++]) != 0) return -1;
+    }
+
+    handleFeeding(feeder);
+    for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+      runFleetMotor(fleetFeeder, i, fleet.step * 1000);
+    }
+    handleLCD(feeder);
+    if (now - fleetFeeder->lastMetricsTime >= fleet.metricsInterval) {
+      fleetFeeder->lastMetricsTime = now;
+      handleMetrics(feeder);
+    }
+
+    now = getFeederTime(feeder); // A restart moved the clock on
+    for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+      fleetFeedS *pending = fleetFeeder->pending[i];
+      while (fleetFeeder->pendingCount[i] > 0 && now - pending[0].due > FEEDING_CATCH_UP_WINDOW * 60 + fleet.step) {
+        fleetFeeder->stats.missed++;
+        memmove(pending, &pending[1], --fleetFeeder->pendingCount[i] * sizeof(fleetFeedS));
+      }
+    }
+
+    advanceVirtualClock(feeder, fleet.step * 1000);
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* finishFleetFeeder
+*
+* @brief Counts the feedings a simulated feeder still owes at the end as missed
+*        and checks its schedule wasn't changed by the button presses
+*
+* @param[in] fleetFeeder The simulated feeder
+*******************************************************************************/
+void finishFleetFeeder(fleetFeederS *fleetFeeder) {
+  feederS *feeder = &fleetFeeder->feeder;
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    fleetFeeder->stats.missed += fleetFeeder->pendingCount[i];
+    fleetFeeder->pendingCount[i] = 0;
+
+    if (scheduleSize(feeder->feedingHoppers[i].schedule.feedingTimes) != fleetFeeder->entriesCount[i] ||
+        getFeedingWheelArms(feeder, i) != FLEET_WHEEL_ARMS) {
+      fleetFeeder->stats.scheduleChanges++;
+    }
+  }
+
+  exportMetrics(feeder);
+}
+
+/*******************************************************************************
+* setupWorker
+*
+* @brief Worker of the pool setting up the feeders
+*
+* @param[in] arg Unused
+*
+* @return NULL on success, non-NULL on failure
+*******************************************************************************/
+void *setupWorker(void *arg) {
+  for (uint32_t i = atomic_fetch_add(&fleet.nextFeeder, 1); i < fleet.feedersCount; i = atomic_fetch_add(&fleet.nextFeeder, 1)) {
+    if (setupFleetFeeder(i) != 0) {
+      fprintf(stderr, "Error during feeder %u setup: %s\n", i, strerror(errno));
+      return (void *)1;
+    }
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* simulationWorker
+*
+* @brief Worker of the pool running the feeders, a feeder at a time through
+*        all days of the simulation
+*
+* @param[in] arg Unused
+*
+* @return NULL on success, non-NULL on failure
+*******************************************************************************/
+void *simulationWorker(void *arg) {
+  for (uint32_t i = atomic_fetch_add(&fleet.nextFeeder, 1); i < fleet.feedersCount; i = atomic_fetch_add(&fleet.nextFeeder, 1)) {
+    for (uint16_t day = 0; day < fleet.days; day++) {
+      if (runFleetDay(&fleet.feeders[i], day) != 0) {
+        fprintf(stderr, "Error during feeder %u restart: %s\n", i, strerror(errno));
+        return (void *)1;
+      }
+    }
+    finishFleetFeeder(&fleet.feeders[i]);
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* runFleetPool
+*
+* @brief Runs a worker on every thread of the pool until all feeders are done
+*
+* @param[in] worker The worker
+*
+* @return 0 on success, -1 on failure
+*******************************************************************************/
+int8_t runFleetPool(void *(*worker)(void *)) {
+  pthread_t threads[fleet.threads];
+  int8_t result = 0;
+
+  atomic_store(&fleet.nextFeeder, 0);
+
+  for (uint16_t i = 0; i < fleet.threads; i++) {
+    if (pthread_create(&threads[i], NULL, worker, NULL) != 0) return -1;
+  }
+
+  for (uint16_t i = 0; i < fleet.threads; i++) {
+    void *threadResult;
+    pthread_join(threads[i], &threadResult);
+    if (threadResult != NULL) result = -1;
+  }
+
+  return result;
+}
+
+/*******************************************************************************
+* getElapsedTime
+*
+* @brief Returns the time since a monotonic time
+*
+* @param[in] start The monotonic time
+*
+* @return Elapsed time [s]
+*******************************************************************************/
+double getElapsedTime(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (now.tv_sec - start->tv_sec) + (now.tv_nsec - start->tv_nsec) / 1e9;
+}
+
+int main(int argc, char *argv[]) {
+  uint32_t positional = 0;
+
+  fleet.feedersCount = FLEET_FEEDERS;
+  fleet.days = FLEET_DAYS;
+  fleet.threads = FLEET_THREADS;
+  fleet.step = FLEET_STEP;
+  fleet.metricsInterval = FLEET_METRICS_INTERVAL;
+  fleet.restartRate = FLEET_RESTART_RATE;
+  fleet.directory = FLEET_DIRECTORY;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      fleet.threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--step") == 0 && i + 1 < argc) {
+      fleet.step = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--metrics-interval") == 0 && i + 1 < argc) {
+      fleet.metricsInterval = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--restart-rate") == 0 && i + 1 < argc) {
+      fleet.restartRate = atof(argv[++i]);
+    } else if (strcmp(argv[i], "--dir") == 0 && i + 1 < argc) {
+      fleet.directory = argv[++i];
+    } else if (positional++ == 0) {
+      fleet.feedersCount = atoi(argv[i]);
+    } else {
+      fleet.days = atoi(argv[i]);
+    }
+  }
+  if (fleet.feedersCount == 0) fleet.feedersCount = 1;
+  if (fleet.days == 0) fleet.days = 1;
+  if (fleet.threads == 0) fleet.threads = 1;
+  if (fleet.step == 0) fleet.step = 1;
+
+  if (mkdir(fleet.directory, 0755) != 0 && errno != EEXIST) {
+    fprintf(stderr, "Error during fleet directory creation: %s\n", strerror(errno));
+    return 1;
+  }
+  fleet.startTime = getFleetTime(0, 0);
+
+  uint64_t memoryBefore = getResidentMemory();
+  struct timespec start;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  fleet.feeders = calloc(fleet.feedersCount, sizeof(fleetFeederS));
+  if (fleet.feeders == NULL || runFleetPool(setupWorker) != 0) {
+    fprintf(stderr, "Error during fleet setup\n");
+    return 1;
+  }
+
+  double setupTime = getElapsedTime(&start);
+  uint64_t memoryAfter = getResidentMemory();
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  if (runFleetPool(simulationWorker) != 0) {
+    fprintf(stderr, "Error during fleet simulation\n");
+    return 1;
+  }
+
+  double simulationTime = getElapsedTime(&start);
+
+  fleetStatsS total = {0};
+  uint32_t failingFeeders = 0;
+  for (uint32_t i = 0; i < fleet.feedersCount; i++) {
+    fleetStatsS *stats = &fleet.feeders[i].stats;
+    total.expected += stats->expected;
+    total.onTime += stats->onTime;
+    total.late += stats->late;
+    total.missed += stats->missed;
+    total.duplicated += stats->duplicated;
+    total.interrupted += stats->interrupted;
+    total.portionMismatches += stats->portionMismatches;
+    total.treats += stats->treats;
+    total.dispensedPortions += stats->dispensedPortions;
+    total.cancelledJobs += stats->cancelledJobs;
+    total.interruptedJobs += stats->interruptedJobs;
+    total.restarts += stats->restarts;
+    total.scheduleChanges += stats->scheduleChanges;
+    if (stats->missed > 0 || stats->duplicated > 0) failingFeeders++;
+  }
+
+  printf("%u feeders, %hu days, %hu threads, %u s step, %u s metrics interval, %u hoppers\n",
+    fleet.feedersCount, fleet.days, fleet.threads, fleet.step, fleet.metricsInterval, HOPPERS_COUNT);
+  printf("%-24s %10.2f s\n", "setup", setupTime);
+  printf("%-24s %10.2f s\n", "simulation", simulationTime);
+  printf("%-24s %10.0f\n", "feeder-days per second", fleet.feedersCount * fleet.days / simulationTime);
+  printf("%-24s %10zu B\n", "feeder context", sizeof(feederS));
+  printf("%-24s %10llu B\n", "memory per feeder",
+    (unsigned long long)((memoryAfter - memoryBefore) / fleet.feedersCount));
+  printf("%-24s %10llu\n", "feedings due", (unsigned long long)total.expected);
+  printf("%-24s %10llu\n", "on time", (unsigned long long)total.onTime);
+  printf("%-24s %10llu\n", "late", (unsigned long long)total.late);
+  printf("%-24s %10llu\n", "lost by a restart", (unsigned long long)total.interrupted);
+  printf("%-24s %10llu\n", "missed", (unsigned long long)total.missed);
+  printf("%-24s %10llu\n", "duplicated", (unsigned long long)total.duplicated);
+  printf("%-24s %10llu\n", "portion mismatches", (unsigned long long)total.portionMismatches);
+  printf("%-24s %10llu\n", "treats pressed", (unsigned long long)total.treats);
+  printf("%-24s %10llu\n", "portions dispensed", (unsigned long long)total.dispensedPortions);
+  printf("%-24s %10llu\n", "jobs cancelled", (unsigned long long)total.cancelledJobs);
+  printf("%-24s %10llu\n", "restarts", (unsigned long long)total.restarts);
+  printf("%-24s %10llu\n", "jobs cut by a restart", (unsigned long long)total.interruptedJobs);
+  printf("%-24s %10llu\n", "schedules changed", (unsigned long long)total.scheduleChanges);
+  printf("%-24s %10u\n", "failing feeders", failingFeeders);
+
+  return failingFeeders > 0 ? 1 : 0;
+}
@@ -0,0 +1,11 @@
+#ifndef softPwm_h
+#define softPwm_h
+
+// Software PWM of WiringPi, implemented by the simulator in wiringPiSim.c for
+// host builds
+
+int softPwmCreate(int pin, int initialValue, int pwmRange);
+void softPwmWrite(int pin, int value);
+void softPwmStop(int pin);
+
+#endif // softPwm_h
@@ -0,0 +1,43 @@
+#ifndef wiringPi_h
+#define wiringPi_h
+
+// Subset of the WiringPi API used by the feeder, implemented by the simulator
+// in wiringPiSim.c for host builds
+
+#define INPUT 0
+#define OUTPUT 1
+#define PWM_OUTPUT 2
+
+#define LOW 0
+#define HIGH 1
+
+#define PUD_OFF 0
+#define PUD_DOWN 1
+#define PUD_UP 2
+
+#define INT_EDGE_SETUP 0
+#define INT_EDGE_FALLING 1
+#define INT_EDGE_RISING 2
+#define INT_EDGE_BOTH 3
+
+#define PWM_MODE_MS 0
+#define PWM_MODE_BAL 1
+
+int wiringPiSetupGpio(void);
+void pinMode(int pin, int mode);
+void pullUpDnControl(int pin, int pud);
+int digitalRead(int pin);
+void digitalWrite(int pin, int value);
+void pwmWrite(int pin, int value);
+void pwmSetMode(int mode);
+void pwmSetRange(unsigned int range);
+void pwmSetClock(int divisor);
+int wiringPiISR(int pin, int mode, void (*function)(void));
+int wiringPiISRStop(int pin);
+int piHiPri(const int pri);
+unsigned int millis(void);
+unsigned int micros(void);
+void delay(unsigned int howLong);
+void delayMicroseconds(unsigned int howLong);
+
+#endif // wiringPi_h
@@ -0,0 +1,10 @@
+#ifndef wiringPiI2C_h
+#define wiringPiI2C_h
+
+// Subset of the WiringPi I2C API used by the feeder, the simulator discards
+// all writes
+
+int wiringPiI2CSetup(const int devId);
+int wiringPiI2CWrite(int fd, int data);
+
+#endif // wiringPiI2C_h
@@ -0,0 +1,626 @@
+// Closed-loop benchmark of the motor controller against the simulated plant.
+// Runs rotateMotor() on the host through the WiringPi simulator and reports
+// settle time, overshoot, final error and encoder count accuracy per scenario,
+// brake mode, encoder sampling and feed mode, and the wheel angle drift with the
+// nominal and the calibrated encoder ticks. With several hoppers the feed of
+// all hoppers at once is compared with a feed of a single hopper. Exits with 1
+// if a move without a permanent jam is given up, a move is aborted, an encoder
+// calibration accepts a wrong value, or a feed mode doesn't count its portions,
+// doesn't end on the right arm or moves the wheel back while holding at a
+// boundary
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/resource.h>
+#include <wiringPi.h>
+#include "sim.h"
+#include "../config.h"
+#include "../libs/logger.h"
+#include "../libs/motor.h"
+#include "../libs/metrics.h"
+#include "../libs/watchdog.h"
+#include "../libs/autotune.h"
+#include "../libs/friction.h"
+#include "../libs/feeding.h"
+#include "../libs/dispenser.h"
+#include "../libs/trace.h"
+#include "../libs/encoder.h"
+#include "../libs/context.h"
+#include "../libs/tools.h"
+
+#define BENCH_WHEEL_ARMS 6
+#define BENCH_FEED_PORTIONS 6
+#define BENCH_REST_TIME 50 // Time without an edge after which the wheel is at rest [ms]
+#define BENCH_DRIFT_MOVES 8 // Moves of BENCH_DRIFT_DEGREES over which the wheel angle drift is measured
+#define BENCH_DRIFT_DEGREES 90
+#define BENCH_ARM_TOLERANCE 4 // Largest distance from the arm boundary at the end of a feed [ticks]
+#define BENCH_DWELL_REVERSE 4 // Largest backward motion while holding at a step boundary [ticks]
+#define BENCH_ENCODER_TOLERANCE 2 // Largest error of an accepted encoder calibration [tick/rev]
+
+typedef struct benchScenarioS {
+  const char *name;
+  int32_t degrees; // Rotation of every move
+  float loadTorque; // Constant load at the output shaft [Nm]
+  float jamAngle; // Jam position ahead of the wheel [deg], negative to disable
+  uint8_t jamHits; // Number of times the jam blocks, 0 for a jam which never clears
+  bool isFaultExpected; // Whether or not every move has to be given up
+} benchScenarioS;
+
+const benchScenarioS benchScenarios[] = {
+  {"90 deg, nominal load", 90, 0.05, -1, 0, false},
+  {"45 deg, nominal load", 45, 0.05, -1, 0, false},
+  {"90 deg, heavy load", 90, 0.25, -1, 0, false},
+  {"90 deg, jam once", 90, 0.05, 30, 1, false},
+  {"90 deg, permanent jam", 90, 0.05, 30, 0, true}
+};
+
+feederS feeder;
+
+/*******************************************************************************
+* runScenario
+*
+* @brief Runs the moves of a scenario and prints their statistics. The
+*        scenario fails if a move is aborted or if not exactly the moves of a
+*        permanent jam are given up
+*
+* @param[in] scenario The scenario to run
+* @param[in] moves Number of moves to run
+*
+* @return 0 on success, -1 if the scenario failed
+*******************************************************************************/
+int8_t runScenario(const benchScenarioS *scenario, uint16_t moves) {
+  motorS *motor = getMotor(&feeder, 0);
+  uint32_t settleSum = 0, settleMax = 0, plannedSum = 0, moveTimeMax = 0;
+  float overshootSum = 0, overshootMax = 0, peakVelocityMax = 0;
+  int32_t errorMax = 0;
+  int64_t countErrorMax = 0;
+  uint16_t settled = 0, faults = 0, aborts = 0;
+  uint64_t jamsBefore = metricsGetHopperCounter(&feeder, 0, METRIC_MOTOR_JAMS);
+
+  for (uint16_t i = 0; i < moves; i++) {
+    plantS *plant = simLockPlant(0);
+    plant->params.loadTorque = scenario->loadTorque;
+    plant->params.jamHits = scenario->jamHits;
+    plant->jamHitsLeft = scenario->jamHits;
+    plant->params.jamAngle = -1;
+    if (scenario->jamAngle >= 0) {
+      float angle = fmodf(plantOutputAngle(plant) + scenario->jamAngle, 360);
+      plant->params.jamAngle = angle < 0 ? angle + 360 : angle;
+    }
+    int64_t plantCountStart = plant->encoderCount;
+    simUnlockPlant(0);
+    int64_t positionStart = getEncoderPosition(motor);
+
+    uint32_t moveStart = millis();
+    rotateMotor(motor, scenario->degrees);
+    uint32_t moveTime = millis() - moveStart;
+    delay(200);
+
+    plant = simLockPlant(0);
+    int64_t plantCount = plant->encoderCount - plantCountStart;
+    simUnlockPlant(0);
+
+    motorMoveResultS result = getLastMoveResult(motor);
+    int64_t countError = llabs(plantCount - (getEncoderPosition(motor) - positionStart));
+
+    plannedSum += result.plannedTime;
+    if (moveTime > moveTimeMax) moveTimeMax = moveTime;
+    if (!result.isFaulted && !result.isAborted) {
+      settled++;
+      settleSum += result.settleTime;
+      if (result.settleTime > settleMax) settleMax = result.settleTime;
+    }
+    overshootSum += result.overshoot;
+    if (result.overshoot > overshootMax) overshootMax = result.overshoot;
+    if (result.peakVelocity > peakVelocityMax) peakVelocityMax = result.peakVelocity;
+    if (abs(result.finalError) > errorMax) errorMax = abs(result.finalError);
+    if (countError > countErrorMax) countErrorMax = countError;
+    if (result.isFaulted) faults++;
+    if (result.isAborted) aborts++;
+  }
+
+  printf("%-24s %5hu %8u %8u %8u %8u %8.2f %8.2f %6.0f %6d %6lld %5llu %5hu %5hu\n",
+    scenario->name, moves, settled > 0 ? settleSum / settled : 0, settleMax, plannedSum / moves, moveTimeMax,
+    overshootSum / moves, overshootMax, peakVelocityMax, errorMax, (long long)countErrorMax,
+    (unsigned long long)(metricsGetHopperCounter(&feeder, 0, METRIC_MOTOR_JAMS) - jamsBefore), faults, aborts);
+
+  if (faults != (scenario->isFaultExpected ? moves : 0) || aborts > 0) {
+    fprintf(stderr, "Scenario %s failed\n", scenario->name);
+    return -1;
+  }
+
+  return 0;
+}
+
+/*******************************************************************************
+* getNearestArm
+*
+* @brief Returns the arm boundary of the wheel closest to the encoder position
+*        of the first hopper
+*
+* @param[in] portionDegrees Angle between the arms [deg]
+*
+* @return Number of the boundary, 0 at the absolute position 0
+*******************************************************************************/
+int64_t getNearestArm(int32_t portionDegrees) {
+  motorS *motor = getMotor(&feeder, 0);
+
+  // The encoder counts down when moving forward, the boundaries count up
+  return llround(-getEncoderPosition(motor) / (portionDegrees * (double)motor->config.ticksPerRevolution / 360));
+}
+
+/*******************************************************************************
+* getDwellReverse
+*
+* @brief Returns the largest backward motion of the wheel while it held at a
+*        step boundary during the last traced move of the first hopper
+*
+* @return The backward motion [ticks], 0 without a trace
+*******************************************************************************/
+int32_t getDwellReverse() {
+  if (feeder.trace.rings == NULL) return 0;
+
+  traceRingS *ring = &feeder.trace.rings[0];
+  uint32_t moveHead = atomic_load(&ring->moveHead);
+  if (moveHead == 0) return 0;
+
+  const traceMoveS *move = &ring->moves[(moveHead - 1) % TRACE_MOVES];
+  uint32_t first = move->firstSample;
+  if (move->samples > TRACE_SAMPLES) first += move->samples - TRACE_SAMPLES;
+
+  int32_t reverse = 0;
+  int32_t dwellStart = 0;
+  bool isDwelling = false;
+
+  // The encoder counts down when moving forward
+  for (uint32_t i = first; i != move->firstSample + move->samples; i++) {
+    const traceSampleS *sample = &ring->samples[i % TRACE_SAMPLES];
+
+    if (sample->state != MOTOR_STATE_DWELLING) {
+      isDwelling = false;
+      continue;
+    }
+    if (!isDwelling) {
+      isDwelling = true;
+      dwellStart = sample->position;
+    }
+    if (sample->position - dwellStart > reverse) reverse = sample->position - dwellStart;
+  }
+
+  return reverse;
+}
+
+/*******************************************************************************
+* runFeedModes
+*
+* @brief Feeds the same amount of portions in every feed mode and prints the
+*        duration of the feed, the counted portions, the arms the wheel turned
+*        by, the distance from the arm boundary at the end and the largest
+*        backward motion while holding at a boundary. A feed which doesn't end
+*        on the right arm or moves the wheel back during a dwell fails
+*
+* @param[in] portions Portions of every feed
+*
+* @return 0 on success, -1 if a feed mode failed
+*******************************************************************************/
+int8_t runFeedModes(uint8_t portions) {
+  const char *modeNames[] = {"separate", "batch", "dwell"};
+  motorS *motor = getMotor(&feeder, 0);
+  int32_t portionDegrees = 360 / BENCH_WHEEL_ARMS;
+  int8_t result = 0;
+
+  printf("\n%-24s %8s %8s %8s %6s %7s\n", "feed mode", "time", "portions", "arms", "error", "reverse");
+  printf("%-24s %8s %8s %8s %6s %7s\n", "", "[ms]", "", "", "[tick]", "[tick]");
+
+  for (uint8_t mode = 0; mode < FEED_MODES_COUNT; mode++) {
+    plantS *plant = simLockPlant(0);
+    plant->params.loadTorque = 0.05;
+    plant->params.jamAngle = -1;
+    simUnlockPlant(0);
+
+    uint64_t portionsBefore = metricsGetHopperCounter(&feeder, 0, METRIC_PORTIONS_DISPENSED);
+    int64_t armStart = getNearestArm(portionDegrees);
+    uint32_t feedStart = millis();
+    dispenseJobS job = {.source = DISPENSE_SOURCE_SCHEDULE, .portions = portions, .mode = mode};
+    dispense(&feeder, &job);
+    uint32_t feedTime = millis() - feedStart;
+
+    int64_t armEnd = getNearestArm(portionDegrees);
+    int64_t armError = -getEncoderPosition(motor) - wheelBoundary(motor, armEnd, portionDegrees);
+    int32_t reverse = mode == FEED_MODE_DWELL ? getDwellReverse() : 0;
+
+    uint64_t counted = metricsGetHopperCounter(&feeder, 0, METRIC_PORTIONS_DISPENSED) - portionsBefore;
+
+    printf("%-24s %8u %8llu %8lld %6lld %7d\n", modeNames[mode], feedTime, (unsigned long long)counted,
+      (long long)(armEnd - armStart), (long long)armError, reverse);
+
+    if (counted != portions || armEnd - armStart != portions || llabs(armError) > BENCH_ARM_TOLERANCE || reverse > BENCH_DWELL_REVERSE) {
+      fprintf(stderr, "Feed mode %s failed\n", modeNames[mode]);
+      result = -1;
+    }
+  }
+
+  return result;
+}
+
+/*******************************************************************************
+* runConcurrentHoppers
+*
+* @brief Feeds the same amount of portions from the first hopper alone and then
+*        from all hoppers at once through their dispensers and prints the
+*        duration and the settle time of the last move of every hopper. The
+*        control loops of the hoppers run in parallel, so the feed of all
+*        hoppers takes as long as the feed of one
+*
+* @param[in] portions Portions of every feed
+*******************************************************************************/
+void runConcurrentHoppers(uint8_t portions) {
+  printf("\n%-24s %8s", "hoppers", "time");
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) printf(" %7s%hhu", "settle", i + 1);
+  printf("\n%-24s %8s", "", "[ms]");
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) printf(" %8s", "[ms]");
+  printf("\n");
+
+  for (uint8_t hoppers = 1; hoppers <= HOPPERS_COUNT; hoppers += HOPPERS_COUNT - 1) {
+    for (uint8_t i = 0; i < hoppers; i++) {
+      plantS *plant = simLockPlant(i);
+      plant->params.loadTorque = 0.05;
+      plant->params.jamAngle = -1;
+      simUnlockPlant(i);
+    }
+
+    uint32_t feedStart = millis();
+    for (uint8_t i = 0; i < hoppers; i++) {
+      queueDispense(&feeder, i, DISPENSE_SOURCE_SCHEDULE, portions, FEED_MODE_BATCH);
+    }
+    // Wait for the workers to pick up the jobs and to finish them
+    delay(10);
+    for (uint8_t i = 0; i < hoppers; i++) {
+      dispenseProgressS progress;
+      while ((progress = getDispenseProgress(&feeder, i)).isDispensing || progress.queuedJobs > 0) delay(1);
+    }
+    uint32_t feedTime = millis() - feedStart;
+
+    char name[25];
+    sprintf(name, "%hhu of %d at once", hoppers, HOPPERS_COUNT);
+    printf("%-24s %8u", name, feedTime);
+    for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+      if (i < hoppers) printf(" %8u", getLastMoveResult(getMotor(&feeder, i)).settleTime);
+      else printf(" %8s", "-");
+    }
+    printf("\n");
+  }
+}
+
+/*******************************************************************************
+* runBrakeModes
+*
+* @brief Runs the same moves in every brake mode and prints the settle time and
+*        the error at the end of the move and after the wheel came to rest.
+*        Stopping the motor from the full output limit shows the stopping
+*        distance and time without the controller
+*
+* @param[in] scenario The scenario to run
+* @param[in] moves Number of moves in every mode
+*******************************************************************************/
+void runBrakeModes(const benchScenarioS *scenario, uint16_t moves) {
+  motorS *motor = getMotor(&feeder, 0);
+  motorBrakeModeE configuredMode = getMotorBrakeMode(motor);
+
+  printf("\n%-24s %8s %8s %8s %6s %6s %8s %8s\n", "brake mode", "settle", "max", "overshot", "error", "rest", "stop", "stop");
+  printf("%-24s %8s %8s %8s %6s %6s %8s %8s\n", "", "[ms]", "[ms]", "[deg]", "[tick]", "[tick]", "[deg]", "[ms]");
+
+  for (uint8_t mode = 0; mode < MOTOR_BRAKE_MODES_COUNT; mode++) {
+    setMotorBrakeMode(motor, mode);
+
+    uint32_t settleSum = 0, settleMax = 0;
+    float overshootSum = 0;
+    int32_t errorMax = 0, restErrorMax = 0;
+
+    for (uint16_t i = 0; i < moves; i++) {
+      plantS *plant = simLockPlant(0);
+      plant->params.loadTorque = scenario->loadTorque;
+      plant->params.jamAngle = -1;
+      simUnlockPlant(0);
+
+      rotateMotor(motor, scenario->degrees);
+      motorMoveResultS result = getLastMoveResult(motor);
+      int64_t moveEnd = getEncoderPosition(motor);
+
+      // A coasting wheel keeps drifting after the move
+      delay(200);
+      int32_t restError = result.finalError + (getEncoderPosition(motor) - moveEnd);
+
+      settleSum += result.settleTime;
+      if (result.settleTime > settleMax) settleMax = result.settleTime;
+      overshootSum += result.overshoot;
+      if (abs(result.finalError) > errorMax) errorMax = abs(result.finalError);
+      if (abs(restError) > restErrorMax) restErrorMax = abs(restError);
+    }
+
+    // Stop from full speed until no edge arrived for BENCH_REST_TIME
+    driveMotor(motor, MOTOR_PWM_RANGE * MOTOR_JAM_BASE_EFFORT);
+    delay(300);
+    int64_t stopStart = getEncoderPosition(motor), stopPosition = stopStart;
+    uint32_t stopStartTime = millis(), lastEdgeTime = stopStartTime;
+    stopMotor(motor);
+    while (millis() - lastEdgeTime < BENCH_REST_TIME) {
+      delay(1);
+      if (getEncoderPosition(motor) != stopPosition) {
+        stopPosition = getEncoderPosition(motor);
+        lastEdgeTime = millis();
+      }
+    }
+
+    printf("%-24s %8u %8u %8.2f %6d %6d %8.1f %8u\n", getMotorBrakeModeName(mode),
+      settleSum / moves, settleMax, overshootSum / moves, errorMax, restErrorMax,
+      llabs(stopPosition - stopStart) / getEncoderTicksPerDegree(motor), lastEdgeTime - stopStartTime);
+  }
+
+  setMotorBrakeMode(motor, configuredMode);
+}
+
+/*******************************************************************************
+* runEncoderSamplings
+*
+* @brief Runs the same moves with every encoder sampling and prints the count
+*        accuracy and the CPU cost per move. The CPU time [ms of CPU] and the
+*        context switches are those of the whole process including the plant,
+*        so only their differences between the samplings matter
+*
+* @param[in] scenario The scenario to run
+* @param[in] moves Number of moves with every sampling
+*******************************************************************************/
+void runEncoderSamplings(const benchScenarioS *scenario, uint16_t moves) {
+  motorS *motor = getMotor(&feeder, 0);
+  encoderSamplingE configuredSampling = getEncoderSampling(&feeder);
+
+  printf("\n%-24s %8s %6s %7s %8s %8s %8s %8s %8s\n",
+    "encoder sampling", "settle", "count", "illegal", "edges", "samples", "switches", "cpu", "switches");
+  printf("%-24s %8s %6s %7s %8s %8s %8s %8s %8s\n",
+    "", "[ms]", "[tick]", "[total]", "[move]", "[move]", "[total]", "[move]", "[move]");
+
+  for (uint8_t sampling = 0; sampling < ENCODER_SAMPLINGS_COUNT; sampling++) {
+    setEncoderSampling(&feeder, sampling);
+    delay(10);
+
+    uint32_t settleSum = 0;
+    int64_t countErrorMax = 0;
+    uint64_t edgesBefore = metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_EDGES);
+    uint64_t illegalBefore = metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_ILLEGAL_TRANSITIONS);
+    uint64_t samplesBefore = metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_SAMPLES);
+    uint64_t switchesBefore = metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_MODE_SWITCHES);
+    double cpuTime = 0;
+    long contextSwitches = 0;
+
+    for (uint16_t i = 0; i < moves; i++) {
+      plantS *plant = simLockPlant(0);
+      plant->params.loadTorque = scenario->loadTorque;
+      plant->params.jamAngle = -1;
+      int64_t plantCountStart = plant->encoderCount;
+      simUnlockPlant(0);
+      int64_t positionStart = getEncoderPosition(motor);
+
+      struct timespec cpuStart, cpuEnd;
+      struct rusage usageStart, usageEnd;
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuStart);
+      getrusage(RUSAGE_SELF, &usageStart);
+
+      rotateMotor(motor, scenario->degrees);
+
+      clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &cpuEnd);
+      getrusage(RUSAGE_SELF, &usageEnd);
+      cpuTime += (cpuEnd.tv_sec - cpuStart.tv_sec) * 1000.0 + (cpuEnd.tv_nsec - cpuStart.tv_nsec) / 1.0e6;
+      contextSwitches += (usageEnd.ru_nvcsw - usageStart.ru_nvcsw) + (usageEnd.ru_nivcsw - usageStart.ru_nivcsw);
+
+      delay(200);
+
+      plant = simLockPlant(0);
+      int64_t plantCount = plant->encoderCount - plantCountStart;
+      simUnlockPlant(0);
+
+      int64_t countError = llabs(plantCount - (getEncoderPosition(motor) - positionStart));
+      if (countError > countErrorMax) countErrorMax = countError;
+      settleSum += getLastMoveResult(motor).settleTime;
+    }
+
+    printf("%-24s %8u %6lld %7llu %8llu %8llu %8llu %8.1f %8ld\n", getEncoderSamplingName(sampling),
+      settleSum / moves, (long long)countErrorMax,
+      (unsigned long long)(metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_ILLEGAL_TRANSITIONS) - illegalBefore),
+      (unsigned long long)(metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_EDGES) - edgesBefore) / moves,
+      (unsigned long long)(metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_SAMPLES) - samplesBefore) / moves,
+      (unsigned long long)(metricsGetHopperCounter(&feeder, 0, METRIC_ENCODER_MODE_SWITCHES) - switchesBefore),
+      cpuTime / moves, contextSwitches / moves);
+  }
+
+  setEncoderSampling(&feeder, configuredSampling);
+}
+
+/*******************************************************************************
+* measureDrift
+*
+* @brief Runs BENCH_DRIFT_MOVES moves and measures how far the output shaft of
+*        the plant ended up from where the moves should have taken it. The
+*        first move brings the wheel to a boundary
+*
+* @return The drift of the wheel angle [deg]
+*******************************************************************************/
+float measureDrift() {
+  motorS *motor = getMotor(&feeder, 0);
+  rotateMotor(motor, BENCH_DRIFT_DEGREES);
+  delay(200);
+
+  plantS *plant = simLockPlant(0);
+  plant->params.loadTorque = benchScenarios[0].loadTorque;
+  plant->params.jamAngle = -1;
+  float angleStart = plantOutputAngle(plant);
+  simUnlockPlant(0);
+
+  for (uint8_t i = 0; i < BENCH_DRIFT_MOVES; i++) {
+    rotateMotor(motor, BENCH_DRIFT_DEGREES);
+  }
+  delay(200);
+
+  plant = simLockPlant(0);
+  float angle = plantOutputAngle(plant) - angleStart;
+  simUnlockPlant(0);
+
+  return angle - BENCH_DRIFT_MOVES * BENCH_DRIFT_DEGREES;
+}
+
+/*******************************************************************************
+* runEncoderCalibration
+*
+* @brief Calibrates the encoder on gearboxes with the nominal and a different
+*        ratio and prints the measured and the true ticks per revolution and
+*        the wheel angle drift with the nominal and the calibrated value
+*
+* @return 0 if every accepted calibration is within BENCH_ENCODER_TOLERANCE of
+*         the true ticks per revolution, -1 otherwise
+*******************************************************************************/
+int8_t runEncoderCalibration() {
+  int8_t result = 0;
+  motorS *motor = getMotor(&feeder, 0);
+  const float gearRatios[] = {MOTOR_GEAR_RATIO, 75.5};
+  float configuredTicks = getEncoderTicksPerDegree(motor) * 360;
+  float nominalTicks = MOTOR_ENCODER_TICKS_PER_DEGREE * 360;
+
+  printf("\n%-24s %10s %10s %10s %10s\n", "encoder calibration", "true", "measured", "nominal", "calibrated");
+  printf("%-24s %10s %10s %10s %10s\n", "", "[tick/rev]", "[tick/rev]", "[deg]", "[deg]");
+
+  for (uint8_t i = 0; i < sizeof(gearRatios) / sizeof(gearRatios[0]); i++) {
+    plantS *plant = simLockPlant(0);
+    plant->params.gearRatio = gearRatios[i];
+    float trueTicks = plant->params.countsPerRevolution * gearRatios[i];
+    simUnlockPlant(0);
+
+    setEncoderTicksPerRevolution(motor, nominalTicks);
+    float nominalDrift = measureDrift();
+
+    float measuredTicks = 0;
+    float calibratedDrift = NAN;
+    if (calibrateEncoder(motor) == 0) {
+      measuredTicks = getEncoderTicksPerDegree(motor) * 360;
+      calibratedDrift = measureDrift();
+    }
+
+    char name[25];
+    sprintf(name, "gear ratio %.2f", gearRatios[i]);
+    printf("%-24s %10.2f %10.2f %10.2f %10.2f\n", name, trueTicks, measuredTicks, nominalDrift, calibratedDrift);
+
+    if (measuredTicks != 0 && fabsf(measuredTicks - trueTicks) > BENCH_ENCODER_TOLERANCE) {
+      fprintf(stderr, "Encoder calibration of %s accepted a wrong value\n", name);
+      result = -1;
+    }
+  }
+
+  plantS *plant = simLockPlant(0);
+  plant->params.gearRatio = pololu2286Params.gearRatio;
+  simUnlockPlant(0);
+  setEncoderTicksPerRevolution(motor, configuredTicks);
+
+  return result;
+}
+
+int main(int argc, char *argv[]) {
+  uint16_t moves = 5;
+  bool isAutotuneRequested = false;
+  bool isCalibrationRequested = false;
+  bool isEncoderCalibrationRequested = false;
+
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--autotune") == 0) {
+      isAutotuneRequested = true;
+    } else if (strcmp(argv[i], "--calibrate-friction") == 0) {
+      isCalibrationRequested = true;
+    } else if (strcmp(argv[i], "--calibrate-encoder") == 0) {
+      isEncoderCalibrationRequested = true;
+    } else {
+      moves = atoi(argv[i]);
+    }
+  }
+  if (moves == 0) moves = 1;
+
+  initFeederContext(&feeder, "");
+
+  if (initLogger(&feeder) != 0) {
+    fprintf(stderr, "Error during logger initialization\n");
+    return 1;
+  }
+
+  wiringPiSetupGpio();
+  initTrace(&feeder);
+
+  // Every run starts from the shipped configuration, files left by an earlier run are ignored
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    char fileName[FEEDER_FILE_NAME_LENGTH];
+    getHopperFileName(fileName, sizeof(fileName), feeder.directory, MOTOR_CONFIG_FILE, i);
+    remove(fileName);
+    getHopperFileName(fileName, sizeof(fileName), feeder.directory, MOTOR_POSITION_FILE, i);
+    remove(fileName);
+  }
+
+  if (initMotor(&feeder) != 0) {
+    fprintf(stderr, "Error during motor initialization\n");
+    return 1;
+  }
+  motorS *motor = getMotor(&feeder, 0);
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    setFeedingWheelArms(&feeder, i, BENCH_WHEEL_ARMS);
+  }
+
+  // Moves which never settle are aborted by the move budget like on the feeder
+  if (initWatchdog(&feeder) != 0) {
+    fprintf(stderr, "Error during watchdog initialization\n");
+    return 1;
+  }
+
+  if (isEncoderCalibrationRequested && calibrateEncoder(motor) != 0) {
+    fprintf(stderr, "Error during encoder calibration\n");
+    return 1;
+  }
+
+  if (isCalibrationRequested && calibrateFriction(motor) != 0) {
+    fprintf(stderr, "Error during friction calibration\n");
+    return 1;
+  }
+
+  if (isAutotuneRequested && autotuneMotor(motor, getFeedingWheelArms(&feeder, 0)) != 0) {
+    fprintf(stderr, "Error during motor auto-tuning\n");
+    return 1;
+  }
+
+  printf("%-24s %5s %8s %8s %8s %8s %8s %8s %6s %6s %6s %5s %5s %5s\n",
+    "scenario", "moves", "settle", "max", "planned", "move max", "overshot", "max", "peak", "error", "count", "jams", "fault", "abort");
+  printf("%-24s %5s %8s %8s %8s %8s %8s %8s %6s %6s %6s %5s %5s %5s\n",
+    "", "", "[ms]", "[ms]", "[ms]", "[ms]", "[deg]", "[deg]", "[deg/s]", "[tick]", "[tick]", "", "", "");
+
+  int8_t result = 0;
+  for (uint8_t i = 0; i < sizeof(benchScenarios) / sizeof(benchScenarios[0]); i++) {
+    if (runScenario(&benchScenarios[i], moves) != 0) result = -1;
+  }
+
+  runBrakeModes(&benchScenarios[0], moves);
+  runEncoderSamplings(&benchScenarios[0], moves);
+  if (runEncoderCalibration() != 0) result = -1;
+  if (runFeedModes(BENCH_FEED_PORTIONS) != 0) result = -1;
+
+  if (HOPPERS_COUNT > 1) {
+    if (initDispenser(&feeder) != 0) {
+      fprintf(stderr, "Error during dispenser initialization\n");
+      return 1;
+    }
+    runConcurrentHoppers(BENCH_FEED_PORTIONS);
+  }
+
+  // Trace of the last moves, dumped after the jam scenarios
+  handleTrace(&feeder);
+
+  return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,209 @@
+#include "plant.h"
+#include <math.h>
+
+// AB states in the order the feeder decoder counts up, see quadratureTable
+const uint8_t plantEncoderSequence[4] = {0, 2, 3, 1};
+
+// Pololu 2286, 6V LP 75:1 gearmotor with 48 CPR encoder, datasheet values:
+// 130 RPM and 0.11 A free run, 2.4 A and about 0.67 Nm at stall
+const plantParamsS pololu2286Params = {
+  .supplyVoltage = 6.0,
+  .resistance = 2.5,
+  .inductance = 0.0015,
+  .torqueConstant = 0.0056,
+  .backEmfConstant = 0.0056,
+  .rotorInertia = 1.0e-7,
+  .loadInertia = 4.0e-5,
+  .gearRatio = 74.83,
+  .gearEfficiency = 0.65,
+  .coulombFriction = 0.00062,
+  .staticFriction = 0.0009,
+  .viscousFriction = 1.0e-7,
+  .countsPerRevolution = 48,
+  .loadTorque = 0.05,
+  .loadRipple = 0.03,
+  .wheelArms = 4,
+  .jamAngle = -1,
+  .jamWidth = 10,
+  .jamTorque = 2.0,
+  .jamHits = 1,
+  .indexWidth = 5
+};
+
+/*******************************************************************************
+* plantInit
+*
+* @brief Initializes the plant at rest with the given parameters
+*
+* @param[out] plant The plant to initialize
+* @param[in] params Motor, gearbox, load and jam parameters
+*******************************************************************************/
+void plantInit(plantS *plant, const plantParamsS *params) {
+  *plant = (plantS){0};
+  plant->params = *params;
+  plant->jamHitsLeft = params->jamHits;
+  plant->encoderState = plantEncoderSequence[0];
+}
+
+/*******************************************************************************
+* plantSetDuty
+*
+* @brief Sets the duty of both motor driver inputs. Positive voltage (M1B above
+*        M1A) turns the motor forward, both inputs at 0 leave the motor
+*        terminals open so it coasts. Both inputs at the same duty short the
+*        terminals for that fraction of the period, which brakes the motor
+*
+* @param[in] plant The plant
+* @param[in] dutyA Duty of the M1A input, 0 - 1
+* @param[in] dutyB Duty of the M1B input, 0 - 1
+*******************************************************************************/
+void plantSetDuty(plantS *plant, float dutyA, float dutyB) {
+  plant->dutyA = dutyA;
+  plant->dutyB = dutyB;
+}
+
+/*******************************************************************************
+* plantOutputAngle
+*
+* @brief Returns the angle of the output shaft
+*
+* @param[in] plant The plant
+*
+* @return The unwrapped output shaft angle [deg]
+*******************************************************************************/
+float plantOutputAngle(const plantS *plant) {
+  return plant->angle / plant->params.gearRatio * 180.0 / M_PI;
+}
+
+/*******************************************************************************
+* plantIndexActive
+*
+* @brief Returns whether or not the index mark of the wheel is in front of the
+*        index sensor
+*
+* @param[in] plant The plant
+*
+* @return true once per output revolution for indexWidth degrees
+*******************************************************************************/
+bool plantIndexActive(const plantS *plant) {
+  if (plant->params.indexWidth <= 0) return false;
+
+  float angle = fmodf(plantOutputAngle(plant), 360);
+  if (angle < 0) angle += 360;
+
+  return angle < plant->params.indexWidth;
+}
+
+/*******************************************************************************
+* plantLoadTorque
+*
+* @brief Returns the resistive torque of the load at the motor shaft. The jam
+*        only blocks forward motion, so backing off is free
+*
+* @param[in] plant The plant
+* @param[in] direction Direction of the motion or applied torque
+*
+* @return The magnitude of the resistive torque [Nm]
+*******************************************************************************/
+float plantLoadTorque(plantS *plant, float direction) {
+  const plantParamsS *p = &plant->params;
+  float outputAngle = plantOutputAngle(plant);
+  float load = p->loadTorque + p->loadRipple * fabsf(sinf(p->wheelArms * outputAngle * M_PI / 360.0));
+
+  if (p->jamAngle >= 0) {
+    float wrapped = fmodf(outputAngle, 360);
+    if (wrapped < 0) wrapped += 360;
+
+    bool isInJam = wrapped >= p->jamAngle && wrapped <= p->jamAngle + p->jamWidth;
+
+    // Leaving the jam backwards frees one hit
+    if (plant->isInJam && !isInJam && wrapped < p->jamAngle && plant->jamHitsLeft > 0) {
+      plant->jamHitsLeft--;
+    }
+    plant->isInJam = isInJam;
+
+    if (isInJam && direction > 0 && (p->jamHits == 0 || plant->jamHitsLeft > 0)) {
+      load += p->jamTorque;
+    }
+  }
+
+  return load / (p->gearRatio * p->gearEfficiency);
+}
+
+/*******************************************************************************
+* plantStep
+*
+* @brief Integrates the electrical and mechanical state over one time step
+*
+* @param[in] plant The plant
+* @param[in] deltaT Time step, must be well below the electrical time constant [s]
+*******************************************************************************/
+void plantStep(plantS *plant, float deltaT) {
+  const plantParamsS *p = &plant->params;
+  float inertia = p->rotorInertia + p->loadInertia / (p->gearRatio * p->gearRatio);
+
+  // Electrical, averaged over the PWM period. The driver coasts while both
+  // inputs are low, so the back EMF only drives current during the fraction of
+  // the period in which at least one input is high. Open terminals can't carry
+  // current
+  float conduction = fmaxf(plant->dutyA, plant->dutyB);
+  if (conduction == 0) {
+    plant->current = 0;
+  } else {
+    float voltage = p->supplyVoltage * (plant->dutyB - plant->dutyA);
+    float backEmf = conduction * p->backEmfConstant * plant->velocity;
+    plant->current += (voltage - p->resistance * plant->current - backEmf) / p->inductance * deltaT;
+  }
+
+  // Mechanical
+  float motorTorque = p->torqueConstant * plant->current;
+
+  if (plant->velocity == 0) {
+    // Stiction holds the shaft until the motor torque breaks it away
+    float direction = motorTorque > 0 ? 1 : -1;
+    float holding = p->staticFriction + plantLoadTorque(plant, direction);
+
+    if (fabsf(motorTorque) > holding) {
+      plant->velocity = (motorTorque - direction * holding) / inertia * deltaT;
+    }
+  } else {
+    float direction = plant->velocity > 0 ? 1 : -1;
+    float friction = p->coulombFriction + plantLoadTorque(plant, direction) + p->viscousFriction * fabsf(plant->velocity);
+    float velocity = plant->velocity + (motorTorque - direction * friction) / inertia * deltaT;
+
+    // Friction can stop the shaft but never reverse it
+    if ((velocity > 0) != (plant->velocity > 0) && fabsf(motorTorque) <= friction) {
+      velocity = 0;
+    }
+
+    plant->velocity = velocity;
+  }
+
+  plant->angle += plant->velocity * deltaT;
+}
+
+/*******************************************************************************
+* plantNextEncoderEdge
+*
+* @brief Moves the encoder outputs one count towards the shaft angle. Forward
+*        rotation makes the feeder decoder count down
+*
+* @param[in] plant The plant
+*
+* @return The changed channel, 0 for A and 1 for B, or -1 if the outputs
+*         already match the shaft angle
+*******************************************************************************/
+int8_t plantNextEncoderEdge(plantS *plant) {
+  int64_t count = -(int64_t)floor(plant->angle / (2 * M_PI) * plant->params.countsPerRevolution);
+
+  if (count == plant->encoderCount) return -1;
+
+  plant->encoderCount += count > plant->encoderCount ? 1 : -1;
+
+  uint8_t state = plantEncoderSequence[plant->encoderCount & 3];
+  uint8_t changed = state ^ plant->encoderState;
+  plant->encoderState = state;
+  plant->edges++;
+
+  return changed & 2 ? 0 : 1;
+}
@@ -0,0 +1,54 @@
+#ifndef plant_h
+#define plant_h
+
+#include <stdint.h>
+#include <stdbool.h>
+
+typedef struct plantParamsS {
+  float supplyVoltage; // Motor driver supply [V]
+  float resistance; // Armature resistance [Ohm]
+  float inductance; // Armature inductance [H]
+  float torqueConstant; // [Nm/A]
+  float backEmfConstant; // [V s/rad]
+  float rotorInertia; // Inertia of the rotor and gearbox [kg m^2]
+  float loadInertia; // Inertia of the wheel at the output shaft [kg m^2]
+  float gearRatio; // Motor revolutions per output revolution
+  float gearEfficiency; // Efficiency of the gearbox, 0 - 1
+  float coulombFriction; // Kinetic friction at the motor shaft [Nm]
+  float staticFriction; // Break-away friction at the motor shaft [Nm]
+  float viscousFriction; // [Nm s/rad]
+  uint16_t countsPerRevolution; // Encoder counts per motor revolution
+  float loadTorque; // Constant load at the output shaft [Nm]
+  float loadRipple; // Load ripple at the output shaft, once per wheel arm [Nm]
+  uint8_t wheelArms; // Arms of the feeding wheel, used by the load ripple
+  float jamAngle; // Output angle where a jam starts [deg], negative to disable
+  float jamWidth; // Angular width of the jam [deg]
+  float jamTorque; // Opposing torque of the jam at the output shaft [Nm]
+  uint8_t jamHits; // Number of times the jam blocks before it's cleared, 0 for a permanent jam
+  float indexWidth; // Angular width of the index mark at output angle 0 [deg], 0 without an index sensor
+} plantParamsS;
+
+typedef struct plantS {
+  plantParamsS params;
+  float current; // Armature current [A]
+  float velocity; // Motor shaft velocity [rad/s]
+  double angle; // Motor shaft angle [rad]
+  float dutyA; // Duty of the M1A input, 0 - 1
+  float dutyB; // Duty of the M1B input, 0 - 1
+  bool isInJam; // Whether or not the output is inside the jam window
+  uint8_t jamHitsLeft; // Number of times the jam still blocks
+  int64_t encoderCount; // Count currently presented on the encoder outputs
+  uint8_t encoderState; // AB state of the encoder outputs
+  uint64_t edges; // Number of generated encoder edges
+} plantS;
+
+extern const plantParamsS pololu2286Params;
+
+void plantInit(plantS *plant, const plantParamsS *params);
+void plantSetDuty(plantS *plant, float dutyA, float dutyB);
+void plantStep(plantS *plant, float deltaT);
+int8_t plantNextEncoderEdge(plantS *plant);
+float plantOutputAngle(const plantS *plant);
+bool plantIndexActive(const plantS *plant);
+
+#endif // plant_h
@@ -0,0 +1,19 @@
+#ifndef sim_h
+#define sim_h
+
+#include <stdint.h>
+#include "plant.h"
+
+#define SIM_STEP_US 10 // Integration step of the plant [us]
+#define SIM_THREAD_PERIOD_US 100 // Period of the real-time plant thread [us]
+#define SIM_BATCH_STEPS 10 // Steps integrated while holding the plant lock
+#define SIM_BATCH_EDGES 64 // Encoder edges buffered per batch
+#define SIM_PINS 64
+#define SIM_PLANT_PRIORITY 90 // Real-time priority of the plant thread, above everything else
+#define SIM_ISR_PRIORITY 55 // Real-time priority of the ISR threads, the same as WiringPi
+
+plantS *simLockPlant(uint8_t motor);
+void simUnlockPlant(uint8_t motor);
+void simSetPinLevel(int pin, int level);
+
+#endif // sim_h
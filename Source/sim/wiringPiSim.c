@@ -0,0 +1,422 @@
+#include <wiringPi.h>
+#include <wiringPiI2C.h>
+#include <softPwm.h>
+#include <stdatomic.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <time.h>
+#include <sched.h>
+#include "sim.h"
+#include "../config.h"
+
+// Pins of the simulated motor of a hopper
+typedef struct simPlantPinsS {
+  int inputA;
+  int inputB;
+  int encoderA;
+  int encoderB;
+  int index; // -1 without an index sensor
+} simPlantPinsS;
+
+const simPlantPinsS simPlantPins[] = {
+  {MOTOR_M1A, MOTOR_M1B, MOTOR_ENCODER_A, MOTOR_ENCODER_B, MOTOR_INDEX_PIN},
+  {MOTOR_M2A, MOTOR_M2B, MOTOR2_ENCODER_A, MOTOR2_ENCODER_B, MOTOR2_INDEX_PIN}
+};
+
+// Every hopper has its own plant, lock, encoder outputs and plant thread
+plantS simPlants[HOPPERS_COUNT];
+pthread_mutex_t simPlantMutexes[HOPPERS_COUNT];
+atomic_uchar simEncoderStates[HOPPERS_COUNT];
+
+struct timespec simEpoch;
+atomic_int simPinLevels[SIM_PINS];
+unsigned int simPwmRange = 1024;
+unsigned int simSoftPwmRanges[SIM_PINS];
+float simPwmDuties[SIM_PINS]; // Duty of the PWM outputs, 0 - 1
+// Simulated time of the edge an ISR is called for, so micros() inside the ISR
+// returns the exact edge time although the ISR thread runs later
+_Thread_local bool simIsInIsr = false;
+_Thread_local uint64_t simIsrTime = 0;
+
+// Like WiringPi, every pin with an ISR has its own real-time thread which waits
+// for the edges of the pin. Edges arriving while the thread is busy are
+// coalesced
+typedef struct simIsrS {
+  void (*function)(void); // Registered ISR, NULL if stopped
+  pthread_t thread;
+  bool isThreadStarted;
+  bool isPending; // Whether or not an edge arrived since the last call
+  uint64_t edgeTime; // Time of the latest edge [us]
+  pthread_mutex_t mutex;
+  pthread_cond_t edge;
+} simIsrS;
+
+simIsrS simIsrs[SIM_PINS];
+
+/*******************************************************************************
+* simElapsedUs
+*
+* @brief Returns the time since wiringPiSetupGpio
+*
+* @return Elapsed time [us]
+*******************************************************************************/
+uint64_t simElapsedUs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+
+  return (uint64_t)(now.tv_sec - simEpoch.tv_sec) * 1000000 + (now.tv_nsec - simEpoch.tv_nsec) / 1000;
+}
+
+/*******************************************************************************
+* simWaitUntil
+*
+* @brief Sleeps until a time since wiringPiSetupGpio
+*
+* @param[in] time The time to wake up at [us]
+*******************************************************************************/
+void simWaitUntil(uint64_t time) {
+  uint64_t now = simElapsedUs();
+  if (time <= now) return;
+
+  struct timespec duration = {(time - now) / 1000000, ((time - now) % 1000000) * 1000};
+  nanosleep(&duration, NULL);
+}
+
+/*******************************************************************************
+* simRaiseIsr
+*
+* @brief Wakes the ISR thread of a pin for an edge
+*
+* @param[in] pin GPIO pin
+* @param[in] time Time of the edge [us]
+*******************************************************************************/
+void simRaiseIsr(int pin, uint64_t time) {
+  simIsrS *isr = &simIsrs[pin];
+
+  pthread_mutex_lock(&isr->mutex);
+  if (isr->function != NULL) {
+    isr->isPending = true;
+    isr->edgeTime = time;
+    pthread_cond_signal(&isr->edge);
+  }
+  pthread_mutex_unlock(&isr->mutex);
+}
+
+/*******************************************************************************
+* simIsrThread
+*
+* @brief Calls the ISR of a pin for its edges, like the WiringPi ISR threads
+*
+* @param[in] arg The ISR of the pin
+*
+* @return Never returns
+*******************************************************************************/
+void *simIsrThread(void *arg) {
+  simIsrS *isr = arg;
+  simIsInIsr = true;
+  piHiPri(SIM_ISR_PRIORITY);
+
+  while (1) {
+    pthread_mutex_lock(&isr->mutex);
+    while (!isr->isPending) {
+      pthread_cond_wait(&isr->edge, &isr->mutex);
+    }
+    isr->isPending = false;
+    simIsrTime = isr->edgeTime;
+    void (*function)(void) = isr->function;
+    pthread_mutex_unlock(&isr->mutex);
+
+    if (function != NULL) function();
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* simPlantThread
+*
+* @brief Runs the plant in real time. Every period the plant is integrated one
+*        period ahead of the current time in SIM_STEP_US steps. The generated
+*        encoder edges are presented on the encoder pins at their time and wake
+*        the ISR threads of the pins. The thread runs with real-time priority
+*        when permitted. The plant is integrated in short batches
+*        and the edges are presented outside of the lock, so pwmWrite is never
+*        starved
+*
+* @param[in] arg Index of the hopper of the plant
+*
+* @return Never returns
+*******************************************************************************/
+void *simPlantThread(void *arg) {
+  uint8_t motor = (uintptr_t)arg;
+  plantS *plant = &simPlants[motor];
+  pthread_mutex_t *mutex = &simPlantMutexes[motor];
+  const simPlantPinsS *pins = &simPlantPins[motor];
+  uint64_t simTime = simElapsedUs();
+  int encoderPins[3] = {pins->encoderA, pins->encoderB, pins->index};
+  bool isIndexActive = plantIndexActive(plant);
+  int8_t edgeChannels[SIM_BATCH_EDGES];
+  uint8_t edgeStates[SIM_BATCH_EDGES];
+  uint64_t edgeTimes[SIM_BATCH_EDGES];
+
+  // The encoder edges of the real wheel don't wait for a CPU
+  piHiPri(SIM_PLANT_PRIORITY);
+
+  while (1) {
+    struct timespec period = {0, SIM_THREAD_PERIOD_US * 1000};
+    nanosleep(&period, NULL);
+
+    uint64_t end = simElapsedUs() + SIM_THREAD_PERIOD_US;
+
+    while (simTime < end) {
+      uint16_t edges = 0;
+
+      pthread_mutex_lock(mutex);
+      for (uint16_t step = 0; step < SIM_BATCH_STEPS && simTime < end && edges < SIM_BATCH_EDGES; step++) {
+        plantStep(plant, SIM_STEP_US / 1.0e6);
+        simTime += SIM_STEP_US;
+
+        while (edges < SIM_BATCH_EDGES && (edgeChannels[edges] = plantNextEncoderEdge(plant)) >= 0) {
+          edgeStates[edges] = plant->encoderState;
+          edgeTimes[edges] = simTime;
+          edges++;
+        }
+
+        // The index sensor is presented as a third edge channel
+        if (pins->index >= 0 && edges < SIM_BATCH_EDGES && plantIndexActive(plant) != isIndexActive) {
+          isIndexActive = !isIndexActive;
+          edgeChannels[edges] = 2;
+          edgeStates[edges] = isIndexActive;
+          edgeTimes[edges] = simTime;
+          edges++;
+        }
+      }
+      pthread_mutex_unlock(mutex);
+
+      for (uint16_t i = 0; i < edges; i++) {
+        simWaitUntil(edgeTimes[i]);
+        if (edgeChannels[i] == 2) {
+          atomic_store(&simPinLevels[pins->index], edgeStates[i] ? LOW : HIGH);
+        } else {
+          atomic_store(&simEncoderStates[motor], edgeStates[i]);
+        }
+        simRaiseIsr(encoderPins[edgeChannels[i]], edgeTimes[i]);
+      }
+    }
+  }
+
+  return NULL;
+}
+
+/*******************************************************************************
+* simLockPlant
+*
+* @brief Locks the simulated plant of a hopper so its parameters and state can
+*        be changed
+*
+* @param[in] motor Index of the hopper
+*
+* @return The simulated plant
+*******************************************************************************/
+plantS *simLockPlant(uint8_t motor) {
+  pthread_mutex_lock(&simPlantMutexes[motor]);
+  return &simPlants[motor];
+}
+
+/*******************************************************************************
+* simUnlockPlant
+*
+* @brief Unlocks the simulated plant of a hopper
+*
+* @param[in] motor Index of the hopper
+*******************************************************************************/
+void simUnlockPlant(uint8_t motor) {
+  pthread_mutex_unlock(&simPlantMutexes[motor]);
+}
+
+/*******************************************************************************
+* simSetPwmDuty
+*
+* @brief Sets the duty of a PWM output and passes it to the plant driven by
+*        the pin
+*
+* @param[in] pin GPIO pin
+* @param[in] duty Duty of the output, 0 - 1
+*******************************************************************************/
+void simSetPwmDuty(int pin, float duty) {
+  if (pin < 0 || pin >= SIM_PINS) return;
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    const simPlantPinsS *pins = &simPlantPins[i];
+    if (pin != pins->inputA && pin != pins->inputB) continue;
+
+    pthread_mutex_lock(&simPlantMutexes[i]);
+    simPwmDuties[pin] = duty;
+    plantSetDuty(&simPlants[i], simPwmDuties[pins->inputA], simPwmDuties[pins->inputB]);
+    pthread_mutex_unlock(&simPlantMutexes[i]);
+    return;
+  }
+
+  simPwmDuties[pin] = duty;
+}
+
+/*******************************************************************************
+* simSetPinLevel
+*
+* @brief Sets the level read from an input pin, e.g. to press a button. Calls
+*        the ISR registered for the pin on a change
+*
+* @param[in] pin GPIO pin
+* @param[in] level LOW or HIGH
+*******************************************************************************/
+void simSetPinLevel(int pin, int level) {
+  if (pin < 0 || pin >= SIM_PINS) return;
+
+  if (atomic_exchange(&simPinLevels[pin], level) != level && simIsrs[pin].function != NULL) {
+    simIsrs[pin].function();
+  }
+}
+
+int wiringPiSetupGpio(void) {
+  clock_gettime(CLOCK_MONOTONIC, &simEpoch);
+
+  // Inputs idle high, buttons have pull-ups
+  for (int pin = 0; pin < SIM_PINS; pin++) {
+    atomic_store(&simPinLevels[pin], HIGH);
+    pthread_mutex_init(&simIsrs[pin].mutex, NULL);
+    pthread_cond_init(&simIsrs[pin].edge, NULL);
+  }
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    plantS *plant = &simPlants[i];
+    pthread_mutex_init(&simPlantMutexes[i], NULL);
+    plantInit(plant, &pololu2286Params);
+    atomic_store(&simEncoderStates[i], plant->encoderState);
+    if (simPlantPins[i].index >= 0) atomic_store(&simPinLevels[simPlantPins[i].index], plantIndexActive(plant) ? LOW : HIGH);
+  }
+
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    pthread_t thread;
+    if (pthread_create(&thread, NULL, simPlantThread, (void *)(uintptr_t)i) != 0) return -1;
+    pthread_detach(thread);
+  }
+
+  return 0;
+}
+
+void pinMode(int pin, int mode) {}
+
+void pullUpDnControl(int pin, int pud) {}
+
+int digitalRead(int pin) {
+  for (uint8_t i = 0; i < HOPPERS_COUNT; i++) {
+    if (pin == simPlantPins[i].encoderA) return (atomic_load(&simEncoderStates[i]) >> 1) & 1;
+    if (pin == simPlantPins[i].encoderB) return atomic_load(&simEncoderStates[i]) & 1;
+  }
+  if (pin < 0 || pin >= SIM_PINS) return LOW;
+
+  return atomic_load(&simPinLevels[pin]);
+}
+
+void digitalWrite(int pin, int value) {}
+
+void pwmWrite(int pin, int value) {
+  simSetPwmDuty(pin, (float)value / simPwmRange);
+}
+
+void pwmSetMode(int mode) {}
+
+void pwmSetRange(unsigned int range) {
+  simPwmRange = range;
+}
+
+void pwmSetClock(int divisor) {}
+
+// The software PWM is passed to the plant as its average, like the hardware PWM
+int softPwmCreate(int pin, int initialValue, int pwmRange) {
+  if (pin < 0 || pin >= SIM_PINS || pwmRange <= 0) return -1;
+
+  simSoftPwmRanges[pin] = pwmRange;
+  simSetPwmDuty(pin, (float)initialValue / pwmRange);
+
+  return 0;
+}
+
+void softPwmWrite(int pin, int value) {
+  if (pin < 0 || pin >= SIM_PINS || simSoftPwmRanges[pin] == 0) return;
+
+  if (value < 0) value = 0;
+  if (value > (int)simSoftPwmRanges[pin]) value = simSoftPwmRanges[pin];
+  simSetPwmDuty(pin, (float)value / simSoftPwmRanges[pin]);
+}
+
+void softPwmStop(int pin) {
+  if (pin < 0 || pin >= SIM_PINS) return;
+
+  simSetPwmDuty(pin, 0);
+  simSoftPwmRanges[pin] = 0;
+}
+
+int wiringPiISR(int pin, int mode, void (*function)(void)) {
+  if (pin < 0 || pin >= SIM_PINS) return -1;
+
+  simIsrS *isr = &simIsrs[pin];
+  int status = 0;
+
+  pthread_mutex_lock(&isr->mutex);
+  isr->function = function;
+  isr->isPending = false;
+  if (!isr->isThreadStarted) {
+    status = pthread_create(&isr->thread, NULL, simIsrThread, isr) == 0 ? 0 : -1;
+    if (status == 0) {
+      pthread_detach(isr->thread);
+      isr->isThreadStarted = true;
+    }
+  }
+  pthread_mutex_unlock(&isr->mutex);
+
+  return status;
+}
+
+int wiringPiISRStop(int pin) {
+  if (pin < 0 || pin >= SIM_PINS) return -1;
+
+  pthread_mutex_lock(&simIsrs[pin].mutex);
+  simIsrs[pin].function = NULL;
+  simIsrs[pin].isPending = false;
+  pthread_mutex_unlock(&simIsrs[pin].mutex);
+
+  return 0;
+}
+
+int piHiPri(const int pri) {
+  struct sched_param param = {.sched_priority = pri};
+
+  return pthread_setschedparam(pthread_self(), SCHED_RR, &param) == 0 ? 0 : -1;
+}
+
+unsigned int millis(void) {
+  return simElapsedUs() / 1000;
+}
+
+unsigned int micros(void) {
+  return simIsInIsr ? simIsrTime : simElapsedUs();
+}
+
+void delay(unsigned int howLong) {
+  struct timespec duration = {howLong / 1000, (howLong % 1000) * 1000000L};
+  nanosleep(&duration, NULL);
+}
+
+void delayMicroseconds(unsigned int howLong) {
+  struct timespec duration = {howLong / 1000000, (howLong % 1000000) * 1000L};
+  nanosleep(&duration, NULL);
+}
+
+int wiringPiI2CSetup(const int devId) {
+  return 0;
+}
+
+int wiringPiI2CWrite(int fd, int data) {
+  return 0;
+}
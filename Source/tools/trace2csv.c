@@ -0,0 +1,81 @@
+// Decodes a motor trace dumped by the feeder into CSV, one row per control
+// loop iteration. Build with "make trace2csv.out" and run it on a machine with
+// the same endianness as the feeder, e.g. the Raspberry Pi itself
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../libs/trace.h"
+
+// Names of motorStateE, the decoder doesn't link the motor module
+const char* traceStateStrings[] = {
+  "MOVING",
+  "DWELLING",
+  "REVERSING",
+  "PAUSING",
+  "SETTLED",
+  "FAULT"
+};
+
+#define TRACE_STATES_COUNT (sizeof(traceStateStrings) / sizeof(traceStateStrings[0]))
+
+int main(int argc, char *argv[]) {
+  if (argc < 2) {
+    fprintf(stderr, "Usage: %s <trace file> [csv file]\n", argv[0]);
+    return 1;
+  }
+
+  FILE *in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  FILE *out = stdout;
+  if (argc > 2) {
+    out = fopen(argv[2], "w");
+    if (out == NULL) {
+      perror(argv[2]);
+      fclose(in);
+      return 1;
+    }
+  }
+
+  traceFileHeaderS header;
+  if (fread(&header, sizeof(header), 1, in) != 1 || header.magic != TRACE_MAGIC) {
+    fprintf(stderr, "%s is not a motor trace\n", argv[1]);
+    return 1;
+  }
+  if (header.version != TRACE_VERSION || header.sampleSize != sizeof(traceSampleS)) {
+    fprintf(stderr, "Unsupported trace version %hu with %hu bytes samples\n", header.version, header.sampleSize);
+    return 1;
+  }
+
+  fprintf(out, "move,hopper,degrees,move_jams,faulted,aborted,time_us,position,reference,error,output,state,jams\n");
+
+  for (uint32_t i = 0; i < header.moves; i++) {
+    traceMoveS move;
+    if (fread(&move, sizeof(move), 1, in) != 1) {
+      fprintf(stderr, "Trace truncated in move %u\n", i);
+      return 1;
+    }
+
+    for (uint32_t j = 0; j < move.samples; j++) {
+      traceSampleS sample;
+      if (fread(&sample, sizeof(sample), 1, in) != 1) {
+        fprintf(stderr, "Trace truncated in move %u, sample %u\n", i, j);
+        return 1;
+      }
+
+      fprintf(out, "%u,%hhu,%d,%hhu,%hhu,%hhu,%u,%d,%d,%d,%hd,%s,%hhu\n",
+        i, move.hopper + 1, move.degrees, move.jams, move.isFaulted, move.isAborted,
+        sample.time, sample.position, sample.reference, sample.error, sample.output,
+        sample.state < TRACE_STATES_COUNT ? traceStateStrings[sample.state] : "UNKNOWN", sample.jams);
+    }
+  }
+
+  fclose(in);
+  if (out != stdout) fclose(out);
+
+  return 0;
+}